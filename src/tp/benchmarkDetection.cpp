@@ -0,0 +1,434 @@
+#include "tracker/CornerRefiner.hpp"
+#include "tracker/utility.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+// the statistics of a detector over a set of frames
+struct DetectorStats
+{
+    // the number of frames and of frames where the board has been found
+    int frames{0};
+    int found{0};
+    // the detection time of each frame in ms
+    vector<double> times;
+    // the sum and the number of the corner errors in pixels
+    double errorSum{0};
+    int errorCount{0};
+};
+
+// the statistics of the subpixel refinement with a window size
+struct RefinerStats
+{
+    // the refinement time of each frame in ms, with cornerSubPix and with refineCornersSubPix
+    vector<double> opencvTimes, batchedTimes;
+    // the sum of the errors wrt the ground truth and the number of corners
+    double opencvErrorSum{0}, batchedErrorSum{0};
+    int count{0};
+    // the maximum distance between the corners refined by the two
+    double maxDifference{0};
+};
+
+// Display the help for the program
+void help( const char* programName );
+
+// parse the input command line arguments
+bool parseArgs( int argc, char**argv, Size &boardSize, vector<string> &inputFilenames, int &numSynthetic, int &repetitions );
+
+// render a synthetic frame of the board seen through a random homography
+void renderSyntheticFrame( const Size &boardSize, RNG &rng, Mat &frame, vector<Point2f> &groundTruth );
+
+// run a detector on a frame and update its statistics
+void runDetector( const Mat &frame, const Size &boardSize, ChessboardDetector detector, int repetitions,
+                  const vector<Point2f> &reference, DetectorStats &stats, vector<Point2f> &corners );
+
+// refine perturbed ground truth corners with cornerSubPix and refineCornersSubPix
+void runRefiners( const Mat &frame, const vector<Point2f> &groundTruth, const Size &winSize, const TermCriteria &criteria,
+                  int repetitions, RNG &rng, RefinerStats &stats );
+
+// print the statistics of a detector
+void printStats( const string &name, const DetectorStats &stats );
+
+// print the statistics of the refinement
+void printStats( const string &name, const RefinerStats &stats );
+
+int main( int argc, char** argv )
+{
+    /******************************************************************/
+    /* VARIABLES to use                                               */
+    /******************************************************************/
+
+    // it will contain the size in terms of corners (width X height) of the chessboard
+    Size boardSize;
+
+    // the images to process
+    vector<string> inputFilenames;
+
+    // the number of synthetic frames
+    int numSynthetic = 100;
+
+    // the number of times each detection is repeated to measure its time
+    int repetitions = 5;
+
+    /******************************************************************/
+    /* READ THE INPUT PARAMETERS                                      */
+    /******************************************************************/
+    if( !parseArgs( argc, argv, boardSize, inputFilenames, numSynthetic, repetitions ) )
+    {
+        cerr << "Aborting..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    // the images: the saddle detector is compared with opencv's corners
+    DetectorStats opencvImages, saddleImages;
+    for( size_t i = 0; i < inputFilenames.size( ); ++i )
+    {
+        const Mat view = imread( inputFilenames[i] );
+        if( view.empty( ) )
+        {
+            cerr << "Could not open image file " << inputFilenames[i] << endl;
+            continue;
+        }
+
+        vector<Point2f> opencvCorners, saddleCorners;
+        runDetector( view, boardSize, DETECTOR_OPENCV, repetitions, vector<Point2f>( ), opencvImages, opencvCorners );
+        runDetector( view, boardSize, DETECTOR_FAST, repetitions, opencvCorners, saddleImages, saddleCorners );
+        cout << inputFilenames[i] << ": opencv " << ( opencvCorners.empty( ) ? "not found" : "found" )
+             << ", saddle " << ( saddleCorners.empty( ) ? "not found" : "found" ) << endl;
+    }
+
+    // the synthetic frames: both detectors are compared with the ground truth
+    // and the subpixel refinement with the settings of detectChessboard and of the calibration
+    DetectorStats opencvSynthetic, saddleSynthetic;
+    RefinerStats detectionRefiner, calibrationRefiner;
+    const TermCriteria detectionCriteria( CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 40, 0.001 );
+    const TermCriteria calibrationCriteria( CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1 );
+    RNG rng( 12345 );
+    for( int i = 0; i < numSynthetic; ++i )
+    {
+        Mat frame;
+        vector<Point2f> groundTruth, corners;
+        renderSyntheticFrame( boardSize, rng, frame, groundTruth );
+        runDetector( frame, boardSize, DETECTOR_OPENCV, repetitions, groundTruth, opencvSynthetic, corners );
+        runDetector( frame, boardSize, DETECTOR_FAST, repetitions, groundTruth, saddleSynthetic, corners );
+        runRefiners( frame, groundTruth, Size( 5, 5 ), detectionCriteria, repetitions, rng, detectionRefiner );
+        runRefiners( frame, groundTruth, Size( 11, 11 ), calibrationCriteria, repetitions, rng, calibrationRefiner );
+    }
+
+    cout << endl << "Detector            found   mean ms   std ms   max ms   error px" << endl;
+    if( !inputFilenames.empty( ) )
+    {
+        cout << "Images (error wrt opencv's corners)" << endl;
+        printStats( "opencv", opencvImages );
+        printStats( "saddle", saddleImages );
+    }
+    if( numSynthetic > 0 )
+    {
+        cout << "Synthetic frames (error wrt the ground truth)" << endl;
+        printStats( "opencv", opencvSynthetic );
+        printStats( "saddle", saddleSynthetic );
+
+        cout << endl << "Refinement          corners opencv ms  batched ms  opencv px  batched px  max diff px" << endl;
+        printStats( "win 5 (detection)", detectionRefiner );
+        printStats( "win 11 (calib)", calibrationRefiner );
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Render a synthetic frame of the board seen through a random homography,
+ * with some blur and noise
+ *
+ * @param[in] boardSize the size of the board in terms of corners (width X height)
+ * @param[in,out] rng the random generator
+ * @param[out] frame the rendered frame (grey level)
+ * @param[out] groundTruth the true position of the corners
+ */
+void renderSyntheticFrame( const Size &boardSize, RNG &rng, Mat &frame, vector<Point2f> &groundTruth )
+{
+    const Size frameSize( 640, 480 );
+    const int square = 40;
+
+    // the board with a white margin of one square
+    Mat board( ( boardSize.height + 3 ) * square, ( boardSize.width + 3 ) * square, CV_8UC1, Scalar( 255 ) );
+    for( int b = 0; b <= boardSize.height; ++b )
+    {
+        for( int a = 0; a <= boardSize.width; ++a )
+        {
+            if( ( a + b ) % 2 == 0 )
+                rectangle( board, Rect( ( a + 1 ) * square, ( b + 1 ) * square, square, square ), Scalar( 0 ), CV_FILLED );
+        }
+    }
+
+    // the corners of the board image go to a random quadrilateral inside the frame
+    const float w = ( float ) board.cols, h = ( float ) board.rows;
+    const Point2f src[4] = { Point2f( 0, 0 ), Point2f( w, 0 ), Point2f( w, h ), Point2f( 0, h ) };
+    const float scale = rng.uniform( 0.5f, 0.85f ) * frameSize.width / w;
+    const float angle = rng.uniform( -0.6f, 0.6f );
+    const Point2f centre( frameSize.width * 0.5f + rng.uniform( -40.f, 40.f ), frameSize.height * 0.5f + rng.uniform( -30.f, 30.f ) );
+    Point2f dst[4];
+    for( int k = 0; k < 4; ++k )
+    {
+        const Point2f p = ( src[k] - Point2f( w * 0.5f, h * 0.5f ) ) * scale;
+        const Point2f jitter( rng.uniform( -0.08f, 0.08f ) * w * scale, rng.uniform( -0.08f, 0.08f ) * h * scale );
+        dst[k] = centre + Point2f( cos( angle ) * p.x - sin( angle ) * p.y, sin( angle ) * p.x + cos( angle ) * p.y ) + jitter;
+    }
+    const Mat H = getPerspectiveTransform( src, dst );
+    warpPerspective( board, frame, H, frameSize, INTER_LINEAR, BORDER_CONSTANT, Scalar( 128 ) );
+
+    // blur and noise
+    const double sigma = rng.uniform( 0.3, 1.5 );
+    GaussianBlur( frame, frame, Size( 0, 0 ), sigma );
+    Mat noise( frameSize, CV_16SC1 );
+    randn( noise, Scalar( 0 ), Scalar( 4 ) );
+    Mat noisy;
+    frame.convertTo( noisy, CV_16SC1 );
+    noisy += noise;
+    noisy.convertTo( frame, CV_8UC1 );
+
+    // the pixel centres are at integer coordinates, the edges of the squares at -0.5
+    vector<Point2f> boardCorners;
+    for( int r = 0; r < boardSize.height; ++r )
+        for( int c = 0; c < boardSize.width; ++c )
+            boardCorners.push_back( Point2f( ( c + 2 ) * square - 0.5f, ( r + 2 ) * square - 0.5f ) );
+    perspectiveTransform( boardCorners, groundTruth, H );
+}
+
+/**
+ * Run a detector on a frame and update its statistics. The errors are the
+ * distances of the detected corners from the nearest reference corner, so
+ * that they do not depend on the order of the corners
+ *
+ * @param[in] frame the frame
+ * @param[in] boardSize the size of the board in terms of corners (width X height)
+ * @param[in] detector the detector to run
+ * @param[in] repetitions the number of runs, the time is the minimum one
+ * @param[in] reference the reference corners, empty if there is no reference
+ * @param[in,out] stats the statistics of the detector
+ * @param[out] corners the detected corners, empty if the board has not been found
+ */
+void runDetector( const Mat &frame, const Size &boardSize, ChessboardDetector detector, int repetitions,
+                  const vector<Point2f> &reference, DetectorStats &stats, vector<Point2f> &corners )
+{
+    bool found = false;
+    double bestTime = DBL_MAX;
+    for( int k = 0; k < repetitions; ++k )
+    {
+        const double t = ( double ) getTickCount( );
+        found = detectChessboard( frame, corners, boardSize, CHESSBOARD, detector );
+        bestTime = min( bestTime, ( ( double ) getTickCount( ) - t ) / getTickFrequency( ) * 1000 );
+    }
+
+    ++stats.frames;
+    stats.times.push_back( bestTime );
+    if( !found )
+    {
+        corners.clear( );
+        return;
+    }
+    ++stats.found;
+
+    if( reference.empty( ) )
+        return;
+    for( size_t i = 0; i < corners.size( ); ++i )
+    {
+        float best = FLT_MAX;
+        for( size_t j = 0; j < reference.size( ); ++j )
+        {
+            const Point2f d = corners[i] - reference[j];
+            best = min( best, d.dot( d ) );
+        }
+        stats.errorSum += sqrt( best );
+        ++stats.errorCount;
+    }
+}
+
+/**
+ * Refine the ground truth corners, perturbed by up to 1.5 pixels, with
+ * cornerSubPix and with refineCornersSubPix and update the statistics
+ *
+ * @param[in] frame the frame
+ * @param[in] groundTruth the true position of the corners
+ * @param[in] winSize half of the side length of the search window
+ * @param[in] criteria the termination criteria
+ * @param[in] repetitions the number of runs, the time is the minimum one
+ * @param[in,out] rng the random generator
+ * @param[in,out] stats the statistics of the refinement
+ */
+void runRefiners( const Mat &frame, const vector<Point2f> &groundTruth, const Size &winSize, const TermCriteria &criteria,
+                  int repetitions, RNG &rng, RefinerStats &stats )
+{
+    vector<Point2f> initial( groundTruth.size( ) );
+    for( size_t i = 0; i < groundTruth.size( ); ++i )
+        initial[i] = groundTruth[i] + Point2f( rng.uniform( -1.5f, 1.5f ), rng.uniform( -1.5f, 1.5f ) );
+
+    vector<Point2f> opencvCorners, batchedCorners;
+    double opencvTime = DBL_MAX, batchedTime = DBL_MAX;
+    for( int k = 0; k < repetitions; ++k )
+    {
+        opencvCorners = initial;
+        double t = ( double ) getTickCount( );
+        cornerSubPix( frame, opencvCorners, winSize, Size( -1, -1 ), criteria );
+        opencvTime = min( opencvTime, ( ( double ) getTickCount( ) - t ) / getTickFrequency( ) * 1000 );
+
+        batchedCorners = initial;
+        t = ( double ) getTickCount( );
+        refineCornersSubPix( frame, batchedCorners, winSize, criteria );
+        batchedTime = min( batchedTime, ( ( double ) getTickCount( ) - t ) / getTickFrequency( ) * 1000 );
+    }
+
+    stats.opencvTimes.push_back( opencvTime );
+    stats.batchedTimes.push_back( batchedTime );
+    for( size_t i = 0; i < groundTruth.size( ); ++i )
+    {
+        const Point2f eo = opencvCorners[i] - groundTruth[i];
+        const Point2f eb = batchedCorners[i] - groundTruth[i];
+        const Point2f d = opencvCorners[i] - batchedCorners[i];
+        stats.opencvErrorSum += sqrt( eo.dot( eo ) );
+        stats.batchedErrorSum += sqrt( eb.dot( eb ) );
+        stats.maxDifference = max( stats.maxDifference, ( double ) sqrt( d.dot( d ) ) );
+        ++stats.count;
+    }
+}
+
+/**
+ * Print the statistics of a detector
+ *
+ * @param[in] name the name of the detector
+ * @param[in] stats the statistics
+ */
+void printStats( const string &name, const DetectorStats &stats )
+{
+    double mean = 0, maxTime = 0;
+    for( size_t i = 0; i < stats.times.size( ); ++i )
+    {
+        mean += stats.times[i];
+        maxTime = max( maxTime, stats.times[i] );
+    }
+    mean /= max( ( int ) stats.times.size( ), 1 );
+
+    double variance = 0;
+    for( size_t i = 0; i < stats.times.size( ); ++i )
+        variance += ( stats.times[i] - mean ) * ( stats.times[i] - mean );
+    variance /= max( ( int ) stats.times.size( ), 1 );
+
+    const double error = stats.errorCount > 0 ? stats.errorSum / stats.errorCount : 0;
+    printf( "  %-16s %4d/%-4d %8.2f %8.2f %8.2f %10.3f\n", name.c_str( ), stats.found, stats.frames, mean, sqrt( variance ), maxTime, error );
+}
+
+/**
+ * Print the statistics of the refinement
+ *
+ * @param[in] name the name of the setting
+ * @param[in] stats the statistics
+ */
+void printStats( const string &name, const RefinerStats &stats )
+{
+    double opencvMean = 0, batchedMean = 0;
+    for( size_t i = 0; i < stats.opencvTimes.size( ); ++i )
+    {
+        opencvMean += stats.opencvTimes[i];
+        batchedMean += stats.batchedTimes[i];
+    }
+    opencvMean /= max( ( int ) stats.opencvTimes.size( ), 1 );
+    batchedMean /= max( ( int ) stats.batchedTimes.size( ), 1 );
+
+    const int count = max( stats.count, 1 );
+    printf( "  %-18s %6d %9.3f %11.3f %10.3f %11.3f %12.4f\n", name.c_str( ), stats.count, opencvMean, batchedMean,
+            stats.opencvErrorSum / count, stats.batchedErrorSum / count, stats.maxDifference );
+}
+
+// Display the help for the program
+
+void help( const char* programName )
+{
+    cout << "Compare the detection time and accuracy of opencv's chessboard detector and of the saddle point one," << endl
+            << "and of cornerSubPix and refineCornersSubPix on the synthetic frames" << endl
+            << "Usage: " << programName << endl
+            << "     -w <board_width>                                  # the number of inner corners per one of board dimension" << endl
+            << "     -h <board_height>                                 # the number of inner corners per another board dimension" << endl
+            << "     [-n <frames>]                                     # the number of synthetic frames (default 100)" << endl
+            << "     [-r <runs>]                                       # the number of runs of each detection, the best time is kept (default 5)" << endl
+            << "     [<image file> ...]                                # the images to process" << endl
+            << endl;
+}
+
+// parse the input command line arguments
+
+bool parseArgs( int argc, char**argv, Size &boardSize, vector<string> &inputFilenames, int &numSynthetic, int &repetitions )
+{
+    // check the minimum number of arguments
+    if( argc < 3 )
+    {
+        help( argv[0] );
+        return false;
+    }
+
+
+    // Read the input arguments
+    for( int i = 1; i < argc; i++ )
+    {
+        const char* s = argv[i];
+        if( strcmp( s, "-w" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%u", &boardSize.width ) != 1 || boardSize.width <= 1 )
+            {
+                cerr << "Invalid board width" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-h" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%u", &boardSize.height ) != 1 || boardSize.height <= 1 )
+            {
+                cerr << "Invalid board height" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-n" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &numSynthetic ) != 1 || numSynthetic < 0 )
+            {
+                cerr << "Invalid number of synthetic frames" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-r" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &repetitions ) != 1 || repetitions <= 0 )
+            {
+                cerr << "Invalid number of runs" << endl;
+                return false;
+            }
+        }
+        else if( s[0] != '-' )
+        {
+            inputFilenames.push_back( s );
+        }
+        else
+        {
+            cerr << "Unknown option " << s << endl;
+            return false;
+        }
+    }
+
+    if( boardSize.width <= 1 || boardSize.height <= 1 )
+    {
+        cerr << "The board size must be given" << endl;
+        return false;
+    }
+
+    return true;
+}
@@ -3,10 +3,17 @@
 #include "opencv2/calib3d/calib3d.hpp"
 #include "opencv2/highgui/highgui.hpp"
 
+#include "tracker/CornerRefiner.hpp"
+
+#include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <limits>
+#include <numeric>
 
 using namespace cv;
 using namespace std;
@@ -18,6 +25,9 @@ const char * usage =
         " example command line for calibration from a list of stored images:\n"
         "   imagelist_creator image_list.xml *.png\n"
         "   calibration -w 4 -h 5 -s 0.025 -o camera.yml -op -oe image_list.xml\n"
+        " \n"
+        " example command line for a batch calibration (parallel detection, no display) from a long list of images:\n"
+        "   calibration -w 4 -h 5 -s 0.025 -o camera.yml -b image_list.xml\n"
         " where image_list.xml is the standard OpenCV XML/YAML\n"
         " use imagelist_creator to create the xml or yaml list\n"
         " file consisting of the list of strings, e.g.:\n"
@@ -68,6 +78,13 @@ static void help( )
             "     [-V]                     # use a video file, and not an image list, uses\n"
             "                              # [input_data] string for the video file name\n"
             "     [-su]                    # show undistorted images after calibration\n"
+            "     [-b]                     # batch mode for image lists: detect the boards in parallel, without\n"
+            "                              # display, then add the views incrementally (best coverage and pose\n"
+            "                              # diversity first) until the calibration converges\n"
+            "     [-ot <max_error>]        # reject the views whose reprojection error is above max_error pixels\n"
+            "                              # and calibrate again without them\n"
+            "     [-ct <tolerance>]        # relative change of the intrinsics and of the RMS error under which\n"
+            "                              # the batch calibration is considered converged (0.005 by default)\n"
             "     [input_data]             # input data, one of the following:\n"
             "                              #  - text file with a list of the images of the board\n"
             "                              #    the text file can be generated with imagelist_creator\n"
@@ -88,27 +105,74 @@ enum Pattern
     CHESSBOARD, CIRCLES_GRID, ASYMMETRIC_CIRCLES_GRID
 };
 
+// minimum number of views kept when rejecting the outlier views
+const size_t MIN_CALIBRATION_VIEWS = 4;
+
+/**
+ * Parallel body projecting the board in each view and measuring the error of each corner
+ */
+class ReprojectionErrorBody : public ParallelLoopBody
+{
+public:
+
+    ReprojectionErrorBody( const vector<vector<Point3f> >& objectPoints,
+            const vector<vector<Point2f> >& imagePoints,
+            const vector<Mat>& rvecs, const vector<Mat>& tvecs,
+            const Mat& cameraMatrix, const Mat& distCoeffs, Mat &cornerErrors )
+    : _objectPoints( objectPoints ), _imagePoints( imagePoints ), _rvecs( rvecs ), _tvecs( tvecs ),
+    _cameraMatrix( cameraMatrix ), _distCoeffs( distCoeffs ), _cornerErrors( cornerErrors ) { }
+
+    void operator()( const Range &range ) const override
+    {
+        vector<Point2f> imagePoints2;
+        for( int i = range.start; i < range.end; i++ )
+        {
+            projectPoints( Mat( _objectPoints[i] ), _rvecs[i], _tvecs[i],
+                    _cameraMatrix, _distCoeffs, imagePoints2 );
+
+            float *err = _cornerErrors.ptr<float>( i );
+            for( size_t j = 0; j < imagePoints2.size( ); j++ )
+                err[j] = ( float ) norm( _imagePoints[i][j] - imagePoints2[j] );
+        }
+    }
+
+private:
+
+    const vector<vector<Point3f> > &_objectPoints;
+    const vector<vector<Point2f> > &_imagePoints;
+    const vector<Mat> &_rvecs;
+    const vector<Mat> &_tvecs;
+    const Mat &_cameraMatrix;
+    const Mat &_distCoeffs;
+    Mat &_cornerErrors;
+};
+
 static double computeReprojectionErrors(
         const vector<vector<Point3f> >& objectPoints,
         const vector<vector<Point2f> >& imagePoints,
         const vector<Mat>& rvecs, const vector<Mat>& tvecs,
         const Mat& cameraMatrix, const Mat& distCoeffs,
-        vector<float>& perViewErrors )
+        vector<float>& perViewErrors, Mat& cornerErrors )
 {
-    vector<Point2f> imagePoints2;
     int i, totalPoints = 0;
-    double totalErr = 0, err;
+    double totalErr = 0;
     perViewErrors.resize( objectPoints.size( ) );
 
+    // all the views contain the whole board: one row of corner errors per view
+    cornerErrors.create( ( int ) objectPoints.size( ), ( int ) objectPoints[0].size( ), CV_32F );
+    parallel_for_( Range( 0, ( int ) objectPoints.size( ) ),
+            ReprojectionErrorBody( objectPoints, imagePoints, rvecs, tvecs,
+            cameraMatrix, distCoeffs, cornerErrors ) );
+
     for( i = 0; i < ( int ) objectPoints.size( ); i++ )
     {
-        projectPoints( Mat( objectPoints[i] ), rvecs[i], tvecs[i],
-                cameraMatrix, distCoeffs, imagePoints2 );
-        err = norm( Mat( imagePoints[i] ), Mat( imagePoints2 ), CV_L2 );
-        auto n = ( int ) objectPoints[i].size( );
-        perViewErrors[i] = ( float ) std::sqrt( err * err / n );
-        totalErr += err*err;
-        totalPoints += n;
+        const float *err = cornerErrors.ptr<float>( i );
+        double err2 = 0;
+        for( int j = 0; j < cornerErrors.cols; j++ )
+            err2 += err[j] * err[j];
+        perViewErrors[i] = ( float ) std::sqrt( err2 / cornerErrors.cols );
+        totalErr += err2;
+        totalPoints += cornerErrors.cols;
     }
 
     return std::sqrt( totalErr / totalPoints );
@@ -145,7 +209,7 @@ static bool runCalibration( const vector<vector<Point2f> > &imagePoints,
         float squareSize, float aspectRatio,
         int flags, Mat& cameraMatrix, Mat& distCoeffs,
         vector<Mat>& rvecs, vector<Mat>& tvecs,
-        vector<float>& reprojErrs,
+        vector<float>& reprojErrs, Mat& cornerErrors,
         double& totalAvgErr )
 {
     cameraMatrix = Mat::eye( 3, 3, CV_64F );
@@ -167,11 +231,35 @@ static bool runCalibration( const vector<vector<Point2f> > &imagePoints,
     bool ok = checkRange( cameraMatrix ) && checkRange( distCoeffs );
 
     totalAvgErr = computeReprojectionErrors( objectPoints, imagePoints,
-            rvecs, tvecs, cameraMatrix, distCoeffs, reprojErrs );
+            rvecs, tvecs, cameraMatrix, distCoeffs, reprojErrs, cornerErrors );
 
     return ok;
 }
 
+/**
+ * Write the distribution (mean, median, 95th percentile and max) of a set of errors
+ *
+ * @param[in] fs the file storage
+ * @param[in] name the name of the node
+ * @param[in] errors the errors
+ */
+static void writeErrorStats( FileStorage &fs, const string &name, vector<float> errors )
+{
+    if( errors.empty( ) )
+        return;
+
+    std::sort( errors.begin( ), errors.end( ) );
+    const size_t n = errors.size( );
+    const double mean = std::accumulate( errors.begin( ), errors.end( ), 0.0 ) / n;
+
+    fs << name << "{"
+            << "mean" << mean
+            << "median" << errors[n / 2]
+            << "p95" << errors[std::min( n - 1, ( size_t ) ( 0.95 * n ) )]
+            << "max" << errors[n - 1]
+            << "}";
+}
+
 static void saveCameraParams( const string& filename,
         Size imageSize, Size boardSize,
         float squareSize, float aspectRatio, int flags,
@@ -179,7 +267,8 @@ static void saveCameraParams( const string& filename,
         const vector<Mat>& rvecs, const vector<Mat>& tvecs,
         const vector<float>& reprojErrs,
         const vector<vector<Point2f> >& imagePoints,
-        double totalAvgErr )
+        double totalAvgErr, const Mat& cornerErrors,
+        const vector<int>& rejectedViews )
 {
     FileStorage fs( filename, FileStorage::WRITE );
 
@@ -221,6 +310,35 @@ static void saveCameraParams( const string& filename,
     if( !reprojErrs.empty( ) )
         fs << "per_view_reprojection_errors" << Mat( reprojErrs );
 
+    if( !cornerErrors.empty( ) )
+    {
+        // RMS error of each view and of each corner of the board over all the views
+        vector<float> viewErrs( cornerErrors.rows ), perCornerErrs( cornerErrors.cols, 0.f );
+        for( int i = 0; i < cornerErrors.rows; i++ )
+        {
+            const float *err = cornerErrors.ptr<float>( i );
+            double err2 = 0;
+            for( int j = 0; j < cornerErrors.cols; j++ )
+            {
+                err2 += err[j] * err[j];
+                perCornerErrs[j] += err[j] * err[j];
+            }
+            viewErrs[i] = ( float ) std::sqrt( err2 / cornerErrors.cols );
+        }
+        for( int j = 0; j < cornerErrors.cols; j++ )
+            perCornerErrs[j] = std::sqrt( perCornerErrs[j] / cornerErrors.rows );
+
+        fs << "per_corner_reprojection_errors" << Mat( perCornerErrs ).reshape( 1, boardSize.height );
+        writeErrorStats( fs, "per_view_reprojection_error_stats", viewErrs );
+        writeErrorStats( fs, "corner_reprojection_error_stats", ( vector<float> ) cornerErrors.reshape( 1, 1 ) );
+    }
+
+    if( !rejectedViews.empty( ) )
+    {
+        cvWriteComment( *fs, "the views rejected as outliers, indices in the order the views have been collected", 0 );
+        fs << "rejected_views" << Mat( rejectedViews );
+    }
+
     if( !rvecs.empty( ) && !tvecs.empty( ) )
     {
         CV_Assert( rvecs[0].type( ) == tvecs[0].type( ) );
@@ -253,6 +371,46 @@ static void saveCameraParams( const string& filename,
     }
 }
 
+/**
+ * Detect the calibration pattern in a view and refine the corners
+ *
+ * @param[in] view the image to process
+ * @param[in] boardSize the size of the board in terms of corners (width X height)
+ * @param[in] patternType the type of pattern to detect
+ * @param[out] pointbuf the detected corners
+ * @return true if the pattern has been found
+ */
+static bool findPattern( const Mat &view, const Size &boardSize, Pattern patternType, vector<Point2f> &pointbuf )
+{
+    bool found;
+    switch( patternType )
+    {
+        case CHESSBOARD:
+            found = findChessboardCorners( view, boardSize, pointbuf,
+                    CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_FAST_CHECK | CV_CALIB_CB_NORMALIZE_IMAGE );
+            break;
+        case CIRCLES_GRID:
+            found = findCirclesGrid( view, boardSize, pointbuf );
+            break;
+        case ASYMMETRIC_CIRCLES_GRID:
+            found = findCirclesGrid( view, boardSize, pointbuf, CALIB_CB_ASYMMETRIC_GRID );
+            break;
+        default:
+            return false;
+    }
+
+    // improve the found corners' coordinate accuracy
+    if( patternType == CHESSBOARD && found )
+    {
+        Mat viewGray;
+        cvtColor( view, viewGray, CV_BGR2GRAY );
+        refineCornersSubPix( viewGray, pointbuf, Size( 11, 11 ),
+                TermCriteria( CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1 ) );
+    }
+
+    return found;
+}
+
 static bool readStringList( const string& filename, vector<string>& l )
 {
     l.resize( 0 );
@@ -272,15 +430,65 @@ static bool runAndSave( const string& outputFilename,
         const vector<vector<Point2f> >& imagePoints,
         const Size &imageSize, const Size &boardSize, Pattern patternType, float squareSize,
         float aspectRatio, int flags, Mat& cameraMatrix,
-        Mat& distCoeffs, bool writeExtrinsics, bool writePoints )
+        Mat& distCoeffs, bool writeExtrinsics, bool writePoints,
+        float outlierThreshold )
 {
     vector<Mat> rvecs, tvecs;
     vector<float> reprojErrs;
+    Mat cornerErrors;
     double totalAvgErr = 0;
 
-    bool ok = runCalibration( imagePoints, imageSize, boardSize, patternType, squareSize,
+    // the views used for the calibration and their index among the collected ones
+    vector<vector<Point2f> > viewPoints( imagePoints );
+    vector<int> viewIdx( imagePoints.size( ) );
+    for( size_t i = 0; i < viewIdx.size( ); i++ )
+        viewIdx[i] = ( int ) i;
+    vector<int> rejectedViews;
+
+    bool ok = runCalibration( viewPoints, imageSize, boardSize, patternType, squareSize,
             aspectRatio, flags, cameraMatrix, distCoeffs,
-            rvecs, tvecs, reprojErrs, totalAvgErr );
+            rvecs, tvecs, reprojErrs, cornerErrors, totalAvgErr );
+
+    // drop the views whose error is above the threshold and calibrate again,
+    // until no outliers are left
+    while( ok && outlierThreshold > 0 )
+    {
+        vector<vector<Point2f> > inlierPoints;
+        vector<int> inlierIdx, outlierIdx;
+        for( size_t i = 0; i < viewPoints.size( ); i++ )
+        {
+            if( reprojErrs[i] > outlierThreshold )
+            {
+                outlierIdx.push_back( viewIdx[i] );
+            }
+            else
+            {
+                inlierPoints.push_back( viewPoints[i] );
+                inlierIdx.push_back( viewIdx[i] );
+            }
+        }
+
+        if( outlierIdx.empty( ) )
+            break;
+
+        if( inlierPoints.size( ) < MIN_CALIBRATION_VIEWS )
+        {
+            printf( "Only %d views under the outlier threshold, keeping all of them\n", ( int ) inlierPoints.size( ) );
+            break;
+        }
+
+        printf( "Rejected %d outlier views, calibrating again with %d views\n",
+                ( int ) outlierIdx.size( ), ( int ) inlierPoints.size( ) );
+
+        rejectedViews.insert( rejectedViews.end( ), outlierIdx.begin( ), outlierIdx.end( ) );
+        viewPoints.swap( inlierPoints );
+        viewIdx.swap( inlierIdx );
+
+        ok = runCalibration( viewPoints, imageSize, boardSize, patternType, squareSize,
+                aspectRatio, flags, cameraMatrix, distCoeffs,
+                rvecs, tvecs, reprojErrs, cornerErrors, totalAvgErr );
+    }
+
     printf( "%s. avg reprojection error = %.2f\n",
             ok ? "Calibration succeeded" : "Calibration failed",
             totalAvgErr );
@@ -292,11 +500,324 @@ static bool runAndSave( const string& outputFilename,
             writeExtrinsics ? rvecs : vector<Mat>( ),
             writeExtrinsics ? tvecs : vector<Mat>( ),
             writeExtrinsics ? reprojErrs : vector<float>( ),
-            writePoints ? imagePoints : vector<vector<Point2f> >( ),
-            totalAvgErr );
+            writePoints ? viewPoints : vector<vector<Point2f> >( ),
+            totalAvgErr, cornerErrors, rejectedViews );
     return ok;
 }
 
+/******************************************************************/
+/* BATCH CALIBRATION                                              */
+/******************************************************************/
+
+// number of cells per side of the grid used to measure the image coverage
+const int COVERAGE_GRID = 8;
+// number of views used for the first solution of the batch calibration
+const int MIN_INCREMENTAL_VIEWS = 5;
+// number of views added at each step of the batch calibration
+const int INCREMENTAL_STEP = 3;
+// number of consecutive steps under the tolerance to consider the calibration converged
+const int CONVERGED_STEPS = 2;
+
+// a view of the image list with the detected board
+struct BoardView
+{
+    // true if the board has been found
+    bool found = false;
+    // the size of the image
+    Size imageSize;
+    // the detected corners
+    vector<Point2f> corners;
+    // bitmask of the coverage grid cells containing at least one corner
+    uint64_t cells = 0;
+    // position, scale and tilt of the board, used to measure the diversity of the views
+    double descriptor[5];
+};
+
+static int countBits( uint64_t mask )
+{
+    int count = 0;
+    for( ; mask; mask &= mask - 1 )
+        ++count;
+    return count;
+}
+
+/**
+ * Compute the coverage mask and the descriptor of a detected view
+ *
+ * @param[in,out] view the view to describe
+ * @param[in] boardSize the size of the board in terms of corners (width X height)
+ */
+static void describeView( BoardView &view, const Size &boardSize )
+{
+    const vector<Point2f> &c = view.corners;
+    const float width = ( float ) view.imageSize.width;
+    const float height = ( float ) view.imageSize.height;
+
+    view.cells = 0;
+    for( size_t i = 0; i < c.size( ); ++i )
+    {
+        const int cx = std::min( std::max( ( int ) ( c[i].x * COVERAGE_GRID / width ), 0 ), COVERAGE_GRID - 1 );
+        const int cy = std::min( std::max( ( int ) ( c[i].y * COVERAGE_GRID / height ), 0 ), COVERAGE_GRID - 1 );
+        view.cells |= ( uint64_t ) 1 << ( cy * COVERAGE_GRID + cx );
+    }
+
+    // the outer corners of the board
+    const Point2f &tl = c[0];
+    const Point2f &tr = c[boardSize.width - 1];
+    const Point2f &bl = c[( boardSize.height - 1 ) * boardSize.width];
+    const Point2f &br = c.back( );
+
+    // area of the quadrilateral (shoelace formula)
+    const double area = 0.5 * std::abs( ( tl.x * tr.y - tr.x * tl.y ) + ( tr.x * br.y - br.x * tr.y )
+                                        + ( br.x * bl.y - bl.x * br.y ) + ( bl.x * tl.y - tl.x * bl.y ) );
+    const double diagonal = std::sqrt( width * width + height * height );
+
+    view.descriptor[0] = ( tl.x + tr.x + bl.x + br.x ) / ( 4 * width );
+    view.descriptor[1] = ( tl.y + tr.y + bl.y + br.y ) / ( 4 * height );
+    view.descriptor[2] = std::sqrt( area ) / diagonal;
+    // the perspective makes the opposite sides of a tilted board have different lengths
+    view.descriptor[3] = std::log( ( norm( tl - bl ) + 1 ) / ( norm( tr - br ) + 1 ) );
+    view.descriptor[4] = std::log( ( norm( tl - tr ) + 1 ) / ( norm( bl - br ) + 1 ) );
+}
+
+/**
+ * Parallel body loading the images of the list and detecting the board
+ */
+class BoardViewDetector : public ParallelLoopBody
+{
+public:
+
+    BoardViewDetector( const vector<string> &imageList, const Size &boardSize, Pattern patternType,
+            bool flipVertical, vector<BoardView> &views )
+    : _imageList( imageList ), _boardSize( boardSize ), _patternType( patternType ),
+    _flipVertical( flipVertical ), _views( views ) { }
+
+    void operator()( const Range &range ) const override
+    {
+        for( int i = range.start; i < range.end; ++i )
+        {
+            BoardView &view = _views[i];
+
+            Mat image = imread( _imageList[i], 1 );
+            if( !image.data )
+                continue;
+
+            if( _flipVertical )
+                flip( image, image, 0 );
+
+            view.imageSize = image.size( );
+            view.found = findPattern( image, _boardSize, _patternType, view.corners );
+
+            if( view.found )
+                describeView( view, _boardSize );
+        }
+    }
+
+private:
+
+    const vector<string> &_imageList;
+    const Size _boardSize;
+    const Pattern _patternType;
+    const bool _flipVertical;
+    vector<BoardView> &_views;
+};
+
+/**
+ * Choose the next view to add to the calibration: the one that covers most of the
+ * image cells not covered yet and whose board pose differs most from the selected ones
+ *
+ * @param[in] views all the views
+ * @param[in] used flags the views already selected
+ * @param[in] covered the cells covered by the selected views
+ * @param[in] selected the indices of the selected views
+ * @return the index of the next view, -1 if there are no more views
+ */
+static int selectNextView( const vector<BoardView> &views, const vector<bool> &used, uint64_t covered, const vector<int> &selected )
+{
+    int best = -1;
+    double bestScore = -1;
+
+    for( size_t i = 0; i < views.size( ); ++i )
+    {
+        if( !views[i].found || used[i] )
+            continue;
+
+        // fraction of the image that the view would add to the coverage
+        const double coverage = countBits( views[i].cells & ~covered ) / ( double ) ( COVERAGE_GRID * COVERAGE_GRID );
+
+        // distance from the closest selected view
+        double diversity = selected.empty( ) ? 1.0 : std::numeric_limits<double>::max( );
+        for( size_t j = 0; j < selected.size( ); ++j )
+        {
+            double dist = 0;
+            for( int k = 0; k < 5; ++k )
+            {
+                const double d = views[i].descriptor[k] - views[selected[j]].descriptor[k];
+                dist += d * d;
+            }
+            diversity = std::min( diversity, std::sqrt( dist ) );
+        }
+
+        const double score = coverage + diversity;
+        if( score > bestScore )
+        {
+            bestScore = score;
+            best = ( int ) i;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Calibrate incrementally: the best views are added a few at a time and the
+ * calibration is re-solved starting from the previous solution, until the
+ * intrinsics and the RMS error stop changing
+ *
+ * @param[in] views the detected views
+ * @param[in] imageSize the size of the images
+ * @param[in] boardSize the size of the board in terms of corners (width X height)
+ * @param[in] patternType the type of pattern
+ * @param[in] squareSize the size of the squares
+ * @param[in] aspectRatio the fixed aspect ratio, if flags contains CV_CALIB_FIX_ASPECT_RATIO
+ * @param[in] flags the calibration flags
+ * @param[in] maxViews the maximum number of views to use
+ * @param[in] tolerance the relative change under which the calibration is converged
+ * @param[out] imagePoints the corners of the selected views
+ */
+static void selectViewsIncrementally( const vector<BoardView> &views, const Size &imageSize,
+        const Size &boardSize, Pattern patternType, float squareSize, float aspectRatio,
+        int flags, int maxViews, double tolerance, vector<vector<Point2f> > &imagePoints )
+{
+    vector<bool> used( views.size( ), false );
+    vector<int> selected;
+    uint64_t covered = 0;
+
+    vector<Point3f> boardPoints;
+    calcChessboardCorners( boardSize, squareSize, boardPoints, patternType );
+
+    Mat cameraMatrix = Mat::eye( 3, 3, CV_64F );
+    if( flags & CV_CALIB_FIX_ASPECT_RATIO )
+        cameraMatrix.at<double>( 0, 0 ) = aspectRatio;
+    Mat distCoeffs = Mat::zeros( 8, 1, CV_64F );
+
+    double prevRms = 0;
+    Mat prevCameraMatrix;
+    int stableSteps = 0;
+
+    imagePoints.clear( );
+
+    while( ( int ) selected.size( ) < maxViews )
+    {
+        // add the next best views
+        const int toAdd = selected.empty( ) ? MIN_INCREMENTAL_VIEWS : INCREMENTAL_STEP;
+        int added = 0;
+        for( ; added < toAdd && ( int ) selected.size( ) < maxViews; ++added )
+        {
+            const int next = selectNextView( views, used, covered, selected );
+            if( next < 0 )
+                break;
+            used[next] = true;
+            covered |= views[next].cells;
+            selected.push_back( next );
+            imagePoints.push_back( views[next].corners );
+        }
+
+        if( added == 0 || imagePoints.size( ) < ( size_t ) MIN_INCREMENTAL_VIEWS )
+            break;
+
+        // re-solve starting from the previous solution
+        vector<vector<Point3f> > objectPoints( imagePoints.size( ), boardPoints );
+        vector<Mat> rvecs, tvecs;
+        const int guess = prevCameraMatrix.empty( ) ? 0 : CV_CALIB_USE_INTRINSIC_GUESS;
+        const double rms = calibrateCamera( objectPoints, imagePoints, imageSize, cameraMatrix,
+                distCoeffs, rvecs, tvecs, flags | guess | CV_CALIB_FIX_K4 | CV_CALIB_FIX_K5 );
+
+        printf( "%d views (%d%% coverage): RMS error %g, fx %g fy %g cx %g cy %g\n", ( int ) selected.size( ),
+                100 * countBits( covered ) / ( COVERAGE_GRID * COVERAGE_GRID ), rms,
+                cameraMatrix.at<double>( 0, 0 ), cameraMatrix.at<double>( 1, 1 ),
+                cameraMatrix.at<double>( 0, 2 ), cameraMatrix.at<double>( 1, 2 ) );
+
+        if( !prevCameraMatrix.empty( ) )
+        {
+            // largest relative change of the intrinsics and of the error
+            double change = std::abs( rms - prevRms ) / std::max( prevRms, 1e-9 );
+            const int idx[4][2] = { {0, 0}, {1, 1}, {0, 2}, {1, 2} };
+            for( int k = 0; k < 4; ++k )
+            {
+                const double prev = prevCameraMatrix.at<double>( idx[k][0], idx[k][1] );
+                const double curr = cameraMatrix.at<double>( idx[k][0], idx[k][1] );
+                change = std::max( change, std::abs( curr - prev ) / std::max( std::abs( prev ), 1e-9 ) );
+            }
+
+            stableSteps = ( change < tolerance ) ? stableSteps + 1 : 0;
+            if( stableSteps >= CONVERGED_STEPS )
+            {
+                printf( "Calibration converged with %d views\n", ( int ) selected.size( ) );
+                break;
+            }
+        }
+
+        prevRms = rms;
+        cameraMatrix.copyTo( prevCameraMatrix );
+    }
+}
+
+/**
+ * Batch calibration from an image list: the boards are detected in parallel,
+ * then the views are selected incrementally until the calibration converges
+ *
+ * @return true if the calibration succeeded
+ */
+static bool runBatchCalibration( const string& outputFilename, const vector<string> &imageList,
+        const Size &boardSize, Pattern patternType, float squareSize, float aspectRatio,
+        int flags, bool flipVertical, int maxViews, double tolerance,
+        bool writeExtrinsics, bool writePoints, float outlierThreshold )
+{
+    vector<BoardView> views( imageList.size( ) );
+
+    const int64 start = getTickCount( );
+    parallel_for_( Range( 0, ( int ) imageList.size( ) ),
+            BoardViewDetector( imageList, boardSize, patternType, flipVertical, views ) );
+
+    // all the views must have the size of the first valid one
+    Size imageSize;
+    int nfound = 0;
+    for( size_t i = 0; i < views.size( ); ++i )
+    {
+        if( !views[i].found )
+            continue;
+        if( imageSize.area( ) == 0 )
+            imageSize = views[i].imageSize;
+        if( views[i].imageSize != imageSize )
+        {
+            fprintf( stderr, "Skipping %s: its size differs from the other images\n", imageList[i].c_str( ) );
+            views[i].found = false;
+            continue;
+        }
+        ++nfound;
+    }
+
+    printf( "Board found in %d/%d images in %.2fs\n", nfound, ( int ) imageList.size( ),
+            ( getTickCount( ) - start ) / getTickFrequency( ) );
+
+    if( nfound < MIN_INCREMENTAL_VIEWS )
+    {
+        fprintf( stderr, "Not enough views to calibrate\n" );
+        return false;
+    }
+
+    vector<vector<Point2f> > imagePoints;
+    selectViewsIncrementally( views, imageSize, boardSize, patternType, squareSize, aspectRatio,
+            flags, maxViews, tolerance, imagePoints );
+
+    Mat cameraMatrix, distCoeffs;
+    return runAndSave( outputFilename, imagePoints, imageSize,
+            boardSize, patternType, squareSize, aspectRatio,
+            flags, cameraMatrix, distCoeffs,
+            writeExtrinsics, writePoints, outlierThreshold );
+}
+
 int main( int argc, char** argv )
 {
     Size boardSize, imageSize;
@@ -313,6 +834,10 @@ int main( int argc, char** argv )
     bool flipVertical = false;
     bool showUndistorted = false;
     bool videofile = false;
+    bool batchMode = false;
+    bool nframesSet = false;
+    double tolerance = 0.005;
+    float outlierThreshold = 0;
     int delay = 1000;
     clock_t prevTimestamp = 0;
     int mode = DETECTION;
@@ -361,6 +886,7 @@ int main( int argc, char** argv )
         {
             if( sscanf( argv[++i], "%u", &nframes ) != 1 || nframes <= 3 )
                 return printf( "Invalid number of images\n" ), -1;
+            nframesSet = true;
         }
         else if( strcmp( s, "-a" ) == 0 )
         {
@@ -405,6 +931,20 @@ int main( int argc, char** argv )
         {
             showUndistorted = true;
         }
+        else if( strcmp( s, "-b" ) == 0 )
+        {
+            batchMode = true;
+        }
+        else if( strcmp( s, "-ot" ) == 0 )
+        {
+            if( sscanf( argv[++i], "%f", &outlierThreshold ) != 1 || outlierThreshold <= 0 )
+                return fprintf( stderr, "Invalid outlier threshold\n" ), -1;
+        }
+        else if( strcmp( s, "-ct" ) == 0 )
+        {
+            if( sscanf( argv[++i], "%lf", &tolerance ) != 1 || tolerance <= 0 )
+                return fprintf( stderr, "Invalid convergence tolerance\n" ), -1;
+        }
         else if( s[0] != '-' )
         {
             if( isdigit( s[0] ) )
@@ -431,6 +971,16 @@ int main( int argc, char** argv )
     if( !capture.isOpened( ) && imageList.empty( ) )
         return fprintf( stderr, "Could not initialize video (%d) capture\n", cameraId ), -2;
 
+    if( batchMode )
+    {
+        if( imageList.empty( ) )
+            return fprintf( stderr, "The batch mode needs a list of images\n" ), -1;
+
+        return runBatchCalibration( outputFilename, imageList, boardSize, pattern, squareSize,
+                aspectRatio, flags, flipVertical, nframesSet ? nframes : ( int ) imageList.size( ),
+                tolerance, writeExtrinsics, writePoints, outlierThreshold ) ? 0 : -1;
+    }
+
     if( !imageList.empty( ) )
         nframes = ( int ) imageList.size( );
 
@@ -448,7 +998,7 @@ int main( int argc, char** argv )
     for( i = 0;; i++ )
     {
         int key = 0;
-        Mat view, viewGray;
+        Mat view;
         bool blink = false;
 
         if( capture.isOpened( ) )
@@ -466,7 +1016,7 @@ int main( int argc, char** argv )
                 runAndSave( outputFilename, imagePoints, imageSize,
                     boardSize, pattern, squareSize, aspectRatio,
                     flags, cameraMatrix, distCoeffs,
-                    writeExtrinsics, writePoints );
+                    writeExtrinsics, writePoints, outlierThreshold );
             break;
         }
 
@@ -476,28 +1026,7 @@ int main( int argc, char** argv )
             flip( view, view, 0 );
 
         vector<Point2f> pointbuf;
-        cvtColor( view, viewGray, CV_BGR2GRAY );
-
-        bool found;
-        switch( pattern )
-        {
-            case CHESSBOARD:
-                found = findChessboardCorners( view, boardSize, pointbuf,
-                        CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_FAST_CHECK | CV_CALIB_CB_NORMALIZE_IMAGE );
-                break;
-            case CIRCLES_GRID:
-                found = findCirclesGrid( view, boardSize, pointbuf );
-                break;
-            case ASYMMETRIC_CIRCLES_GRID:
-                found = findCirclesGrid( view, boardSize, pointbuf, CALIB_CB_ASYMMETRIC_GRID );
-                break;
-            default:
-                return fprintf( stderr, "Unknown pattern type\n" ), -1;
-        }
-
-        // improve the found corners' coordinate accuracy
-        if( pattern == CHESSBOARD && found ) cornerSubPix( viewGray, pointbuf, Size( 11, 11 ),
-                Size( -1, -1 ), TermCriteria( CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1 ) );
+        bool found = findPattern( view, boardSize, pattern, pointbuf );
 
         if( mode == CAPTURING && found &&
                 ( !capture.isOpened( ) || ( ( ( delay <= 0 ) && ( key == 't' ) ) || ( ( delay > 0 ) && ( clock( ) - prevTimestamp > delay * 1e-3 * CLOCKS_PER_SEC ) ) ) ) )
@@ -556,7 +1085,7 @@ int main( int argc, char** argv )
             if( runAndSave( outputFilename, imagePoints, imageSize,
                     boardSize, pattern, squareSize, aspectRatio,
                     flags, cameraMatrix, distCoeffs,
-                    writeExtrinsics, writePoints ) )
+                    writeExtrinsics, writePoints, outlierThreshold ) )
                 mode = CALIBRATED;
             else
                 mode = DETECTION;
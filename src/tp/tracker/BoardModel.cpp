@@ -0,0 +1,30 @@
+#include "tracker/BoardModel.hpp"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Generate the model of a board
+ *
+ * @param[in] boardSize the number of points per row and column
+ * @param[in] pattern the type of pattern
+ * @param[in] squareSize the size of the squares
+ */
+BoardModel::BoardModel( const cv::Size &boardSize, Pattern pattern, float squareSize )
+: _size( boardSize ), _pattern( pattern )
+{
+    if( boardSize == Chessboard9x6::size( ) && pattern == Chessboard9x6::PATTERN )
+    {
+        generate<Chessboard9x6>( squareSize );
+    }
+    else if( boardSize == AsymmetricCircles4x11::size( ) && pattern == AsymmetricCircles4x11::PATTERN )
+    {
+        generate<AsymmetricCircles4x11>( squareSize );
+    }
+    else
+    {
+        // any other board is generated at runtime
+        calcChessboardCorners( boardSize, squareSize, _points, pattern );
+        calcChessboardCorners3D( boardSize, squareSize, _points3D, pattern );
+    }
+}
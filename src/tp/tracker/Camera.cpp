@@ -1,18 +1,71 @@
 #include "tracker/Camera.hpp"
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 using namespace cv;
 
+// identifies the binary calibration cache, the last digits are the version
+// of the layout and must be changed every time CacheHeader changes
+static const char CACHE_MAGIC[8] = { 'C', 'A', 'L', 'I', 'B', '0', '0', '1' };
+
+// the maximum number of distortion coefficients handled by OpenCV
+static const int MAX_DIST_COEFFS = 14;
+
+// header of the binary calibration cache, followed by the two maps
+// (width x height CV_16SC2 and width x height CV_8UC2)
+struct CacheHeader
+{
+    char magic[8];
+    // size and modification time of the calibration file the cache comes from
+    int64_t calibSize;
+    int64_t calibTime;
+    int32_t width;
+    int32_t height;
+    int32_t numDistCoeffs;
+    int32_t reserved;
+    double matK[9];
+    double distCoeff[MAX_DIST_COEFFS];
+};
+
 /**
- * Initialize the camera loading the internal parameters from the given file
+ * Initialize the camera loading the internal parameters from the given file.
+ * If useCache is true the parameters and the undistortion map are loaded
+ * (memory mapped) from the binary cache calibFilename + ".bin", which is
+ * (re)generated whenever it is missing or the calibration file has changed
  *
  * @param[in] calibFilename the calibration file
+ * @param[in] useCache true to use the binary cache
  * @return true if success
  */
-bool Camera::init( std::string calibFilename )
+bool Camera::init( const std::string &calibFilename, bool useCache )
 {
+    // the size and the modification time of the calibration file identify
+    // the version the cache has been generated from
+    struct stat calibStat;
+    if( stat( calibFilename.c_str( ), &calibStat ) != 0 )
+    {
+        cerr << "Could not find the calibration file " << calibFilename << endl;
+        return false;
+    }
+
+    const string cacheFilename = calibFilename + ".bin";
+    if( useCache && loadCache( cacheFilename, calibStat.st_size, calibStat.st_mtime ) )
+        return true;
+
     // object that will parse the file
     FileStorage fs;
 
@@ -22,7 +75,7 @@ bool Camera::init( std::string calibFilename )
     // check if the file storage has been opened correclty
     if (!opened) {
         cerr << "Aborting..." << endl;
-        return EXIT_FAILURE;
+        return false;
     }
 
     // load the camera_matrix in matK
@@ -39,6 +92,191 @@ bool Camera::init( std::string calibFilename )
     cout << Camera::distCoeff << endl;
     cout << Camera::imageSize << endl;
 
+    // build the undistortion map once for all the trackers using this camera
+    _cacheData.reset( );
+    undistorter.init( matK, distCoeff, imageSize );
+
+    if( useCache && !saveCache( cacheFilename, calibStat.st_size, calibStat.st_mtime ) )
+        cerr << "Could not write the calibration cache " << cacheFilename << endl;
+
+    return true;
+}
+
+/**
+ * Return an undistorter for frames of the given size. The one built at
+ * init is returned if the size matches the calibration, otherwise
+ * fallback is (re)initialized if needed and returned
+ *
+ * @param[in] frameSize the size of the frames to undistort
+ * @param[in,out] fallback the undistorter to use if the size does not match the calibration
+ * @return the undistorter to use
+ */
+const Undistorter & Camera::getUndistorter( const cv::Size &frameSize, Undistorter &fallback ) const
+{
+    if( undistorter.getImageSize( ) == frameSize )
+        return undistorter;
+
+    if( fallback.getImageSize( ) != frameSize )
+        fallback.init( matK, distCoeff, frameSize );
+    return fallback;
+}
+
+/**
+ * Return the camera with the intrinsics scaled for frames of a different
+ * resolution (e.g. downscaled frames to process faster). The distortion
+ * coefficients do not depend on the resolution
+ *
+ * @param[in] targetSize the size of the frames of the new camera
+ * @return the scaled camera, its undistortion map is not built
+ */
+Camera Camera::scaled( const cv::Size &targetSize ) const
+{
+    Camera result;
+    result.imageSize = targetSize;
+    distCoeff.copyTo( result.distCoeff );
+
+    const double sx = ( double ) targetSize.width / imageSize.width;
+    const double sy = ( double ) targetSize.height / imageSize.height;
+
+    // the focal lengths and the skew scale with the pixels, the principal point
+    // is scaled wrt the corner of the image (the pixel centers are at +0.5)
+    matK.convertTo( result.matK, CV_64F );
+    result.matK.at<double>( 0, 0 ) *= sx;
+    result.matK.at<double>( 0, 1 ) *= sx;
+    result.matK.at<double>( 0, 2 ) = ( result.matK.at<double>( 0, 2 ) + 0.5 ) * sx - 0.5;
+    result.matK.at<double>( 1, 1 ) *= sy;
+    result.matK.at<double>( 1, 2 ) = ( result.matK.at<double>( 1, 2 ) + 0.5 ) * sy - 0.5;
+
+    return result;
+}
+
+/**
+ * Load the parameters and the undistortion map from the binary cache
+ *
+ * @param[in] cacheFilename the binary cache
+ * @param[in] calibSize the size of the calibration file
+ * @param[in] calibTime the modification time of the calibration file
+ * @return true if the cache exists and has been generated from the current calibration file
+ */
+bool Camera::loadCache( const std::string &cacheFilename, int64_t calibSize, int64_t calibTime )
+{
+    shared_ptr<const void> data;
+    size_t dataSize = 0;
+
+#ifdef _WIN32
+    // no mmap, read the whole file
+    ifstream in( cacheFilename.c_str( ), ios::binary | ios::ate );
+    if( !in )
+        return false;
+    dataSize = static_cast<size_t>( in.tellg( ) );
+    shared_ptr<char> buffer( new char[dataSize], default_delete<char[]>( ) );
+    in.seekg( 0 );
+    if( !in.read( buffer.get( ), dataSize ) )
+        return false;
+    data = buffer;
+#else
+    const int fd = open( cacheFilename.c_str( ), O_RDONLY );
+    if( fd < 0 )
+        return false;
+    struct stat cacheStat;
+    if( fstat( fd, &cacheStat ) != 0 || cacheStat.st_size < ( off_t ) sizeof( CacheHeader ) )
+    {
+        close( fd );
+        return false;
+    }
+    dataSize = static_cast<size_t>( cacheStat.st_size );
+    void *mapped = mmap( nullptr, dataSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+    // the mapping stays valid after closing the descriptor
+    close( fd );
+    if( mapped == MAP_FAILED )
+        return false;
+    data = shared_ptr<const void>( mapped, [dataSize]( const void *p ) { munmap( const_cast<void *>( p ), dataSize ); } );
+#endif
+
+    // check the cache has been generated from the current calibration file
+    if( dataSize < sizeof( CacheHeader ) )
+        return false;
+    const CacheHeader &header = *static_cast<const CacheHeader *>( data.get( ) );
+    if( memcmp( header.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) ) != 0
+        || header.calibSize != calibSize || header.calibTime != calibTime
+        || header.width <= 0 || header.height <= 0
+        || header.numDistCoeffs < 0 || header.numDistCoeffs > MAX_DIST_COEFFS )
+        return false;
+
+    const size_t numPixels = static_cast<size_t>( header.width ) * header.height;
+    if( dataSize != sizeof( CacheHeader ) + numPixels * ( 4 + 2 ) )
+        return false;
+
+    // the parameters are small, copy them
+    Mat( 3, 3, CV_64F, const_cast<double *>( header.matK ) ).copyTo( matK );
+    Mat( header.numDistCoeffs, 1, CV_64F, const_cast<double *>( header.distCoeff ) ).copyTo( distCoeff );
+    imageSize = Size( header.width, header.height );
+
+    // the maps are used directly from the mapped memory
+    uchar *maps = static_cast<uchar *>( const_cast<void *>( data.get( ) ) ) + sizeof( CacheHeader );
+    const Mat mapXY( imageSize, CV_16SC2, maps );
+    const Mat mapW( imageSize, CV_8UC2, maps + numPixels * 4 );
+    undistorter.setMaps( mapXY, mapW );
+
+    _cacheData = data;
+    return true;
+}
+
+/**
+ * Write the parameters and the undistortion map to the binary cache. The file
+ * is written under a temporary name and then renamed, so that processes
+ * starting at the same time never see a partial cache
+ *
+ * @param[in] cacheFilename the binary cache
+ * @param[in] calibSize the size of the calibration file
+ * @param[in] calibTime the modification time of the calibration file
+ * @return true if success
+ */
+bool Camera::saveCache( const std::string &cacheFilename, int64_t calibSize, int64_t calibTime ) const
+{
+    const Mat &mapXY = undistorter.getMapXY( );
+    const Mat &mapW = undistorter.getMapW( );
+    if( matK.rows != 3 || matK.cols != 3 || distCoeff.total( ) > ( size_t ) MAX_DIST_COEFFS
+        || mapXY.empty( ) || !mapXY.isContinuous( ) || !mapW.isContinuous( ) )
+        return false;
+
+    CacheHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) );
+    header.calibSize = calibSize;
+    header.calibTime = calibTime;
+    header.width = imageSize.width;
+    header.height = imageSize.height;
+    header.numDistCoeffs = static_cast<int32_t>( distCoeff.total( ) );
+
+    Mat K( 3, 3, CV_64F, header.matK );
+    matK.convertTo( K, CV_64F );
+    Mat D( header.numDistCoeffs, 1, CV_64F, header.distCoeff );
+    distCoeff.reshape( 1, header.numDistCoeffs ).convertTo( D, CV_64F );
+
+    const string tmpFilename = cacheFilename + "." + to_string( getpid( ) ) + ".tmp";
+    {
+        ofstream out( tmpFilename.c_str( ), ios::binary | ios::trunc );
+        out.write( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+        out.write( reinterpret_cast<const char *>( mapXY.data ), mapXY.total( ) * mapXY.elemSize( ) );
+        out.write( reinterpret_cast<const char *>( mapW.data ), mapW.total( ) * mapW.elemSize( ) );
+        if( !out )
+        {
+            out.close( );
+            remove( tmpFilename.c_str( ) );
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    // rename does not replace an existing file on windows
+    remove( cacheFilename.c_str( ) );
+#endif
+    if( rename( tmpFilename.c_str( ), cacheFilename.c_str( ) ) != 0 )
+    {
+        remove( tmpFilename.c_str( ) );
+        return false;
+    }
     return true;
 }
 
@@ -27,41 +27,80 @@ bool ChessboardCameraTracker::process( cv::Mat &view, cv::Mat &pose, const Camer
     // contains the points detected on the chessboard
     vector<Point2f> corners;
 
+    // contains the grey version of the undistorted frame
+    Mat viewGrey;
+
     //******************************************************************/
     // undistort the input image. view at the end must contain the undistorted version
-    // of the image.
+    // of the image. The grey version is computed in the same pass.
+    // When working in the distorted space the image is only converted to grey.
     //******************************************************************/
-    Mat temp = view.clone();
-    undistort(temp, view, cam.matK, cam.distCoeff);
+    if( _undistortFrame )
+    {
+        // the camera map is used unless the frames have a different size
+        cam.getUndistorter( view.size( ), _undistorter ).process( view, view, viewGrey );
+    }
+    else
+    {
+        cvtColor( view, viewGrey, CV_BGR2GRAY );
+    }
+
+    // the detection may work on a downscaled frame, with the intrinsics scaled accordingly
+    const Camera &procCam = prepareProcessingFrame( cam, viewGrey );
 
     //******************************************************************/
     // detect the chessboard
     //******************************************************************/
-    found = detectChessboard(view, corners, boardSize, pattern);
+    // the frames rejected by the quality gate are not searched at all
+    if( passQualityGate( viewGrey, boardSize, pattern ) )
+        found = detectChessboard(viewGrey, corners, boardSize, pattern, _detector, _prevCorners, getProcessingTiledBoardSide( ));
+
+    // the order of the circles of this frame helps ordering the next ones
+    if( found )
+        _prevCorners = corners;
+    else
+        _prevCorners.clear( );
 
-    cout << ( (!found ) ? ( "No c" ) : ("C") ) << "hessboard detected!" << endl;
+    if( _verbose )
+        cout << ( _gateRejected ? "Frame rejected by the quality gate, no c" : ( !found ) ? "No c" : "C" ) << "hessboard detected!" << endl;
 
     //******************************************************************/
     // if a chessboard is found, estimate the homography
     //******************************************************************/
     if( found )
     {
-        // contains the points on the chessboard
-        vector<Point2f> objectPoints;
+        // bring only the detected corners to the undistorted image space
+        if( !_undistortFrame )
+        {
+            vector<Point2f> distorted;
+            distorted.swap( corners );
+            undistortPoints( distorted, corners, procCam.matK, procCam.distCoeff, noArray( ), procCam.matK );
+        }
 
-        // generate the points on the chessboard
-        const float squareSize = 25.0f;
-        calcChessboardCorners(boardSize, squareSize, objectPoints, pattern);
+        // the points on the chessboard, generated once for all the frames
+        const BoardModel &board = getBoardModel( boardSize, pattern );
+        const vector<Point2f> &objectPoints = board.getPoints( );
 
-        // estimate the homography
-        Mat H = findHomography(objectPoints, corners, CV_RANSAC);
+        // estimate the homography: all the corners of a full detection are
+        // correct, so the closed form (normalized DLT) is enough, no need for RANSAC
+        Mat H = normalizedDLTHomography(objectPoints, corners);
+        if( H.empty( ) )
+            return false;
 
-        cout << "H = " << H << endl << endl;
-        cout << "corners =" << corners << endl << endl;
-        cout << "ptsOb =" << objectPoints << endl << endl;
+#if DEBUGGING
+        if( _verbose )
+        {
+            cout << "H = " << H << endl << endl;
+            cout << "corners =" << corners << endl << endl;
+            cout << "ptsOb =" << objectPoints << endl << endl;
+        }
+#endif
 
         // decompose the homography
-        decomposeHomography(H, cam.matK, pose);
+        decomposeHomography(H, procCam.matK, pose);
+
+        // refine the pose with a few Levenberg-Marquardt iterations (the corners are undistorted)
+        refinePoseLM(board.getPoints3D( ), corners, procCam.matK, Mat::zeros( 5, 1, CV_32F ), pose);
 
     }
     return found;
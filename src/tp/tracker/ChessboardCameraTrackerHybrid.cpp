@@ -0,0 +1,172 @@
+#include "tracker/ChessboardCameraTrackerHybrid.hpp"
+#include "tracker/utility.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include <iostream>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Set up the tracker, the background detection worker is started when the first frame is handed to it
+ *
+ * @param[in] redetectionPeriod the number of frames between two background detections, 0 to disable them
+ */
+ChessboardCameraTrackerHybrid::ChessboardCameraTrackerHybrid( int redetectionPeriod )
+: _redetectionPeriod( redetectionPeriod )
+{
+}
+
+/**
+ * Stop and join the background detection worker
+ */
+ChessboardCameraTrackerHybrid::~ChessboardCameraTrackerHybrid( )
+{
+    {
+        lock_guard<mutex> lock( _mutex );
+        _stop = true;
+    }
+    _jobReady.notify_one( );
+    if( _worker.joinable( ) )
+        _worker.join( );
+}
+
+/**
+ * It tracks the chessboard with the KLT, merging the background detections
+ *
+ * @param[in,out] view the original image
+ * @param[out] pose the pose of the camera
+ * @param[in] cam the camera
+ * @param[in] boardSize the size of the chessboard to detect
+ * @param[in] pattern the type of pattern to detect
+ * @return true if the chessboard has been found
+ */
+bool ChessboardCameraTrackerHybrid::process( cv::Mat &view, cv::Mat &pose, const Camera & cam, const cv::Size &boardSize, const Pattern &pattern )
+{
+    // merge the detection finished since the last frame, if any
+    _mergedDetection = false;
+    mergeDetection( );
+
+    const bool found = ChessboardCameraTrackerKLT::process( view, pose, cam, boardSize, pattern );
+
+    // while tracking, hand a frame to the worker every _redetectionPeriod frames
+    ++_framesSinceSubmission;
+    if( found && _redetectionPeriod > 0 && _framesSinceSubmission >= _redetectionPeriod )
+    {
+        lock_guard<mutex> lock( _mutex );
+        if( !_busy )
+        {
+            // _prevGrey now contains the grey version of the current frame
+            _prevGrey.copyTo( _jobGrey );
+            _jobBoardSize = boardSize;
+            _jobPattern = pattern;
+            _jobDetector = _detector;
+
+            // the tracked corners in the order of the board, if none is
+            // missing, so that a circles' grid is detected in the same order
+            _jobLayout.clear( );
+            if( _corners.size( ) == ( size_t ) boardSize.area( ) )
+            {
+                _jobLayout.resize( _corners.size( ) );
+                for( size_t i = 0; i < _corners.size( ); ++i )
+                    _jobLayout[_cornerIds[i]] = _corners[i];
+            }
+            _busy = true;
+            _hasJob = true;
+            _framesSinceSubmission = 0;
+
+            // the worker waits for the lock before looking for the job
+            if( !_worker.joinable( ) )
+                _worker = thread( &ChessboardCameraTrackerHybrid::detectionLoop, this );
+            _jobReady.notify_one( );
+        }
+    }
+
+    return found;
+}
+
+/**
+ * The loop of the background worker: it waits for a frame and detects the chessboard in it
+ */
+void ChessboardCameraTrackerHybrid::detectionLoop( )
+{
+    unique_lock<mutex> lock( _mutex );
+    while( true )
+    {
+        _jobReady.wait( lock, [this] { return _stop || _hasJob; } );
+        if( _stop )
+            return;
+        _hasJob = false;
+
+        // the job is owned by the worker until _hasResult is set, detect without the lock
+        lock.unlock( );
+        vector<Point2f> corners;
+        const bool found = detectChessboard( _jobGrey, corners, _jobBoardSize, _jobPattern, _jobDetector, _jobLayout );
+        lock.lock( );
+
+        _jobFound = found;
+        _jobCorners.swap( corners );
+        _hasResult = true;
+    }
+}
+
+/**
+ * Replace the tracked corners with the ones of a finished detection. The
+ * detected corners are brought from the frame they were detected in to the
+ * last processed one (_prevGrey) with the optical flow, so that the KLT can
+ * go on tracking them from there
+ */
+void ChessboardCameraTrackerHybrid::mergeDetection( )
+{
+    {
+        lock_guard<mutex> lock( _mutex );
+        if( !_hasResult )
+            return;
+        _hasResult = false;
+    }
+
+    // the worker is idle until _busy is reset, the job can be read without the lock
+    const bool found = _jobFound && !_prevGrey.empty( ) && _jobGrey.size( ) == _prevGrey.size( );
+    if( found )
+    {
+        // the model of the board, if the tracker has never detected it
+        if( _boardPoints.size( ) != _jobCorners.size( ) )
+            _boardPoints = getBoardModel( _jobBoardSize, _jobPattern ).getPoints3D( );
+
+        // from the detection frame to the last processed frame
+        vector<Point2f> corners;
+        vector<uchar> status;
+        vector<float> err;
+        TermCriteria termcrit( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 );
+        calcOpticalFlowPyrLK( _jobGrey, _prevGrey, _jobCorners, corners, status, err, Size( 11, 11 ), 3, termcrit );
+
+        vector<Point2f> mergedCorners;
+        vector<Point3f> mergedObjectPoints;
+        vector<int> mergedIds;
+        for( size_t i = 0; i < corners.size( ); ++i )
+        {
+            if( status[i] > 0 )
+            {
+                mergedCorners.push_back( corners[i] );
+                mergedObjectPoints.push_back( _boardPoints[i] );
+                mergedIds.push_back( ( int ) i );
+            }
+        }
+
+        // the detection is drift free, it replaces the tracked set if enough points survived
+        if( mergedCorners.size( ) >= 10 && mergedCorners.size( ) >= _corners.size( ) / 2 )
+        {
+            _corners.swap( mergedCorners );
+            _objectPoints.swap( mergedObjectPoints );
+            _cornerIds.swap( mergedIds );
+            _mergedDetection = true;
+        }
+        if( _verbose )
+            cout << "Background detection " << ( _mergedDetection ? "merged" : "discarded" ) << endl;
+    }
+
+    lock_guard<mutex> lock( _mutex );
+    _busy = false;
+}
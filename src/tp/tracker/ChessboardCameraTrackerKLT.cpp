@@ -1,15 +1,26 @@
 #include "tracker/ChessboardCameraTrackerKLT.hpp"
+#include "tracker/PartialBoardDetector.hpp"
 #include "tracker/utility.hpp"
 
 #include <opencv2/calib3d/calib3d.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/video/tracking.hpp>
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 using namespace std;
 using namespace cv;
 
+namespace
+{
+
+// the maximum number of frames between two full detections while the board is occluded
+const int MAX_DETECTION_BACKOFF = 8;
+
+}
+
 /**
  * It detects a chessboard inside an image and if found it returns the pose of the camera wrt the chessboard
  *
@@ -25,35 +36,161 @@ bool ChessboardCameraTrackerKLT::process( cv::Mat &view, cv::Mat &pose, const Ca
     // true if the chessboard is found
     bool found = false;
 
-    // undistort the input image. view at the end must contain the undistorted version
-    // of the image.
-    Mat temp = view.clone( );
-    undistort(temp, view, cam.matK, cam.distCoeff);
-
     // contains the zeros vector for dist coeffs
     Mat zeroDistCoeff = Mat::zeros( 5, 1, CV_32F );
 
+    // the distortion to use for the pose estimation: none if the frame is
+    // undistorted, the camera one if we track on the distorted frame
+    const Mat distCoeff = _undistortFrame ? zeroDistCoeff : cam.distCoeff;
+
     // contains the grey version of the current frame
     Mat viewGrey;
 
-    // convert the current left frame into greylevel image
-    cvtColor(view, viewGrey, CV_BGR2GRAY);
+    // undistort the input image. view at the end must contain the undistorted version
+    // of the image. The greylevel image is computed in the same pass.
+    // When working in the distorted space the image is only converted to grey.
+    if( _undistortFrame )
+    {
+        // the camera map is used unless the frames have a different size
+        cam.getUndistorter( view.size( ), _undistorter ).process( view, view, viewGrey );
+    }
+    else
+    {
+        cvtColor( view, viewGrey, CV_BGR2GRAY );
+    }
+
+    // the detection and the tracking may work on a downscaled frame, with the
+    // intrinsics scaled accordingly (the poses do not depend on the resolution)
+    const Camera &procCam = prepareProcessingFrame( cam, viewGrey );
+
+    // the tracked corners are lost if the resolution of the frames changes
+    if( _prevGrey.size( ) != viewGrey.size( ) )
+        _corners.clear( );
+
+    _lastPnPPath = PNP_NONE;
+    _numReseeded = 0;
+    _static = false;
+    _gateRejected = false;
+    _partial = false;
+    _frameUnchanged = false;
+
+    // the largest difference between the thumbnails of the frames, for the
+    // motion gate: a local change (e.g. someone walking by) is not averaged out
+    double frameDifference = 0;
+    if( _staticMaxFrameDifference > 0 )
+    {
+        const int thumbnailReduction = 8;
+        Mat thumbnail;
+        resize( viewGrey, thumbnail, Size( viewGrey.cols / thumbnailReduction, viewGrey.rows / thumbnailReduction ), 0, 0, INTER_AREA );
+        if( _prevThumbnail.size( ) == thumbnail.size( ) )
+        {
+            Mat diff;
+            absdiff( thumbnail, _prevThumbnail, diff );
+            minMaxLoc( diff, NULL, &frameDifference );
+        }
+        else
+        {
+            frameDifference = 255;
+        }
+        _prevThumbnail = thumbnail;
+        _frameUnchanged = frameDifference <= _staticMaxFrameDifference;
+    }
+
+    // predict the pose for this frame from the previous ones
+    _predictedPose.release( );
+    _predictor.predict( _predictedPose );
 
     // if we have too few points or none
     if( _corners.size( ) < 10 )
     {
-        // detect the chessboard
-        found = detectChessboard(view, _corners, boardSize, pattern);
-        cout << ( (!found ) ? ( "No c" ) : ("C") ) << "hessboard detected!" << endl;
+        // the last pose before the loss anchors the search of the visible part
+        // of the board, as long as the board can still be where it was
+        if( !_lastPose.empty( ) && _maxAnchorAge > 0 && pattern == CHESSBOARD )
+        {
+            _lastPose.copyTo( _anchorPose );
+            _anchorAge = 0;
+        }
+        else if( !_anchorPose.empty( ) && ++_anchorAge > _maxAnchorAge )
+        {
+            _anchorPose.release( );
+            _detectionBackoff = 0;
+            _framesToDetection = 0;
+        }
 
-        if( found )
+        // the tracking has been lost, the motion of the previous frames is meaningless
+        _predictor.reset( );
+        _predictedPose.release( );
+        _lastPose.release( );
+        _poseCorners.clear( );
+        _poseCornerValid.clear( );
+
+        // the board is probably occluded, look for its visible part around the anchor
+        if( !_anchorPose.empty( ) )
+            found = reacquirePartialBoard( viewGrey, pose, procCam, distCoeff, boardSize, pattern );
+
+        // the full detections fail as long as the board is occluded, they are
+        // run less and less often while the anchor is valid
+        if( !found && _framesToDetection > 0 )
+        {
+            --_framesToDetection;
+            _corners.clear( );
+            if( _verbose )
+                cout << "Full detection postponed, the chessboard is occluded" << endl;
+        }
+        else if( !found )
         {
-            // generate the points on the chessboard, this time 3D points
-            const float squareSize = 25.0f;
-            calcChessboardCorners3D(boardSize, squareSize, _objectPoints, pattern);
+            // detect the chessboard, unless the quality gate rejects the frame
+            if( passQualityGate( viewGrey, boardSize, pattern ) )
+                found = detectChessboard(viewGrey, _corners, boardSize, pattern, _detector, vector<Point2f>( ), getProcessingTiledBoardSide( ));
+            else
+                _corners.clear( );
+            if( _verbose )
+                cout << ( _gateRejected ? "Frame rejected by the quality gate, no c" : ( !found ) ? "No c" : "C" ) << "hessboard detected!" << endl;
 
-            // compute the pose of the camera using mySolvePnPRansac
-            mySolvePnPRansac(_objectPoints, _corners, cam.matK, zeroDistCoeff, pose);
+            // findChessboardCorners returns the corners it found even when it
+            // fails: they must not be tracked without their ids and 3D points
+            if( !found )
+            {
+                _corners.clear( );
+                _objectPoints.clear( );
+                _cornerIds.clear( );
+            }
+
+            if( !found && !_anchorPose.empty( ) )
+            {
+                _detectionBackoff = min( max( 2 * _detectionBackoff, 1 ), MAX_DETECTION_BACKOFF );
+                _framesToDetection = _detectionBackoff;
+            }
+
+            if( found )
+            {
+                _anchorPose.release( );
+                _detectionBackoff = 0;
+
+                // the 3D points on the chessboard, generated once for all the detections;
+                // the whole model is kept to recover the corners lost later
+                _boardPoints = getBoardModel( boardSize, pattern ).getPoints3D( );
+                _objectPoints = _boardPoints;
+                _cornerIds.resize( _corners.size( ) );
+                for( size_t id = 0; id < _cornerIds.size( ); ++id )
+                    _cornerIds[id] = ( int ) id;
+
+                // compute the pose of the camera: all the correspondences of a full
+                // detection are correct, so use the closed form planar pose instead
+                // of RANSAC (mySolvePnPRansac only if it fails)
+                if( solvePlanarPose(_objectPoints, _corners, procCam.matK, distCoeff, pose) )
+                {
+                    _lastPnPPath = PNP_PLANAR;
+                }
+                else
+                {
+                    mySolvePnPRansac(_objectPoints, _corners, procCam.matK, distCoeff, pose);
+                    _lastPnPPath = PNP_RANSAC;
+                }
+                _predictor.update( pose );
+                pose.copyTo( _lastPose );
+                rememberPoseCorners( );
+            }
         }
 
     }
@@ -63,11 +200,24 @@ bool ChessboardCameraTrackerKLT::process( cv::Mat &view, cv::Mat &pose, const Ca
 
         // some parameters for the optical flow algorithm
         Size winSize( 11, 11 );
+        int maxLevel = 3;
+        int flags = 0;
         TermCriteria termcrit( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 );
 
         // vector where the estimated tracked points of the new frame will be stored
         vector<Point2f> currPts;
 
+        // if the motion model has a prediction, project the board points with
+        // the predicted pose and use them as initial flow: the residual motion is
+        // small so fewer pyramid levels and iterations are enough
+        if( !_predictedPose.empty( ) )
+        {
+            myProjectPoints( _objectPoints, _predictedPose, procCam.matK, distCoeff, currPts );
+            flags = OPTFLOW_USE_INITIAL_FLOW;
+            maxLevel = 1;
+            termcrit = TermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 10, 0.03 );
+        }
+
         // auxiliary stuff for the optical flow computation
         // status has will have the same length as currPts and is 0 if the
         // optical flow estimation for the corresponding new point is not good
@@ -75,7 +225,7 @@ bool ChessboardCameraTrackerKLT::process( cv::Mat &view, cv::Mat &pose, const Ca
         vector<float> err;
 
         // estimate the new position of the tracked points using calcOpticalFlowPyrLK
-        calcOpticalFlowPyrLK(_prevGrey, viewGrey, _corners, currPts, status, err, winSize, 3, termcrit);
+        calcOpticalFlowPyrLK(_prevGrey, viewGrey, _corners, currPts, status, err, winSize, maxLevel, termcrit, flags);
 
         //******************************************************************/
         // Filter currPts and update the lists _corners and _objectPoints: if
@@ -87,6 +237,11 @@ bool ChessboardCameraTrackerKLT::process( cv::Mat &view, cv::Mat &pose, const Ca
         // k is used to run through _corners and _objectPoints to keep only the well tracked features
         size_t i, k;
 
+        // the largest displacement of the well tracked points since the pose was
+        // last estimated, for the motion gate: measured from the previous frame
+        // a slow motion would never trigger the PnP and the pose would drift
+        float maxMotion2 = 0;
+
         for( i = k = 0; i < currPts.size( ); i++ )
         {
             //******************************************************************/
@@ -96,14 +251,28 @@ bool ChessboardCameraTrackerKLT::process( cv::Mat &view, cv::Mat &pose, const Ca
             if (status[i] > 0)
             {
 #if DEBUGGING
-                line( view, _corners[ i ], currPts[ i ], Scalar( 255, 0, 0 ), 1 );
-                circle( view, currPts[ i ], 3, Scalar( 255, 0, 255 ), -1, 8 );
+                // the points are at the processing resolution
+                const float toView = ( float ) view.cols / viewGrey.cols;
+                line( view, _corners[ i ] * toView, currPts[ i ] * toView, Scalar( 255, 0, 0 ), 1 );
+                circle( view, currPts[ i ] * toView, 3, Scalar( 255, 0, 255 ), -1, 8 );
 #endif
+                const int id = _cornerIds[i];
+                if( id < ( int ) _poseCornerValid.size( ) && _poseCornerValid[id] )
+                {
+                    const Point2f motion = currPts[i] - _poseCorners[id];
+                    maxMotion2 = max( maxMotion2, motion.dot( motion ) );
+                }
+                else
+                {
+                    maxMotion2 = numeric_limits<float>::max( );
+                }
+
                 // copy the current point in _corners
                 _corners[k] = currPts[i];
 
                 // copy the corresponding _objectPoints
                 _objectPoints[k] = _objectPoints[i];
+                _cornerIds[k] = _cornerIds[i];
 
                 // update k
                 ++k;
@@ -113,18 +282,51 @@ bool ChessboardCameraTrackerKLT::process( cv::Mat &view, cv::Mat &pose, const Ca
         // resize the two vector to the size k, the number of "well" tracked features
         _corners.resize( k );
         _objectPoints.resize( k );
+        _cornerIds.resize( k );
+
+        // motion gate: if nothing moved reuse the previous pose, no need for PnP
+        if( !_lastPose.empty( ) && k >= 10 && _staticMaxMotion > 0
+            && maxMotion2 <= _staticMaxMotion * _staticMaxMotion
+            && ( _staticMaxFrameDifference <= 0 || frameDifference <= _staticMaxFrameDifference ) )
+        {
+            _lastPose.copyTo( pose );
+            _lastPnPPath = PNP_STATIC;
+            _static = true;
+            _predictor.update( pose );
+            viewGrey.copyTo( _prevGrey );
+            return true;
+        }
 
         // vector containing the inliers
         vector<int> idxInl;
 
-        // compute the pose of the camera using mySolvePnPRansac
-        mySolvePnPRansac(_objectPoints, _corners, cam.matK, zeroDistCoeff, pose, idxInl);
+        // compute the pose of the camera refining the predicted (or the last)
+        // pose, mySolvePnP falls back to RANSAC if the refinement fails
+        const Mat &priorPose = _predictedPose.empty( ) ? _lastPose : _predictedPose;
+        _lastPnPPath = mySolvePnP(_objectPoints, _corners, procCam.matK, distCoeff, priorPose, pose, idxInl);
         PRINTVAR(pose);
 
+        // too few points survived the optical flow, detect the chessboard again
+        if( _lastPnPPath == PNP_NONE )
+        {
+            _corners.clear( );
+            viewGrey.copyTo( _prevGrey );
+            return false;
+        }
+
         // filter the points to remove the outliers. Use filterVector from utility.hpp
         // Filter both the image points and the 3D reference points
         filterVector(_corners, idxInl);
         filterVector(_objectPoints, idxInl);
+        filterVector(_cornerIds, idxInl);
+
+        // bring back the corners lost so far so that the tracked set stays
+        // (almost) complete and the full detection is rarely needed
+        reseedLostCorners( viewGrey, pose, procCam, distCoeff );
+
+        _predictor.update( pose );
+        pose.copyTo( _lastPose );
+        rememberPoseCorners( );
 
         found = true;
     }
@@ -134,3 +336,108 @@ bool ChessboardCameraTrackerKLT::process( cv::Mat &view, cv::Mat &pose, const Ca
 
     return found;
 }
+
+/**
+ * Recover the corners lost by the KLT: the missing corners of the board
+ * model are projected with the current pose, refined with refineCornersSubPix and
+ * re-inserted in the tracked set if they pass a local check
+ *
+ * @param[in] grey the current grey level frame
+ * @param[in] pose the pose of the current frame
+ * @param[in] cam the camera
+ * @param[in] distCoeff the distortion coefficients to use for the projection
+ */
+void ChessboardCameraTrackerKLT::reseedLostCorners( const cv::Mat &grey, const cv::Mat &pose, const Camera &cam, const cv::Mat &distCoeff )
+{
+    // half size of the refinement window
+    const int halfWin = 5;
+    // maximum distance in pixels between the projection and the refined corner
+    const float maxShift = 1.5f;
+
+    if( _corners.size( ) >= _boardPoints.size( ) )
+        return;
+
+    // the corners of the model that are not tracked anymore
+    vector<bool> tracked( _boardPoints.size( ), false );
+    for( size_t i = 0; i < _cornerIds.size( ); ++i )
+        tracked[ _cornerIds[i] ] = true;
+
+    vector<int> lostIds;
+    for( size_t id = 0; id < _boardPoints.size( ); ++id )
+    {
+        if( !tracked[id] )
+            lostIds.push_back( ( int ) id );
+    }
+
+    // refined around their projection with the current pose
+    vector<Point2f> recovered;
+    vector<int> recoveredIds;
+    findCornersNearProjection( grey, _boardPoints, lostIds, pose, cam.matK, distCoeff, halfWin, maxShift, recovered, recoveredIds );
+
+    for( size_t i = 0; i < recovered.size( ); ++i )
+    {
+        _corners.push_back( recovered[i] );
+        _objectPoints.push_back( _boardPoints[ recoveredIds[i] ] );
+        _cornerIds.push_back( recoveredIds[i] );
+        ++_numReseeded;
+    }
+}
+
+/**
+ * Re-acquire the visible part of an occluded board: the corners of the model
+ * are searched around their projection with the anchor pose (the last one
+ * before the tracking was lost), and the consistent ones become the tracked
+ * set. The corners hidden so far are recovered later by reseedLostCorners
+ *
+ * @param[in] grey the current grey level frame
+ * @param[out] pose the pose of the camera
+ * @param[in] cam the camera
+ * @param[in] distCoeff the distortion coefficients to use for the pose estimation
+ * @param[in] boardSize the size of the chessboard
+ * @param[in] pattern the type of pattern
+ * @return true if enough corners have been found
+ */
+bool ChessboardCameraTrackerKLT::reacquirePartialBoard( const cv::Mat &grey, cv::Mat &pose, const Camera &cam, const cv::Mat &distCoeff,
+                                                        const cv::Size &boardSize, Pattern pattern )
+{
+    const vector<Point3f> &model = getBoardModel( boardSize, pattern ).getPoints3D( );
+    if( !detectPartialChessboard( grey, model, _anchorPose, cam.matK, distCoeff, _corners, _cornerIds, pose ) )
+    {
+        _corners.clear( );
+        _cornerIds.clear( );
+        return false;
+    }
+    if( _verbose )
+        cout << "Partial chessboard recovered: " << _corners.size( ) << " of " << model.size( ) << " corners" << endl;
+
+    _boardPoints = model;
+    _objectPoints.resize( _cornerIds.size( ) );
+    for( size_t i = 0; i < _cornerIds.size( ); ++i )
+        _objectPoints[i] = _boardPoints[ _cornerIds[i] ];
+
+    _anchorPose.release( );
+    _detectionBackoff = 0;
+    _framesToDetection = 0;
+    _partial = true;
+
+    _lastPnPPath = PNP_RANSAC;
+    _predictor.update( pose );
+    pose.copyTo( _lastPose );
+    rememberPoseCorners( );
+    return true;
+}
+
+/**
+ * Store the position of the tracked corners for the pose just estimated,
+ * the motion gate measures the displacement of the corners from them
+ */
+void ChessboardCameraTrackerKLT::rememberPoseCorners( )
+{
+    _poseCorners.assign( _boardPoints.size( ), Point2f( ) );
+    _poseCornerValid.assign( _boardPoints.size( ), false );
+    for( size_t i = 0; i < _cornerIds.size( ); ++i )
+    {
+        _poseCorners[ _cornerIds[i] ] = _corners[i];
+        _poseCornerValid[ _cornerIds[i] ] = true;
+    }
+}
@@ -0,0 +1,190 @@
+#include "tracker/CircleGridDetector.hpp"
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+
+// the offset of the adaptive threshold: a pixel is dark if it is this much below the local mean
+const double THRESHOLD_OFFSET = 10;
+
+// the minimum area of a blob in pixels
+const double MIN_AREA = 25;
+
+// the minimum circularity 4 * pi * area / perimeter^2 of a blob
+const double MIN_CIRCULARITY = 0.7;
+
+// the minimum ratio between the smallest and the largest axis of inertia of a blob
+const double MIN_INERTIA_RATIO = 0.1;
+
+// the radius within which a blob matches a centre of the previous frame, as
+// a fraction of the distance between the nearest centres
+const float MATCH_RADIUS = 0.4f;
+
+/**
+ * Order the blobs as the centres of the previous frame: each centre, moved
+ * by the median motion of the grid, must have a blob of its own within the
+ * match radius
+ *
+ * @param[in] blobs the blobs of the frame
+ * @param[in] previous the centres of the previous frame
+ * @param[out] centres the blobs in the order of the previous centres
+ * @return true if every previous centre has been matched
+ */
+bool matchPreviousLayout( const vector<KeyPoint> &blobs, const vector<Point2f> &previous, vector<Point2f> &centres )
+{
+    if( blobs.size( ) < previous.size( ) )
+        return false;
+
+    // the distance between the nearest centres bounds the radius of the match
+    float minDist2 = FLT_MAX;
+    for( size_t i = 0; i < previous.size( ); ++i )
+    {
+        for( size_t j = i + 1; j < previous.size( ); ++j )
+        {
+            const Point2f d = previous[i] - previous[j];
+            minDist2 = min( minDist2, d.dot( d ) );
+        }
+    }
+    const float radius = MATCH_RADIUS * sqrt( minDist2 );
+
+    // the nearest blob of each centre, and the median motion of the grid
+    vector<int> nearest( previous.size( ) );
+    vector<float> dx( previous.size( ) ), dy( previous.size( ) );
+    for( size_t i = 0; i < previous.size( ); ++i )
+    {
+        float best = FLT_MAX;
+        for( size_t k = 0; k < blobs.size( ); ++k )
+        {
+            const Point2f d = blobs[k].pt - previous[i];
+            if( d.dot( d ) < best )
+            {
+                best = d.dot( d );
+                nearest[i] = ( int ) k;
+            }
+        }
+        dx[i] = blobs[nearest[i]].pt.x - previous[i].x;
+        dy[i] = blobs[nearest[i]].pt.y - previous[i].y;
+    }
+    const size_t mid = previous.size( ) / 2;
+    nth_element( dx.begin( ), dx.begin( ) + mid, dx.end( ) );
+    nth_element( dy.begin( ), dy.begin( ) + mid, dy.end( ) );
+    const Point2f motion( dx[mid], dy[mid] );
+
+    // every moved centre must have its own blob within the radius
+    vector<bool> used( blobs.size( ), false );
+    centres.resize( previous.size( ) );
+    for( size_t i = 0; i < previous.size( ); ++i )
+    {
+        const Point2f predicted = previous[i] + motion;
+        int match = -1;
+        float best = radius * radius;
+        for( size_t k = 0; k < blobs.size( ); ++k )
+        {
+            const Point2f d = blobs[k].pt - predicted;
+            if( d.dot( d ) < best )
+            {
+                best = d.dot( d );
+                match = ( int ) k;
+            }
+        }
+        if( match < 0 || used[match] )
+            return false;
+        used[match] = true;
+        centres[i] = blobs[match].pt;
+    }
+
+    return true;
+}
+
+}
+
+/**
+ * Detect the dark circular blobs of a circles' grid with a single pass
+ *
+ * @param[in] image the image to process, grey level or BGR
+ * @param[out] blobs the blobs, with their centre and diameter
+ */
+void detectCircleBlobs( const Mat &image, vector<KeyPoint> &blobs )
+{
+    blobs.clear( );
+
+    Mat grey;
+    if( image.channels( ) == 1 )
+        grey = image;
+    else
+        cvtColor( image, grey, CV_BGR2GRAY );
+
+    // the block of the adaptive threshold must be larger than the circles
+    const int blockSize = max( min( grey.rows, grey.cols ) / 8, 3 ) | 1;
+    Mat binary;
+    adaptiveThreshold( grey, binary, 255, ADAPTIVE_THRESH_MEAN_C, THRESH_BINARY_INV, blockSize, THRESHOLD_OFFSET );
+
+    // the outer boundaries of the dark components are the top level of the two level hierarchy
+    vector<vector<Point> > contours;
+    vector<Vec4i> hierarchy;
+    findContours( binary, contours, hierarchy, CV_RETR_CCOMP, CV_CHAIN_APPROX_NONE );
+
+    const double maxArea = grey.rows * grey.cols / 16.0;
+    for( size_t i = 0; i < contours.size( ); ++i )
+    {
+        if( hierarchy[i][3] >= 0 )
+            continue;
+
+        const Moments m = moments( contours[i] );
+        const double area = m.m00;
+        if( area < MIN_AREA || area > maxArea )
+            continue;
+
+        const double perimeter = arcLength( contours[i], true );
+        if( 4 * CV_PI * area < MIN_CIRCULARITY * perimeter * perimeter )
+            continue;
+
+        // the axes of inertia from the eigenvalues of the central moments
+        const double halfTrace = 0.5 * ( m.mu20 + m.mu02 );
+        const double delta = sqrt( 0.25 * ( m.mu20 - m.mu02 ) * ( m.mu20 - m.mu02 ) + m.mu11 * m.mu11 );
+        if( halfTrace - delta < MIN_INERTIA_RATIO * ( halfTrace + delta ) )
+            continue;
+
+        const Point2f centre( ( float ) ( m.m10 / m.m00 ), ( float ) ( m.m01 / m.m00 ) );
+        blobs.push_back( KeyPoint( centre, ( float ) ( 2 * sqrt( area / CV_PI ) ) ) );
+    }
+}
+
+/**
+ * Find a circles' grid with the blobs of detectCircleBlobs
+ *
+ * @param[in] image the image to process, grey level or BGR
+ * @param[in] patternSize the number of circles per row and column
+ * @param[out] centres the centres of the circles, in the same order as findCirclesGrid
+ * @param[in] asymmetric true for an asymmetric grid
+ * @param[in] previousLayout the centres found in the previous frame, empty if there are none
+ * @return true if the whole grid has been found
+ */
+bool findCirclesGridFast( const Mat &image, const Size &patternSize, vector<Point2f> &centres, bool asymmetric,
+                          const vector<Point2f> &previousLayout )
+{
+    vector<KeyPoint> blobs;
+    detectCircleBlobs( image, blobs );
+
+    const size_t numCircles = ( size_t ) patternSize.area( );
+    if( blobs.size( ) < numCircles )
+    {
+        centres.clear( );
+        return false;
+    }
+
+    if( previousLayout.size( ) == numCircles && matchPreviousLayout( blobs, previousLayout, centres ) )
+        return true;
+
+    const int flags = asymmetric ? CALIB_CB_ASYMMETRIC_GRID : CALIB_CB_SYMMETRIC_GRID;
+    return findCirclesGrid( image, patternSize, centres, flags, Ptr<FeatureDetector>( new PrecomputedBlobDetector( blobs ) ) );
+}
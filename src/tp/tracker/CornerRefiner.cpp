@@ -0,0 +1,287 @@
+#include "tracker/CornerRefiner.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define REFINER_USE_SSE2 1
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define REFINER_USE_NEON 1
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+
+// the number of corners refined together
+const int LANES = 4;
+
+// the arithmetic on the lanes, one corner per lane
+#if defined( REFINER_USE_SSE2 )
+typedef __m128 Lanes;
+inline Lanes load( const float *p ) { return _mm_loadu_ps( p ); }
+inline void store( float *p, Lanes a ) { _mm_storeu_ps( p, a ); }
+inline Lanes splat( float v ) { return _mm_set1_ps( v ); }
+inline Lanes add( Lanes a, Lanes b ) { return _mm_add_ps( a, b ); }
+inline Lanes sub( Lanes a, Lanes b ) { return _mm_sub_ps( a, b ); }
+inline Lanes mul( Lanes a, Lanes b ) { return _mm_mul_ps( a, b ); }
+#elif defined( REFINER_USE_NEON )
+typedef float32x4_t Lanes;
+inline Lanes load( const float *p ) { return vld1q_f32( p ); }
+inline void store( float *p, Lanes a ) { vst1q_f32( p, a ); }
+inline Lanes splat( float v ) { return vdupq_n_f32( v ); }
+inline Lanes add( Lanes a, Lanes b ) { return vaddq_f32( a, b ); }
+inline Lanes sub( Lanes a, Lanes b ) { return vsubq_f32( a, b ); }
+inline Lanes mul( Lanes a, Lanes b ) { return vmulq_f32( a, b ); }
+#else
+struct Lanes { float v[LANES]; };
+inline Lanes load( const float *p ) { Lanes r; for( int l = 0; l < LANES; ++l ) r.v[l] = p[l]; return r; }
+inline void store( float *p, Lanes a ) { for( int l = 0; l < LANES; ++l ) p[l] = a.v[l]; }
+inline Lanes splat( float v ) { Lanes r; for( int l = 0; l < LANES; ++l ) r.v[l] = v; return r; }
+inline Lanes add( Lanes a, Lanes b ) { for( int l = 0; l < LANES; ++l ) a.v[l] += b.v[l]; return a; }
+inline Lanes sub( Lanes a, Lanes b ) { for( int l = 0; l < LANES; ++l ) a.v[l] -= b.v[l]; return a; }
+inline Lanes mul( Lanes a, Lanes b ) { for( int l = 0; l < LANES; ++l ) a.v[l] *= b.v[l]; return a; }
+#endif
+
+// the 8 bit image the corners are refined on
+struct GreyImage
+{
+    const uchar *data;
+    int rows, cols;
+    size_t step;
+};
+
+/**
+ * Sample the patch of size x size pixels centred on a point with bilinear
+ * interpolation, replicating the border of the image (as getRectSubPix)
+ *
+ * @param[in] img the image
+ * @param[in] cx the x coordinate of the centre
+ * @param[in] cy the y coordinate of the centre
+ * @param[in] size the side length of the patch
+ * @param[out] patch the first value of the patch, the values are LANES floats apart
+ */
+void samplePatch( const GreyImage &img, float cx, float cy, int size, float *patch )
+{
+    const float x0 = cx - ( size - 1 ) * 0.5f;
+    const float y0 = cy - ( size - 1 ) * 0.5f;
+    const int ix = ( int ) floor( x0 );
+    const int iy = ( int ) floor( y0 );
+    const float a = x0 - ix, b = y0 - iy;
+    const float w00 = ( 1.f - a ) * ( 1.f - b ), w01 = a * ( 1.f - b );
+    const float w10 = ( 1.f - a ) * b, w11 = a * b;
+
+    // the columns of the samples, clamped to the image
+    int cols[64];
+    for( int x = 0; x <= size; ++x )
+        cols[x] = min( max( ix + x, 0 ), img.cols - 1 );
+
+    for( int y = 0; y < size; ++y )
+    {
+        const uchar *row0 = img.data + min( max( iy + y, 0 ), img.rows - 1 ) * img.step;
+        const uchar *row1 = img.data + min( max( iy + y + 1, 0 ), img.rows - 1 ) * img.step;
+        float *out = patch + y * size * LANES;
+        for( int x = 0; x < size; ++x )
+        {
+            out[x * LANES] = w00 * row0[cols[x]] + w01 * row0[cols[x + 1]] + w10 * row1[cols[x]] + w11 * row1[cols[x + 1]];
+        }
+    }
+}
+
+/**
+ * Refine up to LANES corners together. Each iteration solves, for every
+ * corner, the normal equations sum( g g^T ) c = sum( g g^T p ) over the
+ * gaussian weighted window, g being the gradient at the pixel p
+ *
+ * @param[in] img the image
+ * @param[in,out] corners the corners to refine
+ * @param[in] count the number of corners, at most LANES
+ * @param[in] maxIterations the maximum number of iterations
+ * @param[in] eps2 the squared displacement under which a corner has converged
+ * @param[in] mask the gaussian weights of the window
+ * @param[in,out] patch the buffer of the patches, (2 * HALF + 3)^2 * LANES floats
+ */
+template<int HALF>
+void refineBatch( const GreyImage &img, Point2f *corners, int count, int maxIterations, float eps2, const float *mask, float *patch )
+{
+    const int SIZE = 2 * HALF + 3;
+    const int WIN = 2 * HALF + 1;
+
+    float cx[LANES], cy[LANES];
+    bool active[LANES];
+    for( int l = 0; l < LANES; ++l )
+    {
+        active[l] = ( l < count );
+        cx[l] = corners[min( l, count - 1 )].x;
+        cy[l] = corners[min( l, count - 1 )].y;
+    }
+
+    // the unused lanes work on a copy of the first patch and are ignored
+    for( int l = count; l < LANES; ++l )
+        samplePatch( img, cx[l], cy[l], SIZE, patch + l );
+
+    for( int iter = 0; iter < maxIterations; ++iter )
+    {
+        for( int l = 0; l < LANES; ++l )
+        {
+            if( active[l] )
+                samplePatch( img, cx[l], cy[l], SIZE, patch + l );
+        }
+
+        Lanes a = splat( 0.f ), b = splat( 0.f ), c = splat( 0.f ), bb1 = splat( 0.f ), bb2 = splat( 0.f );
+        for( int i = 0; i < WIN; ++i )
+        {
+            const Lanes py = splat( ( float ) ( i - HALF ) );
+            const float *row = patch + ( ( i + 1 ) * SIZE + 1 ) * LANES;
+            const float *weights = mask + i * WIN;
+            for( int j = 0; j < WIN; ++j )
+            {
+                const float *p = row + j * LANES;
+                const Lanes tgx = sub( load( p + LANES ), load( p - LANES ) );
+                const Lanes tgy = sub( load( p + SIZE * LANES ), load( p - SIZE * LANES ) );
+                const Lanes m = splat( weights[j] );
+                const Lanes px = splat( ( float ) ( j - HALF ) );
+
+                const Lanes mgx = mul( tgx, m );
+                const Lanes gxx = mul( mgx, tgx );
+                const Lanes gxy = mul( mgx, tgy );
+                const Lanes gyy = mul( mul( tgy, m ), tgy );
+
+                a = add( a, gxx );
+                b = add( b, gxy );
+                c = add( c, gyy );
+                bb1 = add( bb1, add( mul( gxx, px ), mul( gxy, py ) ) );
+                bb2 = add( bb2, add( mul( gxy, px ), mul( gyy, py ) ) );
+            }
+        }
+
+        float A[LANES], B[LANES], C[LANES], B1[LANES], B2[LANES];
+        store( A, a );
+        store( B, b );
+        store( C, c );
+        store( B1, bb1 );
+        store( B2, bb2 );
+
+        // solve the 2x2 systems, the batch stops when all its corners have converged
+        bool anyActive = false;
+        for( int l = 0; l < LANES; ++l )
+        {
+            if( !active[l] )
+                continue;
+
+            const double det = ( double ) A[l] * C[l] - ( double ) B[l] * B[l];
+            if( fabs( det ) <= DBL_EPSILON * DBL_EPSILON )
+            {
+                active[l] = false;
+                continue;
+            }
+            const double scale = 1.0 / det;
+            const float nx = ( float ) ( cx[l] + C[l] * scale * B1[l] - B[l] * scale * B2[l] );
+            const float ny = ( float ) ( cy[l] - B[l] * scale * B1[l] + A[l] * scale * B2[l] );
+            const float err = ( nx - cx[l] ) * ( nx - cx[l] ) + ( ny - cy[l] ) * ( ny - cy[l] );
+            cx[l] = nx;
+            cy[l] = ny;
+
+            if( cx[l] < 0 || cx[l] >= img.cols || cy[l] < 0 || cy[l] >= img.rows || err <= eps2 )
+                active[l] = false;
+            anyActive = anyActive || active[l];
+        }
+        if( !anyActive )
+            break;
+    }
+
+    // as cornerSubPix, a corner that went out of its window keeps its initial position
+    for( int l = 0; l < count; ++l )
+    {
+        if( fabs( cx[l] - corners[l].x ) <= HALF && fabs( cy[l] - corners[l].y ) <= HALF )
+            corners[l] = Point2f( cx[l], cy[l] );
+    }
+}
+
+/**
+ * Refine all the corners with the kernel of a given half window
+ *
+ * @param[in] img the image
+ * @param[in,out] corners the corners to refine
+ * @param[in] maxIterations the maximum number of iterations
+ * @param[in] eps2 the squared displacement under which a corner has converged
+ */
+template<int HALF>
+void refineAll( const GreyImage &img, vector<Point2f> &corners, int maxIterations, float eps2 )
+{
+    const int WIN = 2 * HALF + 1;
+
+    // the gaussian weights of cornerSubPix
+    float mask[WIN * WIN];
+    const float coeff = 1.f / ( HALF * HALF );
+    for( int i = 0; i < WIN; ++i )
+    {
+        for( int j = 0; j < WIN; ++j )
+        {
+            const float y = ( float ) ( i - HALF ), x = ( float ) ( j - HALF );
+            mask[i * WIN + j] = exp( -x * x * coeff ) * exp( -y * y * coeff );
+        }
+    }
+
+    vector<float> patch( ( 2 * HALF + 3 ) * ( 2 * HALF + 3 ) * LANES, 0.f );
+    for( size_t first = 0; first < corners.size( ); first += LANES )
+    {
+        const int count = ( int ) min( corners.size( ) - first, ( size_t ) LANES );
+        refineBatch<HALF>( img, &corners[first], count, maxIterations, eps2, mask, &patch[0] );
+    }
+}
+
+}
+
+/**
+ * Refine the position of the corners to subpixel accuracy, a drop-in
+ * replacement of opencv's cornerSubPix (without zero zone)
+ *
+ * @param[in] grey the grey level image
+ * @param[in,out] corners the initial corners, refined on output
+ * @param[in] winSize half of the side length of the search window, as in cornerSubPix
+ * @param[in] criteria the termination criteria (number of iterations and/or minimum displacement)
+ */
+void refineCornersSubPix( const Mat &grey, vector<Point2f> &corners, const Size &winSize, const TermCriteria &criteria )
+{
+    if( corners.empty( ) )
+        return;
+
+    // same interpretation of the criteria as cornerSubPix
+    const int maxIterations = ( criteria.type & TermCriteria::COUNT ) ? max( criteria.maxCount, 1 ) : 100;
+    const double eps = ( criteria.type & TermCriteria::EPS ) ? max( criteria.epsilon, 0. ) : 0.;
+    const float eps2 = ( float ) ( eps * eps );
+
+    GreyImage img;
+    img.data = grey.data;
+    img.rows = grey.rows;
+    img.cols = grey.cols;
+    img.step = grey.step;
+
+    const bool supported = ( grey.type( ) == CV_8UC1 && winSize.width == winSize.height );
+    switch( supported ? winSize.width : 0 )
+    {
+        case 2:
+            refineAll<2>( img, corners, maxIterations, eps2 );
+            break;
+        case 3:
+            refineAll<3>( img, corners, maxIterations, eps2 );
+            break;
+        case 5:
+            refineAll<5>( img, corners, maxIterations, eps2 );
+            break;
+        case 11:
+            refineAll<11>( img, corners, maxIterations, eps2 );
+            break;
+        default:
+            cornerSubPix( grey, corners, winSize, Size( -1, -1 ), criteria );
+            break;
+    }
+}
@@ -0,0 +1,101 @@
+#include "tracker/FrameQualityGate.hpp"
+#include "tracker/CircleGridDetector.hpp"
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+namespace
+{
+
+// the width of the thumbnail the frames are evaluated on
+const int THUMBNAIL_WIDTH = 320;
+
+}
+
+/**
+ * Evaluate a frame before the detection of the pattern
+ *
+ * @param[in] grey the grey level frame
+ * @param[in] boardSize the size of the pattern to detect
+ * @param[in] pattern the type of pattern to detect
+ * @return GATE_PASSED if the detection should run on the frame, the reason of the rejection otherwise
+ */
+FrameQualityGate::Verdict FrameQualityGate::evaluate( const cv::Mat &grey, const cv::Size &boardSize, Pattern pattern )
+{
+    CV_Assert( grey.type( ) == CV_8UC1 );
+
+    // area interpolation keeps the edges of a sharp frame, a blurred one stays flat
+    Mat thumbnail;
+    if( grey.cols > THUMBNAIL_WIDTH )
+    {
+        const Size thumbnailSize( THUMBNAIL_WIDTH, cvRound( grey.rows * ( double ) THUMBNAIL_WIDTH / grey.cols ) );
+        resize( grey, thumbnail, thumbnailSize, 0, 0, INTER_AREA );
+    }
+    else
+    {
+        thumbnail = grey;
+    }
+
+    Scalar mean, stddev;
+    meanStdDev( thumbnail, mean, stddev );
+    _lastContrast = stddev[0];
+
+    Mat laplacian;
+    Laplacian( thumbnail, laplacian, CV_16S );
+    meanStdDev( laplacian, mean, stddev );
+    _lastSharpness = stddev[0] * stddev[0];
+
+    Verdict verdict = GATE_PASSED;
+    if( _lastContrast < _minContrast )
+    {
+        verdict = GATE_LOW_CONTRAST;
+    }
+    else if( _lastSharpness < _minSharpness )
+    {
+        verdict = GATE_BLURRED;
+    }
+    else if( _maxDeferred > 0 && _numDeferred < _maxDeferred )
+    {
+        bool present = true;
+        if( pattern == CHESSBOARD )
+        {
+            // the same check as CALIB_CB_FAST_CHECK, without the detection that follows it
+            IplImage iplThumbnail = thumbnail;
+            present = ( cvCheckChessboard( &iplThumbnail, boardSize ) > 0 );
+        }
+        else
+        {
+            vector<KeyPoint> blobs;
+            detectCircleBlobs( thumbnail, blobs );
+            present = ( blobs.size( ) >= ( size_t ) boardSize.area( ) );
+        }
+
+        if( !present )
+            verdict = GATE_NO_BOARD;
+    }
+
+    // the deferral is bounded, the detection runs on the next good frame after the last deferred one
+    if( verdict == GATE_NO_BOARD )
+        ++_numDeferred;
+    else if( verdict == GATE_PASSED )
+        _numDeferred = 0;
+
+    ++_numEvaluated;
+    ++_numVerdicts[verdict];
+
+    return verdict;
+}
+
+/**
+ * Reset the counters of the evaluated and rejected frames
+ */
+void FrameQualityGate::resetCounters( )
+{
+    _numEvaluated = 0;
+    fill( _numVerdicts, _numVerdicts + GATE_NUM_VERDICTS, 0 );
+}
@@ -0,0 +1,66 @@
+#include "tracker/ICameraTracker.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Downscale the grey frame to the processing scale, returning the camera
+ * to use with the downscaled frame (cam itself at full resolution)
+ *
+ * @param[in] cam the camera of the full resolution frames
+ * @param[in,out] grey the grey level frame, downscaled on output
+ * @return the camera matching the resolution of grey
+ */
+const Camera & ICameraTracker::prepareProcessingFrame( const Camera &cam, cv::Mat &grey )
+{
+    if( _processingScale >= 1.0 || _processingScale <= 0.0 )
+        return cam;
+
+    const Size processingSize( cvRound( grey.cols * _processingScale ), cvRound( grey.rows * _processingScale ) );
+
+    // the intrinsics are scaled only when the camera or the frame size change
+    if( _scaledCamSource != &cam || _scaledCamFrameSize != grey.size( ) || _scaledCam.imageSize != processingSize )
+    {
+        _scaledCam = cam.scaled( processingSize );
+        _scaledCamSource = &cam;
+        _scaledCamFrameSize = grey.size( );
+    }
+
+    // area interpolation to avoid aliasing the corners
+    Mat small;
+    resize( grey, small, processingSize, 0, 0, INTER_AREA );
+    grey = small;
+
+    return _scaledCam;
+}
+
+/**
+ * Run the quality gate, if enabled, before a full detection
+ *
+ * @param[in] grey the grey level frame the detection would run on
+ * @param[in] boardSize the size of the pattern to detect
+ * @param[in] pattern the type of pattern to detect
+ * @return true if the detection should run on the frame
+ */
+bool ICameraTracker::passQualityGate( const cv::Mat &grey, const cv::Size &boardSize, Pattern pattern )
+{
+    _gateRejected = _gateEnabled && ( _gate.evaluate( grey, boardSize, pattern ) != FrameQualityGate::GATE_PASSED );
+    return !_gateRejected;
+}
+
+/**
+ * Return the model of the board, generated only when the size or the
+ * pattern change
+ *
+ * @param[in] boardSize the size of the board
+ * @param[in] pattern the type of pattern
+ * @return the model of the board
+ */
+const BoardModel & ICameraTracker::getBoardModel( const cv::Size &boardSize, Pattern pattern )
+{
+    if( !_board.matches( boardSize, pattern ) )
+        _board = BoardModel( boardSize, pattern );
+    return _board;
+}
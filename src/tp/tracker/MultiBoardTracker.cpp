@@ -0,0 +1,322 @@
+#include "tracker/MultiBoardTracker.hpp"
+#include "tracker/PartialBoardDetector.hpp"
+#include "tracker/utility.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+using namespace cv;
+
+namespace
+{
+
+// the parameters of the optical flow, the same as the KLT tracker
+const Size FLOW_WINDOW( 11, 11 );
+const int FLOW_MAX_LEVEL = 3;
+
+// below this number of corners a board is lost
+const size_t MIN_TRACKED_CORNERS = 10;
+
+// the refinement window and the maximum shift of the recovered corners
+const int RESEED_HALF_WINDOW = 5;
+const float RESEED_MAX_SHIFT = 1.5f;
+
+/**
+ * Fill the area of a board in the frame with the mean grey level, so that it
+ * is not detected again
+ *
+ * @param[in,out] grey the grey level frame
+ * @param[in] model the model of the board
+ * @param[in] pose the pose of the board
+ * @param[in] cam the camera
+ * @param[in] distCoeff the distortion coefficients to use for the projection
+ */
+void maskBoard( Mat &grey, const BoardModel &model, const Mat &pose, const Camera &cam, const Mat &distCoeff )
+{
+    // the outer squares extend one square beyond the extreme points
+    const vector<Point3f> &points = model.getPoints3D( );
+    float minX = points[0].x, maxX = points[0].x, minY = points[0].y, maxY = points[0].y;
+    for( size_t i = 1; i < points.size( ); ++i )
+    {
+        minX = min( minX, points[i].x );
+        maxX = max( maxX, points[i].x );
+        minY = min( minY, points[i].y );
+        maxY = max( maxY, points[i].y );
+    }
+    const float margin = DEFAULT_SQUARE_SIZE;
+    vector<Point3f> border;
+    border.push_back( Point3f( minX - margin, minY - margin, 0 ) );
+    border.push_back( Point3f( maxX + margin, minY - margin, 0 ) );
+    border.push_back( Point3f( maxX + margin, maxY + margin, 0 ) );
+    border.push_back( Point3f( minX - margin, maxY + margin, 0 ) );
+
+    vector<Point2f> projected;
+    myProjectPoints( border, pose, cam.matK, distCoeff, projected );
+
+    vector<Point> polygon( projected.size( ) );
+    for( size_t i = 0; i < projected.size( ); ++i )
+        polygon[i] = Point( cvRound( projected[i].x ), cvRound( projected[i].y ) );
+    fillConvexPoly( grey, polygon, mean( grey ) );
+}
+
+}
+
+/**
+ * Set the boards to track, the tracking starts again from scratch
+ *
+ * @param[in] boards the descriptors of the boards
+ */
+void MultiBoardTracker::setBoards( const std::vector<BoardDescriptor> &boards )
+{
+    _boards = boards;
+    _tracks.assign( boards.size( ), BoardTrack( ) );
+    for( size_t b = 0; b < boards.size( ); ++b )
+        _tracks[b].model = BoardModel( boards[b].boardSize, boards[b].pattern );
+}
+
+/**
+ * Detect and track all the boards in a frame
+ *
+ * @param[in,out] view the original image, undistorted on output unless the tracker works on the distorted frames
+ * @param[in] cam the camera
+ * @param[out] poses the result for each board, in the order of setBoards
+ * @return true if at least one board has been found
+ */
+bool MultiBoardTracker::processBoards( cv::Mat &view, const Camera &cam, std::vector<BoardPose> &poses )
+{
+    poses.assign( _boards.size( ), BoardPose( ) );
+    _static = false;
+    _gateRejected = false;
+
+    // the undistortion and the grey level conversion are shared by all the boards
+    Mat viewGrey;
+    if( _undistortFrame )
+        cam.getUndistorter( view.size( ), _undistorter ).process( view, view, viewGrey );
+    else
+        cvtColor( view, viewGrey, CV_BGR2GRAY );
+
+    const Camera &procCam = prepareProcessingFrame( cam, viewGrey );
+    const Mat distCoeff = _undistortFrame ? Mat::zeros( 5, 1, CV_32F ) : procCam.distCoeff;
+
+    // the tracked corners are lost if the resolution of the frames changes
+    if( viewGrey.size( ) != _prevSize )
+    {
+        _prevPyramid.clear( );
+        for( size_t b = 0; b < _tracks.size( ); ++b )
+        {
+            _tracks[b].corners.clear( );
+            _tracks[b].lastPose.release( );
+        }
+        _prevSize = viewGrey.size( );
+    }
+
+    // the pyramid of this frame is the previous one of the next frame
+    vector<Mat> pyramid;
+    const int numLevels = buildOpticalFlowPyramid( viewGrey, pyramid, FLOW_WINDOW, FLOW_MAX_LEVEL );
+
+    // the corners of all the tracked boards are tracked together
+    vector<Point2f> prevPts;
+    vector<size_t> firstCorner( _tracks.size( ) + 1, 0 );
+    for( size_t b = 0; b < _tracks.size( ); ++b )
+    {
+        firstCorner[b] = prevPts.size( );
+        if( !_prevPyramid.empty( ) && _tracks[b].corners.size( ) >= MIN_TRACKED_CORNERS )
+            prevPts.insert( prevPts.end( ), _tracks[b].corners.begin( ), _tracks[b].corners.end( ) );
+        else
+            _tracks[b].corners.clear( );
+    }
+    firstCorner[_tracks.size( )] = prevPts.size( );
+
+    vector<Point2f> currPts;
+    vector<uchar> status;
+    if( !prevPts.empty( ) )
+    {
+        vector<float> err;
+        const TermCriteria termcrit( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 );
+        calcOpticalFlowPyrLK( _prevPyramid, pyramid, prevPts, currPts, status, err, FLOW_WINDOW, numLevels, termcrit );
+    }
+
+    // the pose of each tracked board from its own corners
+    for( size_t b = 0; b < _tracks.size( ); ++b )
+    {
+        BoardTrack &track = _tracks[b];
+        if( track.corners.empty( ) )
+        {
+            track.lastPose.release( );
+            continue;
+        }
+
+        size_t k = 0;
+        for( size_t i = 0; i < track.corners.size( ); ++i )
+        {
+            if( status[firstCorner[b] + i] > 0 )
+            {
+                track.corners[k] = currPts[firstCorner[b] + i];
+                track.objectPoints[k] = track.objectPoints[i];
+                track.cornerIds[k] = track.cornerIds[i];
+                ++k;
+            }
+        }
+        track.corners.resize( k );
+        track.objectPoints.resize( k );
+        track.cornerIds.resize( k );
+
+        Mat pose;
+        vector<int> inliers;
+        if( k < MIN_TRACKED_CORNERS
+            || mySolvePnP( track.objectPoints, track.corners, procCam.matK, distCoeff, track.lastPose, pose, inliers ) == PNP_NONE )
+        {
+            track.corners.clear( );
+            track.lastPose.release( );
+            continue;
+        }
+        filterVector( track.corners, inliers );
+        filterVector( track.objectPoints, inliers );
+        filterVector( track.cornerIds, inliers );
+
+        // bring back the corners lost so far
+        const vector<Point3f> &boardPoints = track.model.getPoints3D( );
+        if( track.corners.size( ) < boardPoints.size( ) )
+        {
+            vector<bool> tracked( boardPoints.size( ), false );
+            for( size_t i = 0; i < track.cornerIds.size( ); ++i )
+                tracked[ track.cornerIds[i] ] = true;
+            vector<int> lostIds;
+            for( size_t id = 0; id < boardPoints.size( ); ++id )
+            {
+                if( !tracked[id] )
+                    lostIds.push_back( ( int ) id );
+            }
+
+            vector<Point2f> recovered;
+            vector<int> recoveredIds;
+            findCornersNearProjection( viewGrey, boardPoints, lostIds, pose, procCam.matK, distCoeff,
+                                       RESEED_HALF_WINDOW, RESEED_MAX_SHIFT, recovered, recoveredIds );
+            for( size_t i = 0; i < recovered.size( ); ++i )
+            {
+                track.corners.push_back( recovered[i] );
+                track.objectPoints.push_back( boardPoints[ recoveredIds[i] ] );
+                track.cornerIds.push_back( recoveredIds[i] );
+            }
+        }
+
+        pose.copyTo( track.lastPose );
+        poses[b].found = true;
+        poses[b].numCorners = inliers.size( );
+        pose.copyTo( poses[b].pose );
+    }
+
+    // the boards that are not tracked are searched in the whole frame
+    detectLostBoards( viewGrey, procCam, distCoeff, poses );
+
+    _prevPyramid.swap( pyramid );
+
+    bool found = false;
+    for( size_t b = 0; b < poses.size( ); ++b )
+        found = found || poses[b].found;
+    return found;
+}
+
+/**
+ * Detect the boards that are not tracked
+ *
+ * @param[in] grey the grey level frame
+ * @param[in] cam the camera
+ * @param[in] distCoeff the distortion coefficients to use for the pose estimation
+ * @param[in,out] poses the result for each board
+ */
+void MultiBoardTracker::detectLostBoards( const cv::Mat &grey, const Camera &cam, const cv::Mat &distCoeff, std::vector<BoardPose> &poses )
+{
+    size_t firstLost = _tracks.size( );
+    for( size_t b = 0; b < _tracks.size( ) && firstLost == _tracks.size( ); ++b )
+    {
+        if( !poses[b].found )
+            firstLost = b;
+    }
+    if( firstLost == _tracks.size( ) )
+        return;
+
+    // the frame is checked once for all the boards
+    if( !passQualityGate( grey, _boards[firstLost].boardSize, _boards[firstLost].pattern ) )
+        return;
+
+    // the tracked boards are masked, so that a board of the same size is not found again
+    Mat masked = grey;
+    bool isCopy = false;
+    for( size_t b = 0; b < _tracks.size( ); ++b )
+    {
+        if( !poses[b].found )
+            continue;
+        if( !isCopy )
+        {
+            masked = grey.clone( );
+            isCopy = true;
+        }
+        maskBoard( masked, _tracks[b].model, poses[b].pose, cam, distCoeff );
+    }
+
+    for( size_t b = firstLost; b < _tracks.size( ); ++b )
+    {
+        if( poses[b].found )
+            continue;
+
+        BoardTrack &track = _tracks[b];
+        if( !detectChessboard( masked, track.corners, _boards[b].boardSize, _boards[b].pattern, _detector,
+                               vector<Point2f>( ), getProcessingTiledBoardSide( ) ) )
+        {
+            track.corners.clear( );
+            continue;
+        }
+        cout << "Board " << b << " detected" << endl;
+
+        track.objectPoints = track.model.getPoints3D( );
+        track.cornerIds.resize( track.corners.size( ) );
+        for( size_t id = 0; id < track.cornerIds.size( ); ++id )
+            track.cornerIds[id] = ( int ) id;
+
+        // all the correspondences of a full detection are correct
+        Mat pose;
+        if( !solvePlanarPose( track.objectPoints, track.corners, cam.matK, distCoeff, pose ) )
+            mySolvePnPRansac( track.objectPoints, track.corners, cam.matK, distCoeff, pose );
+
+        pose.copyTo( track.lastPose );
+        poses[b].found = true;
+        poses[b].numCorners = track.corners.size( );
+        pose.copyTo( poses[b].pose );
+
+        // the next boards of the same size must be found elsewhere
+        if( !isCopy )
+        {
+            masked = grey.clone( );
+            isCopy = true;
+        }
+        maskBoard( masked, track.model, pose, cam, distCoeff );
+    }
+}
+
+/**
+ * Track a single board: the tracked boards are replaced by this one if
+ * they are different
+ *
+ * @param[in,out] view the original image
+ * @param[out] pose the pose of the camera
+ * @param[in] cam the camera
+ * @param[in] boardSize the size of the chessboard to detect
+ * @param[in] pattern the type of pattern to detect
+ * @return true if the chessboard has been found
+ */
+bool MultiBoardTracker::process( cv::Mat &view, cv::Mat &pose, const Camera &cam, const cv::Size &boardSize, const Pattern &pattern )
+{
+    if( _boards.size( ) != 1 || _boards[0].boardSize != boardSize || _boards[0].pattern != pattern )
+        setBoards( vector<BoardDescriptor>( 1, BoardDescriptor( boardSize, pattern ) ) );
+
+    vector<BoardPose> poses;
+    processBoards( view, cam, poses );
+    if( poses[0].found )
+        poses[0].pose.copyTo( pose );
+    return poses[0].found;
+}
@@ -0,0 +1,342 @@
+#include "tracker/MultiCameraRunner.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Set up the runner, the cameras are added with addCamera
+ *
+ * @param[in] factory the function creating a tracker for each camera
+ * @param[in] boardSize the size of the chessboard to detect
+ * @param[in] pattern the type of pattern to detect
+ * @param[in] numWorkers the number of tracking threads shared by all the cameras
+ * @param[in] framesPerCamera the size of the frame pool of each camera
+ * @param[in] workerInit the function each tracking thread calls when it starts (see ThreadBudget::workerInit), may be empty
+ */
+MultiCameraRunner::MultiCameraRunner( const TrackerFactory &factory, const cv::Size &boardSize, Pattern pattern,
+                                      int numWorkers, size_t framesPerCamera, const ThreadPool::WorkerInit &workerInit )
+: _factory( factory ), _workerInit( workerInit ), _boardSize( boardSize ), _pattern( pattern ),
+  _numWorkers( max( numWorkers, 1 ) ), _framesPerCamera( max( framesPerCamera, ( size_t ) 2 ) ),
+  _startTime( chrono::steady_clock::now( ) )
+{
+}
+
+/**
+ * Stop the capture and wait for the trackers
+ */
+MultiCameraRunner::~MultiCameraRunner( )
+{
+    stop( );
+    // the pool runs the tasks left in the queue, they return at once
+    _pool.reset( );
+}
+
+/**
+ * Open a source and load its calibration, before start
+ *
+ * @param[in] source the video file, the stream url or the index of the device to read
+ * @param[in] calibFilename the calibration file of the camera
+ * @return the index of the camera, -1 if the source or the calibration could not be opened
+ */
+int MultiCameraRunner::addCamera( const std::string &source, const std::string &calibFilename )
+{
+    unique_ptr<CameraPipeline> pipe( new CameraPipeline( ) );
+
+    // a number is the index of a device
+    const bool isDevice = !source.empty( ) && source.find_first_not_of( "0123456789" ) == string::npos;
+    if( isDevice )
+        pipe->capture.open( atoi( source.c_str( ) ) );
+    else
+        pipe->capture.open( source );
+    if( !pipe->capture.isOpened( ) )
+        return -1;
+    pipe->live = isDevice || source.find( "://" ) != string::npos;
+
+    if( !pipe->cam.init( calibFilename ) )
+        return -1;
+
+    pipe->tracker = _factory( );
+    // the cameras are tracked in parallel, their messages would interleave
+    pipe->tracker->setVerbose( false );
+    pipe->slots.resize( _framesPerCamera );
+    for( size_t i = 0; i < _framesPerCamera; ++i )
+        pipe->freeSlots.push_back( ( int ) i );
+
+    pipe->index = ( int ) _cameras.size( );
+    _cameras.push_back( move( pipe ) );
+    return _cameras.back( )->index;
+}
+
+/**
+ * Start the capture of all the cameras
+ */
+void MultiCameraRunner::start( )
+{
+    _pool.reset( new ThreadPool( _numWorkers, _workerInit ) );
+    for( size_t c = 0; c < _cameras.size( ); ++c )
+        _cameras[c]->captureThread = thread( &MultiCameraRunner::captureLoop, this, ref( *_cameras[c] ) );
+}
+
+/**
+ * Stop the capture, the frames not yet tracked are discarded
+ */
+void MultiCameraRunner::stop( )
+{
+    {
+        lock_guard<mutex> lock( _mutex );
+        _stopping = true;
+    }
+    _slotFree.notify_all( );
+    _resultReady.notify_all( );
+
+    // a live source returns its current frame before its thread exits
+    for( size_t c = 0; c < _cameras.size( ); ++c )
+    {
+        if( _cameras[c]->captureThread.joinable( ) )
+            _cameras[c]->captureThread.join( );
+    }
+}
+
+/**
+ * Return the counters of a camera
+ *
+ * @param[in] camera the index of the camera
+ * @return a copy of its counters
+ */
+CameraStats MultiCameraRunner::getStats( int camera ) const
+{
+    lock_guard<mutex> lock( _mutex );
+    return _cameras[camera]->stats;
+}
+
+/**
+ * Return the milliseconds elapsed since the construction, the clock of the live sources
+ *
+ * @return the current time in milliseconds
+ */
+double MultiCameraRunner::now( ) const
+{
+    return chrono::duration<double, milli>( chrono::steady_clock::now( ) - _startTime ).count( );
+}
+
+/**
+ * Return the smallest timestamp a camera can still produce, the lock must be held
+ *
+ * @param[in] pipe the camera
+ * @return the timestamp of its oldest frame in flight or a lower bound of the timestamp of its next frame
+ */
+double MultiCameraRunner::watermark( const CameraPipeline &pipe ) const
+{
+    if( !pipe.frames.empty( ) )
+        return pipe.frames.front( ).timestamp;
+    if( pipe.finished )
+        return numeric_limits<double>::infinity( );
+
+    // a live frame is stamped when it is added to the pool, so it will not be
+    // older than now; the next frame of a video comes after the last one
+    return pipe.live ? now( ) : pipe.lastTimestamp;
+}
+
+/**
+ * Read the frames of a camera until its source is over
+ *
+ * @param[in,out] pipe the camera
+ */
+void MultiCameraRunner::captureLoop( CameraPipeline &pipe )
+{
+    // the frame read, a header on the buffer of the capture that the next read
+    // overwrites: it is copied in a buffer of the pool
+    Mat frame;
+
+    while( true )
+    {
+        int slot = -1;
+        {
+            unique_lock<mutex> lock( _mutex );
+            if( !pipe.live )
+                _slotFree.wait( lock, [this, &pipe] { return _stopping || pipe.frames.size( ) < _framesPerCamera; } );
+            if( _stopping )
+                break;
+
+            if( pipe.frames.size( ) < _framesPerCamera )
+            {
+                slot = pipe.freeSlots.back( );
+                pipe.freeSlots.pop_back( );
+            }
+            else
+            {
+                // the pool of a live source is full: its oldest frame not yet
+                // tracked gives its buffer to the new one
+                for( deque<FrameEntry>::iterator it = pipe.frames.begin( ); it != pipe.frames.end( ); ++it )
+                {
+                    if( !it->processing && !it->done )
+                    {
+                        slot = it->slot;
+                        pipe.frames.erase( it );
+                        ++pipe.stats.dropped;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // the buffer of the pool is not shared until the frame is added to the
+        // pool, it keeps its memory when the frames have the same size
+        const bool read = pipe.capture.read( frame ) && !frame.empty( );
+        if( read && slot >= 0 )
+            frame.copyTo( pipe.slots[slot] );
+
+        unique_lock<mutex> lock( _mutex );
+        if( !read )
+        {
+            if( slot >= 0 )
+                pipe.freeSlots.push_back( slot );
+            break;
+        }
+        ++pipe.stats.captured;
+        if( slot < 0 )
+        {
+            // every frame in flight is being tracked or merged
+            ++pipe.stats.dropped;
+            continue;
+        }
+
+        FrameEntry entry;
+        entry.frame = pipe.stats.captured - 1;
+        entry.timestamp = pipe.live ? now( ) : max( pipe.capture.get( CV_CAP_PROP_POS_MSEC ), pipe.lastTimestamp );
+        entry.slot = slot;
+        entry.result.camera = pipe.index;
+        entry.result.frame = entry.frame;
+        entry.result.timestamp = entry.timestamp;
+        pipe.lastTimestamp = entry.timestamp;
+        pipe.frames.push_back( entry );
+
+        // the frames of a camera are tracked one after the other
+        if( !pipe.scheduled )
+        {
+            pipe.scheduled = true;
+            _pool->submit( [this, &pipe] { trackNext( pipe ); } );
+        }
+        lock.unlock( );
+        _resultReady.notify_all( );
+    }
+
+    {
+        lock_guard<mutex> lock( _mutex );
+        pipe.finished = true;
+    }
+    pipe.capture.release( );
+    _resultReady.notify_all( );
+}
+
+/**
+ * Track the oldest frame of a camera not yet tracked, then let the other
+ * cameras use the worker before tracking its next frame
+ *
+ * @param[in,out] pipe the camera
+ */
+void MultiCameraRunner::trackNext( CameraPipeline &pipe )
+{
+    int slot = -1;
+    int64_t frame = 0;
+    {
+        lock_guard<mutex> lock( _mutex );
+        deque<FrameEntry>::iterator it = pipe.frames.begin( );
+        while( it != pipe.frames.end( ) && ( it->processing || it->done ) )
+            ++it;
+        // the frame may have been dropped by a live source in the meantime
+        if( _stopping || it == pipe.frames.end( ) )
+        {
+            pipe.scheduled = false;
+            return;
+        }
+        it->processing = true;
+        slot = it->slot;
+        frame = it->frame;
+    }
+
+    // the buffer of a frame being tracked is only written by a read once it is back in the pool
+    Mat pose;
+    const bool found = pipe.tracker->process( pipe.slots[slot], pose, pipe.cam, _boardSize, _pattern );
+    const bool gateRejected = pipe.tracker->isGateRejected( );
+
+    {
+        lock_guard<mutex> lock( _mutex );
+        bool pending = false;
+        for( deque<FrameEntry>::iterator it = pipe.frames.begin( ); it != pipe.frames.end( ); ++it )
+        {
+            if( it->frame == frame )
+            {
+                it->processing = false;
+                it->done = true;
+                it->slot = -1;
+                it->result.found = found;
+                it->result.gateRejected = gateRejected;
+                if( found )
+                    it->result.pose = pose;
+            }
+            else if( !it->processing && !it->done )
+            {
+                pending = true;
+            }
+        }
+        pipe.freeSlots.push_back( slot );
+        ++pipe.stats.processed;
+        if( found )
+            ++pipe.stats.found;
+
+        // back in the queue behind the tasks of the other cameras
+        if( pending && !_stopping )
+            _pool->submit( [this, &pipe] { trackNext( pipe ); } );
+        else
+            pipe.scheduled = false;
+    }
+    _slotFree.notify_all( );
+    _resultReady.notify_all( );
+}
+
+/**
+ * Wait for the next pose of the merged stream
+ *
+ * @param[out] result the pose with the smallest timestamp not yet returned
+ * @return false when all the sources are over (or the runner is stopped) and all their poses returned
+ */
+bool MultiCameraRunner::next( CameraPose &result )
+{
+    unique_lock<mutex> lock( _mutex );
+    while( !_stopping )
+    {
+        // the oldest tracked frame at the front of its camera, and the
+        // smallest timestamp any camera can still produce
+        CameraPipeline *best = nullptr;
+        double minWatermark = numeric_limits<double>::infinity( );
+        for( size_t c = 0; c < _cameras.size( ); ++c )
+        {
+            CameraPipeline &pipe = *_cameras[c];
+            minWatermark = min( minWatermark, watermark( pipe ) );
+            if( !pipe.frames.empty( ) && pipe.frames.front( ).done
+                && ( best == nullptr || pipe.frames.front( ).timestamp < best->frames.front( ).timestamp ) )
+                best = &pipe;
+        }
+
+        if( best != nullptr && best->frames.front( ).timestamp <= minWatermark )
+        {
+            result = best->frames.front( ).result;
+            best->frames.pop_front( );
+            lock.unlock( );
+            _slotFree.notify_all( );
+            return true;
+        }
+
+        // all the sources are over and merged
+        if( minWatermark == numeric_limits<double>::infinity( ) )
+            return false;
+
+        _resultReady.wait( lock );
+    }
+    return false;
+}
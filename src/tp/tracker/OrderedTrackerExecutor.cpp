@@ -0,0 +1,136 @@
+#include "tracker/OrderedTrackerExecutor.hpp"
+
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Create the trackers and start the workers
+ *
+ * @param[in] factory the function creating a tracker for each worker
+ * @param[in] cam the camera, it must outlive the executor
+ * @param[in] boardSize the size of the chessboard to detect
+ * @param[in] pattern the type of pattern to detect
+ * @param[in] numWorkers the number of worker threads, with 1 the frames are processed in submit
+ * @param[in] maxInFlight the maximum number of frames submitted and not yet returned by next (0 for 2 * numWorkers)
+ * @param[in] workerInit the function each worker calls when it starts (see ThreadBudget::workerInit), may be empty
+ */
+OrderedTrackerExecutor::OrderedTrackerExecutor( const TrackerFactory &factory, const Camera &cam, const cv::Size &boardSize, Pattern pattern,
+                                                int numWorkers, size_t maxInFlight, const ThreadPool::WorkerInit &workerInit )
+: _cam( cam ), _boardSize( boardSize ), _pattern( pattern ),
+  _maxInFlight( maxInFlight > 0 ? maxInFlight : 2 * ( size_t ) max( numWorkers, 1 ) )
+{
+    numWorkers = max( numWorkers, 1 );
+    for( int i = 0; i < numWorkers; ++i )
+    {
+        _trackers.push_back( factory( ) );
+        // the workers would all wait on the standard output
+        if( numWorkers > 1 )
+            _trackers.back( )->setVerbose( false );
+        _freeTrackers.push_back( ( size_t ) i );
+    }
+
+    if( numWorkers > 1 )
+        _pool.reset( new ThreadPool( numWorkers, workerInit ) );
+}
+
+/**
+ * Wait for the frames in flight and stop the workers
+ */
+OrderedTrackerExecutor::~OrderedTrackerExecutor( )
+{
+    // the pool runs the tasks left in the queue before joining
+    _pool.reset( );
+}
+
+/**
+ * Return true if a frame can be submitted without blocking
+ * @return true if the number of frames in flight is below the bound
+ */
+bool OrderedTrackerExecutor::canSubmit( ) const
+{
+    lock_guard<mutex> lock( _mutex );
+    return ( size_t ) ( _nextSubmit - _nextOutput ) < _maxInFlight;
+}
+
+/**
+ * Submit a frame, blocking while the number of frames in flight is at the bound
+ *
+ * @param[in] view the frame to process, it is copied (the frames read by a VideoCapture share its buffer)
+ * @return the index of the frame
+ */
+int64_t OrderedTrackerExecutor::submit( const cv::Mat &view )
+{
+    // the next frame read by the caller may overwrite the data of view, the
+    // worker gets its own copy
+    TrackedFrame frame;
+    view.copyTo( frame.view );
+    {
+        unique_lock<mutex> lock( _mutex );
+        _slotFree.wait( lock, [this] { return ( size_t ) ( _nextSubmit - _nextOutput ) < _maxInFlight; } );
+        frame.index = _nextSubmit++;
+    }
+
+    const int64_t index = frame.index;
+    if( _pool )
+    {
+        // the task shares the data of the copy made above, only the headers are copied
+        shared_ptr<TrackedFrame> task = make_shared<TrackedFrame>( frame );
+        _pool->submit( [this, task] { process( *task ); } );
+    }
+    else
+    {
+        process( frame );
+    }
+    return index;
+}
+
+/**
+ * Wait for the result of the oldest frame not yet returned
+ *
+ * @param[out] result the result of the frame
+ * @return false if there is no frame in flight
+ */
+bool OrderedTrackerExecutor::next( TrackedFrame &result )
+{
+    unique_lock<mutex> lock( _mutex );
+    if( _nextOutput == _nextSubmit )
+        return false;
+
+    _resultReady.wait( lock, [this] { return _done.count( _nextOutput ) > 0; } );
+    map<int64_t, TrackedFrame>::iterator it = _done.find( _nextOutput );
+    result = it->second;
+    _done.erase( it );
+    ++_nextOutput;
+
+    lock.unlock( );
+    _slotFree.notify_one( );
+    return true;
+}
+
+/**
+ * Process a frame with a free tracker and store the result
+ *
+ * @param[in] frame the frame to process
+ */
+void OrderedTrackerExecutor::process( TrackedFrame frame )
+{
+    // there are as many trackers as workers, one is always free
+    size_t trackerIdx;
+    {
+        lock_guard<mutex> lock( _mutex );
+        trackerIdx = _freeTrackers.back( );
+        _freeTrackers.pop_back( );
+    }
+
+    frame.found = _trackers[trackerIdx]->process( frame.view, frame.pose, _cam, _boardSize, _pattern );
+    frame.gateRejected = _trackers[trackerIdx]->isGateRejected( );
+
+    {
+        lock_guard<mutex> lock( _mutex );
+        _freeTrackers.push_back( trackerIdx );
+        _done[frame.index] = frame;
+    }
+    _resultReady.notify_all( );
+}
@@ -0,0 +1,132 @@
+#include "tracker/PartialBoardDetector.hpp"
+#include "tracker/CornerRefiner.hpp"
+#include "tracker/utility.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+
+// the minimum standard deviation of the grey levels around a corner
+const double MIN_CONTRAST = 10.0;
+
+// the refinement window and the maximum shift of the partial detection: the
+// anchor pose is older than the pose used to recover the lost corners
+const int PARTIAL_HALF_WINDOW = 5;
+const float PARTIAL_MAX_SHIFT = 3.0f;
+
+}
+
+/**
+ * Find the corners of a board around their projection with a known pose
+ *
+ * @param[in] grey the grey level frame
+ * @param[in] boardPoints the 3D points of the board model
+ * @param[in] ids the indices in boardPoints of the points to search
+ * @param[in] pose the 3x4 pose matrix [R t] used to project the points
+ * @param[in] cameraMatrix the camera matrix
+ * @param[in] distCoeffs the distortion coefficients to use for the projection
+ * @param[in] halfWin half of the side of the refinement window
+ * @param[in] maxShift the maximum distance in pixels between a projection and its refined corner
+ * @param[out] corners the corners found
+ * @param[out] cornerIds the index in boardPoints of each corner found
+ */
+void findCornersNearProjection( const Mat &grey, const vector<Point3f> &boardPoints, const vector<int> &ids,
+                                const Mat &pose, const Mat &cameraMatrix, const Mat &distCoeffs, int halfWin, float maxShift,
+                                vector<Point2f> &corners, vector<int> &cornerIds )
+{
+    corners.clear( );
+    cornerIds.clear( );
+    if( ids.empty( ) )
+        return;
+
+    vector<Point3f> points( ids.size( ) );
+    for( size_t i = 0; i < ids.size( ); ++i )
+        points[i] = boardPoints[ ids[i] ];
+
+    // where they should be according to the pose
+    vector<Point2f> projected;
+    myProjectPoints( points, pose, cameraMatrix, distCoeffs, projected );
+
+    // keep only those whose window is inside the image and with enough contrast
+    const Rect inside( halfWin + 1, halfWin + 1, grey.cols - 2 * ( halfWin + 1 ), grey.rows - 2 * ( halfWin + 1 ) );
+    vector<Point2f> candidates;
+    vector<int> candidateIds;
+    for( size_t i = 0; i < projected.size( ); ++i )
+    {
+        if( !inside.contains( projected[i] ) )
+            continue;
+
+        Scalar mean, stddev;
+        const Rect window( ( int ) projected[i].x - halfWin, ( int ) projected[i].y - halfWin, 2 * halfWin + 1, 2 * halfWin + 1 );
+        meanStdDev( grey( window ), mean, stddev );
+        if( stddev[0] < MIN_CONTRAST )
+            continue;
+
+        candidates.push_back( projected[i] );
+        candidateIds.push_back( ids[i] );
+    }
+    if( candidates.empty( ) )
+        return;
+
+    // refine them all at once, a real corner stays close to its projection
+    vector<Point2f> refined = candidates;
+    refineCornersSubPix( grey, refined, Size( halfWin, halfWin ), TermCriteria( CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 10, 0.1 ) );
+
+    for( size_t i = 0; i < refined.size( ); ++i )
+    {
+        const Point2f shift = refined[i] - candidates[i];
+        if( shift.dot( shift ) > maxShift * maxShift )
+            continue;
+
+        corners.push_back( refined[i] );
+        cornerIds.push_back( candidateIds[i] );
+    }
+}
+
+/**
+ * Detect the visible part of a chessboard near the pose it had in a previous frame
+ *
+ * @param[in] grey the grey level frame
+ * @param[in] boardPoints the 3D points of the board model
+ * @param[in] anchorPose the 3x4 pose matrix [R t] of the board in a previous frame
+ * @param[in] cameraMatrix the camera matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[out] corners the corners found
+ * @param[out] cornerIds the index in boardPoints of each corner found
+ * @param[out] pose the pose estimated from the corners found
+ * @param[in] minCorners the minimum number of consistent corners
+ * @return true if at least minCorners consistent corners have been found
+ */
+bool detectPartialChessboard( const Mat &grey, const vector<Point3f> &boardPoints, const Mat &anchorPose,
+                              const Mat &cameraMatrix, const Mat &distCoeffs,
+                              vector<Point2f> &corners, vector<int> &cornerIds, Mat &pose, size_t minCorners )
+{
+    vector<int> allIds( boardPoints.size( ) );
+    for( size_t id = 0; id < allIds.size( ); ++id )
+        allIds[id] = ( int ) id;
+
+    findCornersNearProjection( grey, boardPoints, allIds, anchorPose, cameraMatrix, distCoeffs,
+                               PARTIAL_HALF_WINDOW, PARTIAL_MAX_SHIFT, corners, cornerIds );
+    if( corners.size( ) < minCorners )
+        return false;
+
+    // the corners caught by the occluder (e.g. the edge of a hand) are not consistent with the pose
+    vector<Point3f> objectPoints( cornerIds.size( ) );
+    for( size_t i = 0; i < cornerIds.size( ); ++i )
+        objectPoints[i] = boardPoints[ cornerIds[i] ];
+
+    vector<int> inliers;
+    Mat partialPose;
+    mySolvePnPRansac( objectPoints, corners, cameraMatrix, distCoeffs, partialPose, inliers );
+    if( partialPose.empty( ) || inliers.size( ) < minCorners )
+        return false;
+
+    filterVector( corners, inliers );
+    filterVector( cornerIds, inliers );
+    partialPose.copyTo( pose );
+    return true;
+}
@@ -0,0 +1,379 @@
+#include "tracker/PlanarPnPRansac.hpp"
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define RANSAC_USE_SSE2 1
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define RANSAC_USE_NEON 1
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+
+// the number of points of a minimal sample
+const int SAMPLE_SIZE = 4;
+
+// the number of hypotheses generated and scored in a round, the iteration
+// bound is updated after each round
+const int HYPOTHESES_PER_ROUND = 16;
+
+// the points of the problem in structure of arrays layout, padded with NaN
+// to a multiple of 4 so that the vector loops need no tail (every comparison
+// with a NaN is false, so the padding is never counted as an inlier)
+struct PlanarPoints
+{
+    // the coordinates of the points on the board plane
+    vector<float> X, Y;
+    // the normalized image coordinates
+    vector<float> u, v;
+};
+
+// a hypothesis: the homography from the board plane to the normalized image plane
+struct Hypothesis
+{
+    float h[9];
+    bool valid;
+};
+
+/**
+ * Count the points consistent with a homography. A point is an inlier if it
+ * is in front of the camera and
+ * |H * (X, Y, 1) - w * (u, v)|^2 <= threshold^2 * w^2, where w is the third
+ * component of H * (X, Y, 1), which avoids the division by w
+ *
+ * @param[in] points the points to score
+ * @param[in] h the homography (row major)
+ * @param[in] threshold2 the squared threshold in normalized coordinates
+ * @return the number of inliers
+ */
+int countInliers( const PlanarPoints &points, const float *h, float threshold2 )
+{
+    const int padded = ( int ) points.X.size( );
+    int inliers = 0;
+
+#if defined( RANSAC_USE_SSE2 )
+    const __m128 h0 = _mm_set1_ps( h[0] ), h1 = _mm_set1_ps( h[1] ), h2 = _mm_set1_ps( h[2] );
+    const __m128 h3 = _mm_set1_ps( h[3] ), h4 = _mm_set1_ps( h[4] ), h5 = _mm_set1_ps( h[5] );
+    const __m128 h6 = _mm_set1_ps( h[6] ), h7 = _mm_set1_ps( h[7] ), h8 = _mm_set1_ps( h[8] );
+    const __m128 thr = _mm_set1_ps( threshold2 );
+    const __m128 zero = _mm_setzero_ps( );
+
+    for( int i = 0; i < padded; i += 4 )
+    {
+        const __m128 X = _mm_loadu_ps( &points.X[i] );
+        const __m128 Y = _mm_loadu_ps( &points.Y[i] );
+        const __m128 w = _mm_add_ps( _mm_add_ps( _mm_mul_ps( h6, X ), _mm_mul_ps( h7, Y ) ), h8 );
+        const __m128 px = _mm_add_ps( _mm_add_ps( _mm_mul_ps( h0, X ), _mm_mul_ps( h1, Y ) ), h2 );
+        const __m128 py = _mm_add_ps( _mm_add_ps( _mm_mul_ps( h3, X ), _mm_mul_ps( h4, Y ) ), h5 );
+        const __m128 dx = _mm_sub_ps( px, _mm_mul_ps( _mm_loadu_ps( &points.u[i] ), w ) );
+        const __m128 dy = _mm_sub_ps( py, _mm_mul_ps( _mm_loadu_ps( &points.v[i] ), w ) );
+        const __m128 err = _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) );
+        const __m128 inlier = _mm_and_ps( _mm_cmple_ps( err, _mm_mul_ps( thr, _mm_mul_ps( w, w ) ) ), _mm_cmpgt_ps( w, zero ) );
+        const int mask = _mm_movemask_ps( inlier );
+        inliers += ( mask & 1 ) + ( ( mask >> 1 ) & 1 ) + ( ( mask >> 2 ) & 1 ) + ( ( mask >> 3 ) & 1 );
+    }
+#elif defined( RANSAC_USE_NEON )
+    const float32x4_t zero = vdupq_n_f32( 0.f );
+    uint32x4_t count = vdupq_n_u32( 0 );
+
+    for( int i = 0; i < padded; i += 4 )
+    {
+        const float32x4_t X = vld1q_f32( &points.X[i] );
+        const float32x4_t Y = vld1q_f32( &points.Y[i] );
+        const float32x4_t w = vmlaq_n_f32( vmlaq_n_f32( vdupq_n_f32( h[8] ), X, h[6] ), Y, h[7] );
+        const float32x4_t px = vmlaq_n_f32( vmlaq_n_f32( vdupq_n_f32( h[2] ), X, h[0] ), Y, h[1] );
+        const float32x4_t py = vmlaq_n_f32( vmlaq_n_f32( vdupq_n_f32( h[5] ), X, h[3] ), Y, h[4] );
+        const float32x4_t dx = vmlsq_f32( px, vld1q_f32( &points.u[i] ), w );
+        const float32x4_t dy = vmlsq_f32( py, vld1q_f32( &points.v[i] ), w );
+        const float32x4_t err = vmlaq_f32( vmulq_f32( dx, dx ), dy, dy );
+        const uint32x4_t inlier = vandq_u32( vcleq_f32( err, vmulq_n_f32( vmulq_f32( w, w ), threshold2 ) ), vcgtq_f32( w, zero ) );
+        // the mask lanes are all ones for an inlier, subtracting them counts it
+        count = vsubq_u32( count, inlier );
+    }
+    inliers = ( int ) ( vgetq_lane_u32( count, 0 ) + vgetq_lane_u32( count, 1 ) + vgetq_lane_u32( count, 2 ) + vgetq_lane_u32( count, 3 ) );
+#else
+    for( int i = 0; i < padded; ++i )
+    {
+        const float X = points.X[i], Y = points.Y[i];
+        const float w = h[6] * X + h[7] * Y + h[8];
+        const float dx = h[0] * X + h[1] * Y + h[2] - points.u[i] * w;
+        const float dy = h[3] * X + h[4] * Y + h[5] - points.v[i] * w;
+        if( w > 0 && dx * dx + dy * dy <= threshold2 * w * w )
+            ++inliers;
+    }
+#endif
+
+    return inliers;
+}
+
+/**
+ * Compute the homography mapping the 4 sampled board points to their
+ * normalized image points
+ *
+ * @param[in] points the points of the problem
+ * @param[in] sample the indices of the 4 points
+ * @param[out] hyp the hypothesis, not valid if the sample is degenerate
+ */
+void computeHypothesis( const PlanarPoints &points, const int *sample, Hypothesis &hyp )
+{
+    hyp.valid = false;
+
+    Point2f src[SAMPLE_SIZE], dst[SAMPLE_SIZE];
+    float extent = 0;
+    for( int i = 0; i < SAMPLE_SIZE; ++i )
+    {
+        src[i] = Point2f( points.X[sample[i]], points.Y[sample[i]] );
+        dst[i] = Point2f( points.u[sample[i]], points.v[sample[i]] );
+        extent = max( extent, ( float ) norm( src[i] - src[0] ) );
+    }
+
+    // reject the samples with 3 (almost) collinear board points
+    const float minArea = 1e-3f * extent * extent;
+    for( int i = 0; i < SAMPLE_SIZE; ++i )
+    {
+        const Point2f &a = src[i], &b = src[( i + 1 ) % SAMPLE_SIZE], &c = src[( i + 2 ) % SAMPLE_SIZE];
+        if( fabs( ( b - a ).cross( c - a ) ) < minArea )
+            return;
+    }
+
+    const Mat H = getPerspectiveTransform( src, dst );
+    const double *h = H.ptr<double>( );
+    for( int i = 0; i < 9; ++i )
+    {
+        if( !( fabs( h[i] ) < FLT_MAX ) )
+            return;
+        hyp.h[i] = ( float ) h[i];
+    }
+    hyp.valid = true;
+}
+
+// it scores a round of hypotheses
+class ScoreBody : public ParallelLoopBody
+{
+public:
+
+    ScoreBody( const PlanarPoints &points, const vector<Hypothesis> &hyps, vector<int> &scores, float threshold2 )
+    : _points( points ), _hyps( hyps ), _scores( scores ), _threshold2( threshold2 ) { }
+
+    void operator()( const Range &range ) const override
+    {
+        for( int i = range.start; i < range.end; ++i )
+            _scores[i] = _hyps[i].valid ? countInliers( _points, _hyps[i].h, _threshold2 ) : 0;
+    }
+
+private:
+    const PlanarPoints &_points;
+    const vector<Hypothesis> &_hyps;
+    vector<int> &_scores;
+    const float _threshold2;
+};
+
+/**
+ * Update the number of iterations needed to draw an outlier free sample
+ * with the given confidence
+ *
+ * @param[in] inlierRatio the best inlier ratio found so far
+ * @param[in] confidence the requested confidence
+ * @param[in] maxIterations the upper bound
+ * @return the number of iterations
+ */
+int requiredIterations( double inlierRatio, double confidence, int maxIterations )
+{
+    const double goodSample = pow( inlierRatio, SAMPLE_SIZE );
+    if( goodSample >= 1 - DBL_EPSILON )
+        return 1;
+    if( goodSample <= DBL_EPSILON )
+        return maxIterations;
+
+    const double iterations = log( 1 - confidence ) / log( 1 - goodSample );
+    return ( int ) min( ( double ) maxIterations, ceil( iterations ) );
+}
+
+/**
+ * Extract the pose from a homography between the board plane and the
+ * normalized image plane, H = lambda * [r1 r2 t]
+ *
+ * @param[in] h the homography (row major)
+ * @param[out] rvec the rotation vector
+ * @param[out] tvec the translation vector
+ */
+void poseFromHomography( const float *h, Mat &rvec, Mat &tvec )
+{
+    Mat H( 3, 3, CV_64F );
+    for( int i = 0; i < 9; ++i )
+        H.at<double>( i / 3, i % 3 ) = h[i];
+
+    // the board must be in front of the camera
+    const double lambda = ( H.at<double>( 2, 2 ) < 0 ? -2. : 2. ) / ( norm( H.col( 0 ) ) + norm( H.col( 1 ) ) );
+    H *= lambda;
+
+    Mat R( 3, 3, CV_64F );
+    H.col( 0 ).copyTo( R.col( 0 ) );
+    H.col( 1 ).copyTo( R.col( 1 ) );
+    Mat r3 = H.col( 0 ).cross( H.col( 1 ) );
+    r3.copyTo( R.col( 2 ) );
+
+    // closest rotation matrix
+    SVD svd( R );
+    R = svd.u * svd.vt;
+
+    Rodrigues( R, rvec );
+    tvec = H.col( 2 ).clone( );
+}
+
+} // namespace
+
+/**
+ * RANSAC pose estimation dedicated to planar targets (all the 3D points on
+ * the z = 0 plane, as the ones generated by calcChessboardCorners3D)
+ *
+ * @param[in] objectPoints the 3D points, all with z = 0
+ * @param[in] imagePoints the image points
+ * @param[in] cameraMatrix the calibration matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[out] rvec the rotation vector of the pose
+ * @param[out] tvec the translation vector of the pose
+ * @param[out] inliers the list of indices of the inliers points
+ * @param[in] maxIterations the maximum number of hypotheses
+ * @param[in] reprojectionError the maximum reprojection error in pixels of an inlier
+ * @param[in] confidence the probability of having drawn at least one sample without outliers
+ * @param[in] parallel true to evaluate the hypotheses in parallel
+ * @return false if the points are not planar or no pose could be found
+ */
+bool planarSolvePnPRansac( const std::vector<cv::Point3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints,
+                           const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, cv::Mat &rvec, cv::Mat &tvec,
+                           std::vector<int> &inliers, int maxIterations, float reprojectionError,
+                           double confidence, bool parallel )
+{
+    const int count = ( int ) objectPoints.size( );
+    inliers.clear( );
+    if( count < SAMPLE_SIZE || imagePoints.size( ) != objectPoints.size( ) )
+        return false;
+
+    // the engine only handles the planar case
+    for( int i = 0; i < count; ++i )
+    {
+        if( objectPoints[i].z != 0.f )
+            return false;
+    }
+
+    // normalized image coordinates, the threshold is scaled accordingly
+    vector<Point2f> normalized;
+    undistortPoints( imagePoints, normalized, cameraMatrix, distCoeffs );
+    Mat K;
+    cameraMatrix.convertTo( K, CV_64F );
+    const float threshold = reprojectionError / ( float ) sqrt( K.at<double>( 0, 0 ) * K.at<double>( 1, 1 ) );
+    const float threshold2 = threshold * threshold;
+
+    PlanarPoints points;
+    const int padded = ( count + 3 ) & ~3;
+    points.X.resize( padded );
+    points.Y.resize( padded );
+    points.u.resize( padded );
+    points.v.resize( padded );
+    const float nan = numeric_limits<float>::quiet_NaN( );
+    for( int i = 0; i < padded; ++i )
+    {
+        const bool real = i < count;
+        points.X[i] = real ? objectPoints[i].x : nan;
+        points.Y[i] = real ? objectPoints[i].y : nan;
+        points.u[i] = real ? normalized[i].x : nan;
+        points.v[i] = real ? normalized[i].y : nan;
+    }
+
+    // same seed at each call, as solvePnPRansac, so that results are repeatable
+    RNG rng( 0xffffffff );
+
+    vector<Hypothesis> hyps( HYPOTHESES_PER_ROUND );
+    vector<int> scores( HYPOTHESES_PER_ROUND );
+    Hypothesis best;
+    best.valid = false;
+    int bestScore = 0;
+    int iterations = maxIterations;
+
+    for( int done = 0; done < iterations; )
+    {
+        // draw the samples sequentially so that the result does not depend on the threads
+        const int round = min( HYPOTHESES_PER_ROUND, iterations - done );
+        for( int k = 0; k < round; ++k )
+        {
+            int sample[SAMPLE_SIZE];
+            for( int i = 0; i < SAMPLE_SIZE; ++i )
+            {
+                bool repeated;
+                do
+                {
+                    sample[i] = rng.uniform( 0, count );
+                    repeated = find( sample, sample + i, sample[i] ) != sample + i;
+                } while( repeated );
+            }
+            computeHypothesis( points, sample, hyps[k] );
+        }
+
+        ScoreBody body( points, hyps, scores, threshold2 );
+        if( parallel )
+            parallel_for_( Range( 0, round ), body );
+        else
+            body( Range( 0, round ) );
+
+        for( int k = 0; k < round; ++k )
+        {
+            if( scores[k] > bestScore )
+            {
+                bestScore = scores[k];
+                best = hyps[k];
+            }
+        }
+        done += round;
+
+        // adapt the number of iterations to the best inlier ratio
+        if( best.valid )
+            iterations = min( iterations, requiredIterations( ( double ) bestScore / count, confidence, maxIterations ) );
+    }
+
+    if( !best.valid || bestScore < SAMPLE_SIZE )
+        return false;
+
+    // refine the pose of the best hypothesis on its inliers
+    poseFromHomography( best.h, rvec, tvec );
+
+    vector<Point2f> projected;
+    projectPoints( objectPoints, rvec, tvec, cameraMatrix, distCoeffs, projected );
+    vector<Point3f> inlierObject;
+    vector<Point2f> inlierImage;
+    const float maxError2 = reprojectionError * reprojectionError;
+    for( int i = 0; i < count; ++i )
+    {
+        const Point2f d = projected[i] - imagePoints[i];
+        if( d.dot( d ) <= maxError2 )
+        {
+            inlierObject.push_back( objectPoints[i] );
+            inlierImage.push_back( imagePoints[i] );
+        }
+    }
+    if( inlierObject.size( ) >= ( size_t ) SAMPLE_SIZE )
+        solvePnP( inlierObject, inlierImage, cameraMatrix, distCoeffs, rvec, tvec, true );
+
+    // final inliers wrt the refined pose
+    projectPoints( objectPoints, rvec, tvec, cameraMatrix, distCoeffs, projected );
+    for( int i = 0; i < count; ++i )
+    {
+        const Point2f d = projected[i] - imagePoints[i];
+        if( d.dot( d ) <= maxError2 )
+            inliers.push_back( i );
+    }
+
+    return inliers.size( ) >= ( size_t ) SAMPLE_SIZE;
+}
@@ -0,0 +1,77 @@
+#include "tracker/PosePredictor.hpp"
+
+#include <opencv2/calib3d/calib3d.hpp>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Forget the previous poses, e.g. when the tracking is lost
+ */
+void PosePredictor::reset( )
+{
+    _numPoses = 0;
+}
+
+/**
+ * Add the pose estimated for the current frame
+ *
+ * @param[in] pose the 3x4 pose matrix [R t] of the current frame
+ */
+void PosePredictor::update( const cv::Mat &pose )
+{
+    CV_Assert( pose.rows == 3 && pose.cols == 4 );
+
+    Mat pose64;
+    pose.convertTo( pose64, CV_64F );
+    Matx33d rotation;
+    Vec3d translation;
+    for( int r = 0; r < 3; ++r )
+    {
+        for( int c = 0; c < 3; ++c )
+            rotation( r, c ) = pose64.at<double>( r, c );
+        translation[ r ] = pose64.at<double>( r, 3 );
+    }
+
+    if( _numPoses > 0 )
+    {
+        // the motion between the two poses: R = dR * prevR, t = prevT + dt
+        const Matx33d deltaR = rotation * _rotation.t( );
+        Mat omega;
+        Rodrigues( Mat( deltaR ), omega );
+        _angularVelocity = Vec3d( omega.at<double>( 0 ), omega.at<double>( 1 ), omega.at<double>( 2 ) );
+        _linearVelocity = translation - _translation;
+    }
+
+    _rotation = rotation;
+    _translation = translation;
+    _numPoses = min( _numPoses + 1, 2 );
+}
+
+/**
+ * Extrapolate the pose after the given number of frames from the last update
+ *
+ * @param[out] pose the predicted 3x4 pose matrix [R t] (CV_32F)
+ * @param[in] framesAhead the number of frames after the last update (it can be fractional)
+ * @return true if the pose could be predicted
+ */
+bool PosePredictor::predict( cv::Mat &pose, float framesAhead ) const
+{
+    if( !isValid( ) )
+        return false;
+
+    // rotate by a fraction (or a multiple) of the last rotation
+    Mat deltaR;
+    Rodrigues( Mat( _angularVelocity * ( double ) framesAhead ), deltaR );
+    const Matx33d rotation = Matx33d( deltaR.ptr<double>( ) ) * _rotation;
+    const Vec3d translation = _translation + _linearVelocity * ( double ) framesAhead;
+
+    pose.create( 3, 4, CV_32F );
+    for( int r = 0; r < 3; ++r )
+    {
+        for( int c = 0; c < 3; ++c )
+            pose.at<float>( r, c ) = ( float ) rotation( r, c );
+        pose.at<float>( r, 3 ) = ( float ) translation[ r ];
+    }
+    return true;
+}
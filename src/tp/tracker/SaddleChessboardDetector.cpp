@@ -0,0 +1,530 @@
+#include "tracker/SaddleChessboardDetector.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <utility>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+
+// the standard deviation of the gaussian smoothing before the derivatives
+const double SMOOTHING_SIGMA = 1.5;
+
+// the radius of the gaussian kernel, and the rows a band needs above and
+// below it to compute the smoothing and the second derivatives exactly
+const int SMOOTHING_RADIUS = 5;
+const int FILTER_HALO = SMOOTHING_RADIUS + 1;
+
+// the radius of the non maximum suppression, the corners must be further apart
+const int NMS_RADIUS = 3;
+
+// a candidate must have a response above this fraction of the strongest one
+const float RELATIVE_THRESHOLD = 0.05f;
+
+// the maximum number of candidates per corner of the board, the weakest are dropped
+const int MAX_CANDIDATES_PER_CORNER = 30;
+
+// the radius of the search of a neighbour corner, as a fraction of the grid step
+const float SEARCH_RADIUS = 0.35f;
+
+// the number of seeds tried to grow the grid, from the strongest candidate
+const int MAX_SEEDS = 10;
+
+// the minimum number of rows of a band
+const int MIN_BAND_ROWS = 32;
+
+// a local maximum of the saddle response
+struct Candidate
+{
+    Point2f pt;
+    float response;
+};
+
+// the cells of the grid: (i, j) -> index of the candidate
+typedef map<pair<int, int>, int> GridCells;
+
+/**
+ * Compute the saddle response -det(Hessian) of a band of rows, the band is
+ * filtered with a halo of rows around it so that its response does not
+ * depend on the split of the image
+ */
+class ResponseBody : public ParallelLoopBody
+{
+public:
+
+    ResponseBody( const Mat &grey, Mat &response, vector<float> &maxima, int bandRows )
+    : _grey( grey ), _response( response ), _maxima( maxima ), _bandRows( bandRows ) { }
+
+    void operator()( const Range &range ) const override
+    {
+        for( int b = range.start; b < range.end; ++b )
+        {
+            const int r0 = b * _bandRows;
+            const int r1 = min( r0 + _bandRows, _grey.rows );
+            const int a0 = max( r0 - FILTER_HALO, 0 );
+            const int a1 = min( r1 + FILTER_HALO, _grey.rows );
+
+            Mat band, smooth, dxx, dyy, dxy;
+            _grey.rowRange( a0, a1 ).convertTo( band, CV_32F );
+            GaussianBlur( band, smooth, Size( 2 * SMOOTHING_RADIUS + 1, 2 * SMOOTHING_RADIUS + 1 ), SMOOTHING_SIGMA );
+            Sobel( smooth, dxx, CV_32F, 2, 0, 3 );
+            Sobel( smooth, dyy, CV_32F, 0, 2, 3 );
+            Sobel( smooth, dxy, CV_32F, 1, 1, 3 );
+
+            // dxy^2 - dxx * dyy on the rows of the band only
+            float maximum = 0.f;
+            for( int y = r0; y < r1; ++y )
+            {
+                const float *pxx = dxx.ptr<float>( y - a0 );
+                const float *pyy = dyy.ptr<float>( y - a0 );
+                const float *pxy = dxy.ptr<float>( y - a0 );
+                float *out = _response.ptr<float>( y );
+                for( int x = 0; x < _grey.cols; ++x )
+                {
+                    out[x] = pxy[x] * pxy[x] - pxx[x] * pyy[x];
+                    maximum = max( maximum, out[x] );
+                }
+            }
+            _maxima[b] = maximum;
+        }
+    }
+
+private:
+    const Mat &_grey;
+    Mat &_response;
+    vector<float> &_maxima;
+    const int _bandRows;
+};
+
+/**
+ * Collect the local maxima of the response above the threshold in a band of
+ * rows, with their subpixel position from a parabolic fit
+ */
+class MaximaBody : public ParallelLoopBody
+{
+public:
+
+    MaximaBody( const Mat &response, vector<vector<Candidate> > &candidates, int bandRows, float threshold )
+    : _response( response ), _candidates( candidates ), _bandRows( bandRows ), _threshold( threshold ) { }
+
+    void operator()( const Range &range ) const override
+    {
+        for( int b = range.start; b < range.end; ++b )
+        {
+            vector<Candidate> &out = _candidates[b];
+            out.clear( );
+
+            const int r0 = max( b * _bandRows, NMS_RADIUS );
+            const int r1 = min( ( b + 1 ) * _bandRows, _response.rows - NMS_RADIUS );
+            for( int y = r0; y < r1; ++y )
+            {
+                const float *row = _response.ptr<float>( y );
+                for( int x = NMS_RADIUS; x < _response.cols - NMS_RADIUS; ++x )
+                {
+                    const float v = row[x];
+                    if( v <= _threshold || !isLocalMaximum( x, y, v ) )
+                        continue;
+
+                    // parabolic fit along each axis (the denominators are negative at a maximum)
+                    const float *up = _response.ptr<float>( y - 1 );
+                    const float *down = _response.ptr<float>( y + 1 );
+                    const float denX = row[x - 1] - 2 * v + row[x + 1];
+                    const float denY = up[x] - 2 * v + down[x];
+                    float dx = ( denX < 0 ) ? 0.5f * ( row[x - 1] - row[x + 1] ) / denX : 0.f;
+                    float dy = ( denY < 0 ) ? 0.5f * ( up[x] - down[x] ) / denY : 0.f;
+                    dx = min( max( dx, -0.5f ), 0.5f );
+                    dy = min( max( dy, -0.5f ), 0.5f );
+
+                    Candidate c;
+                    c.pt = Point2f( x + dx, y + dy );
+                    c.response = v;
+                    out.push_back( c );
+                }
+            }
+        }
+    }
+
+private:
+
+    // true if v is the maximum of its neighbourhood, the ties are broken by the raster order
+    bool isLocalMaximum( int x, int y, float v ) const
+    {
+        for( int dy = -NMS_RADIUS; dy <= NMS_RADIUS; ++dy )
+        {
+            const float *row = _response.ptr<float>( y + dy );
+            for( int dx = -NMS_RADIUS; dx <= NMS_RADIUS; ++dx )
+            {
+                const float w = row[x + dx];
+                if( w > v || ( w == v && ( dy < 0 || ( dy == 0 && dx < 0 ) ) ) )
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    const Mat &_response;
+    vector<vector<Candidate> > &_candidates;
+    const int _bandRows;
+    const float _threshold;
+};
+
+/**
+ * Find the unused candidate nearest to a position
+ *
+ * @param[in] candidates the candidates
+ * @param[in] used the candidates already in the grid
+ * @param[in] pos the position to search around
+ * @param[in] radius the search radius
+ * @return the index of the candidate, -1 if there is none within the radius
+ */
+int nearestCandidate( const vector<Candidate> &candidates, const vector<bool> &used, const Point2f &pos, float radius )
+{
+    int best = -1;
+    float bestDist2 = radius * radius;
+    for( size_t k = 0; k < candidates.size( ); ++k )
+    {
+        if( used[k] )
+            continue;
+        const Point2f d = candidates[k].pt - pos;
+        const float dist2 = d.dot( d );
+        if( dist2 < bestDist2 )
+        {
+            bestDist2 = dist2;
+            best = ( int ) k;
+        }
+    }
+    return best;
+}
+
+/**
+ * Return the distance from a position to the nearest candidate relative to
+ * the step of the grid, used to check the predicted positions of the corners
+ *
+ * @param[in] candidates the candidates
+ * @param[in] pos the predicted position
+ * @param[in] step the length of the step of the grid
+ * @return the relative distance, FLT_MAX if there is no candidate within the search radius
+ */
+float relativeResidual( const vector<Candidate> &candidates, const Point2f &pos, float step )
+{
+    float best = SEARCH_RADIUS * step;
+    best *= best;
+    bool found = false;
+    for( size_t k = 0; k < candidates.size( ); ++k )
+    {
+        const Point2f d = candidates[k].pt - pos;
+        const float dist2 = d.dot( d );
+        if( dist2 < best )
+        {
+            best = dist2;
+            found = true;
+        }
+    }
+    return found ? sqrt( best ) / step : FLT_MAX;
+}
+
+/**
+ * Return the step of the grid along an axis at a given cell, estimated from
+ * the cell and its neighbours along the axis, or from the adjacent rows
+ *
+ * @param[in] candidates the candidates
+ * @param[in] cells the grid
+ * @param[in] i the first coordinate of the cell
+ * @param[in] j the second coordinate of the cell
+ * @param[in] di the axis (1, 0) or (0, 1)
+ * @param[in] dj the axis (1, 0) or (0, 1)
+ * @param[in] fallback the step to return if none can be estimated
+ * @return the step along the positive direction of the axis
+ */
+Point2f gridStep( const vector<Candidate> &candidates, const GridCells &cells, int i, int j, int di, int dj, const Point2f &fallback )
+{
+    // the cell itself first, then the ones beside it
+    const int offsets[3] = { 0, 1, -1 };
+    for( int o = 0; o < 3; ++o )
+    {
+        const int ci = i + offsets[o] * dj;
+        const int cj = j + offsets[o] * di;
+        GridCells::const_iterator curr = cells.find( make_pair( ci, cj ) );
+        if( curr == cells.end( ) )
+            continue;
+        GridCells::const_iterator next = cells.find( make_pair( ci + di, cj + dj ) );
+        if( next != cells.end( ) )
+            return candidates[next->second].pt - candidates[curr->second].pt;
+        GridCells::const_iterator prev = cells.find( make_pair( ci - di, cj - dj ) );
+        if( prev != cells.end( ) )
+            return candidates[curr->second].pt - candidates[prev->second].pt;
+    }
+    return fallback;
+}
+
+/**
+ * Grow the grid of corners from a seed candidate and extract the window of
+ * boardSize corners with the strongest response
+ *
+ * @param[in] candidates the candidates
+ * @param[in] seed the index of the seed candidate
+ * @param[in] boardSize the size of the board in terms of corners (width X height)
+ * @param[out] corners the corners of the board in row-major order
+ * @return true if a complete board has been found
+ */
+bool growGrid( const vector<Candidate> &candidates, int seed, const Size &boardSize, vector<Point2f> &corners )
+{
+    const Point2f &p = candidates[seed].pt;
+
+    // the nearest neighbours of the seed give the two axes of the grid
+    vector<pair<float, int> > neighbours;
+    for( size_t k = 0; k < candidates.size( ); ++k )
+    {
+        if( ( int ) k == seed )
+            continue;
+        const Point2f d = candidates[k].pt - p;
+        neighbours.push_back( make_pair( d.dot( d ), ( int ) k ) );
+    }
+    if( neighbours.size( ) < 2 )
+        return false;
+    const size_t numNearest = min( neighbours.size( ), ( size_t ) 8 );
+    partial_sort( neighbours.begin( ), neighbours.begin( ) + numNearest, neighbours.end( ) );
+
+    // the two axes among the nearest neighbours: u is the one best confirmed
+    // by a neighbour on the opposite side of the seed, v the one across u
+    // that best closes the square spanned with u. This rejects the maxima
+    // next to the board that happen to be nearer than the true neighbours.
+    // The seeds at the border of the board, with no opposite neighbour, fall
+    // back to the nearest neighbour and to the square only
+    int nu = -1, nv = -1;
+    for( int symmetric = 1; symmetric >= 0 && nv < 0; --symmetric )
+    {
+        nu = nv = -1;
+        float bestU = FLT_MAX;
+        for( size_t k = 0; k < numNearest; ++k )
+        {
+            const Point2f d = candidates[neighbours[k].second].pt - p;
+            const float err = symmetric ? relativeResidual( candidates, p - d, sqrt( neighbours[k].first ) ) : ( float ) k;
+            if( err < bestU )
+            {
+                bestU = err;
+                nu = neighbours[k].second;
+            }
+        }
+        if( nu < 0 )
+            continue;
+
+        const Point2f u = candidates[nu].pt - p;
+        const float lenU = sqrt( u.dot( u ) );
+        float bestV = FLT_MAX;
+        for( size_t k = 0; k < numNearest; ++k )
+        {
+            const int n = neighbours[k].second;
+            const Point2f d = candidates[n].pt - p;
+            const float len = sqrt( neighbours[k].first );
+            const float cosine = fabs( u.dot( d ) ) / ( lenU * len );
+            if( n == nu || cosine >= 0.5f || len > 2.f * lenU || lenU > 2.f * len )
+                continue;
+
+            float err = relativeResidual( candidates, p + u + d, min( len, lenU ) );
+            if( symmetric && err < FLT_MAX )
+                err += relativeResidual( candidates, p - d, len );
+            if( err < bestV )
+            {
+                bestV = err;
+                nv = n;
+            }
+        }
+    }
+    if( nv < 0 )
+        return false;
+    const Point2f u = candidates[nu].pt - p;
+    const Point2f v = candidates[nv].pt - p;
+
+    // breadth first growth, each neighbour is predicted with the local step of the grid
+    GridCells cells;
+    vector<bool> used( candidates.size( ), false );
+    cells[make_pair( 0, 0 )] = seed;
+    cells[make_pair( 1, 0 )] = nu;
+    cells[make_pair( 0, 1 )] = nv;
+    used[seed] = used[nu] = used[nv] = true;
+
+    // the board contains the seed, so its corners (and the ring of maxima
+    // around it) are at most this far from the seed along each axis
+    const int maxOffset = max( boardSize.width, boardSize.height );
+    int minI = 0, maxI = 1, minJ = 0, maxJ = 1;
+
+    deque<pair<int, int> > queue;
+    queue.push_back( make_pair( 0, 0 ) );
+    queue.push_back( make_pair( 1, 0 ) );
+    queue.push_back( make_pair( 0, 1 ) );
+    const int dirs[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+    while( !queue.empty( ) )
+    {
+        const pair<int, int> cell = queue.front( );
+        queue.pop_front( );
+        const Point2f &q = candidates[cells[cell]].pt;
+
+        for( int d = 0; d < 4; ++d )
+        {
+            const int ni = cell.first + dirs[d][0];
+            const int nj = cell.second + dirs[d][1];
+            if( cells.count( make_pair( ni, nj ) ) )
+                continue;
+            if( abs( ni ) > maxOffset || abs( nj ) > maxOffset )
+                continue;
+
+            const int di = abs( dirs[d][0] ), dj = abs( dirs[d][1] );
+            const int sign = dirs[d][0] + dirs[d][1];
+            const Point2f step = gridStep( candidates, cells, cell.first, cell.second, di, dj, di ? u : v );
+            const float len = sqrt( step.dot( step ) );
+            const int k = nearestCandidate( candidates, used, q + sign * step, SEARCH_RADIUS * len );
+            if( k < 0 )
+                continue;
+
+            cells[make_pair( ni, nj )] = k;
+            used[k] = true;
+            minI = min( minI, ni );
+            maxI = max( maxI, ni );
+            minJ = min( minJ, nj );
+            maxJ = max( maxJ, nj );
+            queue.push_back( make_pair( ni, nj ) );
+        }
+    }
+
+    // the complete window with the strongest response, the board may be seen
+    // with its width along either axis of the grid
+    const int W = boardSize.width, H = boardSize.height;
+    float bestScore = -1.f;
+    int bestI = 0, bestJ = 0;
+    bool bestAlongI = true;
+    for( int orientation = 0; orientation < ( W == H ? 1 : 2 ); ++orientation )
+    {
+        const bool alongI = ( orientation == 0 );
+        const int extI = alongI ? W : H;
+        const int extJ = alongI ? H : W;
+        for( int i0 = minI; i0 + extI - 1 <= maxI; ++i0 )
+        {
+            for( int j0 = minJ; j0 + extJ - 1 <= maxJ; ++j0 )
+            {
+                float score = 0.f;
+                bool complete = true;
+                for( int i = i0; i < i0 + extI && complete; ++i )
+                {
+                    for( int j = j0; j < j0 + extJ && complete; ++j )
+                    {
+                        GridCells::const_iterator it = cells.find( make_pair( i, j ) );
+                        if( it == cells.end( ) )
+                            complete = false;
+                        else
+                            score += candidates[it->second].response;
+                    }
+                }
+                if( complete && score > bestScore )
+                {
+                    bestScore = score;
+                    bestI = i0;
+                    bestJ = j0;
+                    bestAlongI = alongI;
+                }
+            }
+        }
+    }
+    if( bestScore < 0 )
+        return false;
+
+    corners.resize( W * H );
+    for( int r = 0; r < H; ++r )
+    {
+        for( int c = 0; c < W; ++c )
+        {
+            const pair<int, int> cell = bestAlongI ? make_pair( bestI + c, bestJ + r ) : make_pair( bestI + r, bestJ + c );
+            corners[r * W + c] = candidates[cells[cell]].pt;
+        }
+    }
+
+    // same handedness as findChessboardCorners: the rows (x axis of the
+    // board) cross the columns (y axis) clockwise in the image
+    const Point2f x = corners[( W > 1 ) ? 1 : 0] - corners[0];
+    const Point2f y = corners[( H > 1 ) ? W : 0] - corners[0];
+    if( x.cross( y ) < 0 )
+    {
+        for( int r = 0; r < H; ++r )
+            reverse( corners.begin( ) + r * W, corners.begin( ) + ( r + 1 ) * W );
+    }
+
+    return true;
+}
+
+bool strongerCandidate( const Candidate &a, const Candidate &b )
+{
+    return a.response > b.response;
+}
+
+}
+
+/**
+ * Detect the inner corners of a chessboard as saddle points of the image
+ * intensity
+ *
+ * @param[in] image the image to process, grey level or BGR
+ * @param[in] boardSize the size of the board in terms of corners (width X height)
+ * @param[out] corners the detected corners
+ * @param[in] numBands the number of bands processed in parallel, 0 to choose it from the number of threads
+ * @return true if the whole board has been found
+ */
+bool findChessboardSaddles( const Mat &image, const Size &boardSize, vector<Point2f> &corners, int numBands )
+{
+    corners.clear( );
+    if( image.empty( ) || boardSize.width < 2 || boardSize.height < 2 )
+        return false;
+
+    Mat grey;
+    if( image.channels( ) == 1 )
+        grey = image;
+    else
+        cvtColor( image, grey, CV_BGR2GRAY );
+
+    // split the rows in bands, a few per thread to balance the load
+    if( numBands <= 0 )
+        numBands = 2 * max( getNumThreads( ), 1 );
+    numBands = max( min( numBands, grey.rows / MIN_BAND_ROWS ), 1 );
+    const int bandRows = ( grey.rows + numBands - 1 ) / numBands;
+
+    Mat response( grey.size( ), CV_32F );
+    vector<float> maxima( numBands, 0.f );
+    parallel_for_( Range( 0, numBands ), ResponseBody( grey, response, maxima, bandRows ) );
+
+    const float maximum = *max_element( maxima.begin( ), maxima.end( ) );
+    if( maximum <= 0.f )
+        return false;
+
+    vector<vector<Candidate> > bandCandidates( numBands );
+    parallel_for_( Range( 0, numBands ), MaximaBody( response, bandCandidates, bandRows, RELATIVE_THRESHOLD * maximum ) );
+
+    vector<Candidate> candidates;
+    for( size_t b = 0; b < bandCandidates.size( ); ++b )
+        candidates.insert( candidates.end( ), bandCandidates[b].begin( ), bandCandidates[b].end( ) );
+
+    const size_t numCorners = ( size_t ) boardSize.area( );
+    if( candidates.size( ) < numCorners )
+        return false;
+
+    // strongest first, they are the seeds tried first
+    sort( candidates.begin( ), candidates.end( ), strongerCandidate );
+    if( candidates.size( ) > MAX_CANDIDATES_PER_CORNER * numCorners )
+        candidates.resize( MAX_CANDIDATES_PER_CORNER * numCorners );
+
+    const int numSeeds = min( ( int ) candidates.size( ), MAX_SEEDS );
+    for( int seed = 0; seed < numSeeds; ++seed )
+    {
+        if( growGrid( candidates, seed, boardSize, corners ) )
+            return true;
+    }
+
+    corners.clear( );
+    return false;
+}
@@ -0,0 +1,118 @@
+#include "tracker/SegmentedVideoTracker.hpp"
+#include "tracker/ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Set up the tracking of a video
+ *
+ * @param[in] index the index of the video
+ * @param[in] factory the function creating a tracker for each segment
+ * @param[in] cam the camera
+ * @param[in] boardSize the size of the chessboard to detect
+ * @param[in] pattern the type of pattern to detect
+ */
+SegmentedVideoTracker::SegmentedVideoTracker( const VideoIndex &index, const TrackerFactory &factory, const Camera &cam, const cv::Size &boardSize, Pattern pattern )
+: _index( index ), _factory( factory ), _cam( cam ), _boardSize( boardSize ), _pattern( pattern )
+{
+}
+
+/**
+ * Track the whole video
+ *
+ * @param[out] poses the pose of each frame of the video, in frame order
+ * @param[in] numWorkers the number of segments processed in parallel
+ * @param[in] minSegmentLength the minimum number of frames of a segment (it is rounded to the next seek point)
+ * @param[in] overlap the number of frames processed before the segment start to warm the tracker up
+ * @param[in] workerInit the function each worker calls when it starts (see ThreadBudget::workerInit), may be empty
+ * @return false if a segment could not be read
+ */
+bool SegmentedVideoTracker::run( std::vector<FramePose> &poses, int numWorkers, int minSegmentLength, int overlap,
+                                 const ThreadPool::WorkerInit &workerInit ) const
+{
+    const int frameCount = _index.getFrameCount( );
+    poses.assign( frameCount, FramePose( ) );
+
+    // the segments start at the seek points, at least minSegmentLength frames apart
+    vector<int> starts( 1, 0 );
+    const vector<int> &seekPoints = _index.getSeekPoints( );
+    for( size_t i = 0; i < seekPoints.size( ); ++i )
+    {
+        if( seekPoints[i] - starts.back( ) >= minSegmentLength && seekPoints[i] < frameCount )
+            starts.push_back( seekPoints[i] );
+    }
+    starts.push_back( frameCount );
+
+    atomic<bool> ok( true );
+    {
+        // each segment writes only its own range of poses
+        ThreadPool pool( min( numWorkers, ( int ) starts.size( ) - 1 ), workerInit );
+        for( size_t s = 0; s + 1 < starts.size( ); ++s )
+        {
+            const int start = starts[s], end = starts[s + 1];
+            const int warmupStart = max( 0, start - overlap );
+            pool.submit( [this, warmupStart, start, end, &poses, &ok]
+            {
+                if( !processSegment( warmupStart, start, end, poses ) )
+                    ok = false;
+            } );
+        }
+        // the pool is joined here, once all the segments are done
+    }
+
+    return ok;
+}
+
+/**
+ * Track the frames [warmupStart, end) storing the poses of [start, end)
+ *
+ * @param[in] warmupStart the first frame to process
+ * @param[in] start the first frame of the segment
+ * @param[in] end the frame after the last one of the segment
+ * @param[out] poses the poses of the video
+ * @return false if the segment could not be read
+ */
+bool SegmentedVideoTracker::processSegment( int warmupStart, int start, int end, std::vector<FramePose> &poses ) const
+{
+    VideoCapture capture;
+    if( !_index.openAt( capture, warmupStart ) )
+    {
+        cerr << "Could not seek to frame " << warmupStart << endl;
+        return false;
+    }
+
+    // a new tracker starts with a full detection
+    unique_ptr<ICameraTracker> tracker = _factory( );
+    // the segments run in parallel, their messages would interleave
+    tracker->setVerbose( false );
+
+    for( int frame = warmupStart; frame < end; ++frame )
+    {
+        Mat view;
+        if( !capture.read( view ) || view.empty( ) )
+        {
+            cerr << "Could not read frame " << frame << endl;
+            return false;
+        }
+
+        Mat pose;
+        const bool found = tracker->process( view, pose, _cam, _boardSize, _pattern );
+
+        // the warm up frames belong to the previous segment
+        if( frame >= start )
+        {
+            FramePose &result = poses[frame];
+            result.frame = frame;
+            result.timestamp = _index.getTimestamp( frame );
+            result.found = found;
+            if( found )
+                result.pose = pose.clone( );
+        }
+    }
+    return true;
+}
@@ -0,0 +1,203 @@
+#include "tracker/ThreadBudget.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Set up the budget
+ *
+ * @param[in] numCores the cores to share, 0 for all the cores available to the process
+ * @param[in] pinWorkers true to pin each worker to its share of the cores
+ */
+ThreadBudget::ThreadBudget( int numCores, bool pinWorkers ) : _pinWorkers( pinWorkers )
+{
+#ifdef __linux__
+    // the process may be restricted to some of the cores (taskset, containers)
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    if( sched_getaffinity( 0, sizeof( set ), &set ) == 0 )
+    {
+        for( int c = 0; c < CPU_SETSIZE; ++c )
+        {
+            if( CPU_ISSET( c, &set ) )
+                _cores.push_back( c );
+        }
+    }
+#endif
+    if( _cores.empty( ) )
+    {
+        for( int c = 0; c < max( getNumberOfCPUs( ), 1 ); ++c )
+            _cores.push_back( c );
+    }
+
+    if( numCores > 0 && numCores < ( int ) _cores.size( ) )
+        _cores.resize( numCores );
+}
+
+/**
+ * Decide the number of workers and of OpenCV threads of a stage
+ *
+ * @param[in] stage the stage
+ * @param[in] requestedWorkers the workers asked for, 0 to use all the cores left
+ * @param[in] maxUsefulWorkers the workers the stage can keep busy (e.g. one per camera), 0 if not bounded
+ * @param[in] auxiliaryThreads the threads of the stage that are not workers (at most half of the cores are reserved for them)
+ * @return the allocation, also recorded for the telemetry
+ */
+ThreadAllocation ThreadBudget::allocate( PipelineStage stage, int requestedWorkers, int maxUsefulWorkers, int auxiliaryThreads )
+{
+    ThreadAllocation allocation;
+    allocation.stage = stage;
+    allocation.numCores = getNumCores( );
+    allocation.requestedWorkers = requestedWorkers;
+    allocation.reservedCores = min( max( auxiliaryThreads, 0 ), allocation.numCores / 2 );
+
+    const int available = allocation.numCores - allocation.reservedCores;
+    if( stage == STAGE_SEQUENTIAL )
+    {
+        allocation.workers = 1;
+    }
+    else
+    {
+        // more workers than cores would only compete with each other
+        allocation.workers = ( requestedWorkers > 0 ) ? min( requestedWorkers, available ) : available;
+        if( maxUsefulWorkers > 0 )
+            allocation.workers = min( allocation.workers, maxUsefulWorkers );
+        allocation.workers = max( allocation.workers, 1 );
+    }
+
+    // each worker runs the parallel functions of OpenCV on its share of the cores
+    const int share = max( available / allocation.workers, 1 );
+    allocation.opencvThreads = share;
+
+    allocation.pinned = _pinWorkers && allocation.workers > 1;
+    if( allocation.pinned )
+    {
+        allocation.workerCores.resize( allocation.workers );
+        for( int w = 0; w < allocation.workers; ++w )
+        {
+            const int first = allocation.reservedCores + w * share;
+            for( int c = 0; c < share; ++c )
+                allocation.workerCores[w].push_back( _cores[first + c] );
+        }
+    }
+
+    _allocations.push_back( allocation );
+    return allocation;
+}
+
+/**
+ * Set the number of threads of OpenCV for a stage about to start
+ *
+ * @param[in] allocation the allocation of the stage
+ */
+void ThreadBudget::apply( const ThreadAllocation &allocation )
+{
+    setNumThreads( allocation.opencvThreads );
+}
+
+/**
+ * Return the function pinning the workers of a stage, to give to its thread pool
+ *
+ * @param[in] allocation the allocation of the stage
+ * @return the function called by each worker when it starts, empty if the workers are not pinned
+ */
+ThreadPool::WorkerInit ThreadBudget::workerInit( const ThreadAllocation &allocation )
+{
+    if( !allocation.pinned )
+        return ThreadPool::WorkerInit( );
+
+    const vector<vector<int> > workerCores = allocation.workerCores;
+    return [workerCores]( int worker )
+    {
+        if( !pinCurrentThread( workerCores[worker % workerCores.size( )] ) )
+            cerr << "Could not pin the worker " << worker << endl;
+    };
+}
+
+/**
+ * Pin the calling thread to a set of cores (only on Linux)
+ *
+ * @param[in] cores the indices of the cores
+ * @return false if the thread could not be pinned
+ */
+bool ThreadBudget::pinCurrentThread( const std::vector<int> &cores )
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    for( size_t i = 0; i < cores.size( ); ++i )
+        CPU_SET( cores[i], &set );
+    return !cores.empty( ) && pthread_setaffinity_np( pthread_self( ), sizeof( set ), &set ) == 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Return the name of a stage
+ *
+ * @param[in] stage the stage
+ * @return its name
+ */
+std::string getStageName( PipelineStage stage )
+{
+    switch( stage )
+    {
+        case STAGE_SEQUENTIAL:
+            return "sequential";
+        case STAGE_FRAME_PARALLEL:
+            return "frame_parallel";
+        case STAGE_SEGMENTS:
+            return "segments";
+        case STAGE_MULTI_CAMERA:
+            return "multi_camera";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * Print an allocation on a single line
+ *
+ * @param[in,out] os the output stream
+ * @param[in] allocation the allocation to print
+ * @return the output stream
+ */
+std::ostream & operator<<( std::ostream &os, const ThreadAllocation &allocation )
+{
+    os << getStageName( allocation.stage ) << ": " << allocation.workers << " workers x " << allocation.opencvThreads
+            << " OpenCV threads on " << allocation.numCores << " cores";
+    if( allocation.reservedCores > 0 )
+        os << " (" << allocation.reservedCores << " reserved)";
+    if( allocation.requestedWorkers > 0 && allocation.requestedWorkers != allocation.workers )
+        os << ", " << allocation.requestedWorkers << " workers requested";
+    if( allocation.pinned )
+        os << ", pinned";
+    return os;
+}
+
+/**
+ * Write an allocation in a file storage, as a map (fs << "threads" << allocation)
+ *
+ * @param[in,out] fs the file storage
+ * @param[in] name unused, the key is written by the caller
+ * @param[in] allocation the allocation to write
+ */
+void write( cv::FileStorage &fs, const std::string &name, const ThreadAllocation &allocation )
+{
+    fs << "{" << "stage" << getStageName( allocation.stage )
+            << "cores" << allocation.numCores
+            << "reserved_cores" << allocation.reservedCores
+            << "requested_workers" << allocation.requestedWorkers
+            << "workers" << allocation.workers
+            << "opencv_threads" << allocation.opencvThreads
+            << "pinned" << ( int ) allocation.pinned << "}";
+}
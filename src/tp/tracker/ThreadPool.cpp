@@ -0,0 +1,73 @@
+#include "tracker/ThreadPool.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Start the workers
+ *
+ * @param[in] numThreads the number of worker threads (at least 1)
+ * @param[in] init the function each worker calls before its first task (e.g. to pin it to some cores), may be empty
+ */
+ThreadPool::ThreadPool( int numThreads, const WorkerInit &init )
+{
+    numThreads = max( numThreads, 1 );
+    _workers.reserve( numThreads );
+    for( int i = 0; i < numThreads; ++i )
+        _workers.push_back( thread( &ThreadPool::workerLoop, this, i, init ) );
+}
+
+/**
+ * Add a task to the queue, it will be run by the first idle worker
+ *
+ * @param[in] task the task to run
+ */
+void ThreadPool::submit( std::function<void( )> task )
+{
+    {
+        lock_guard<mutex> lock( _mutex );
+        _tasks.push_back( move( task ) );
+    }
+    _taskReady.notify_one( );
+}
+
+/**
+ * Run the tasks still in the queue and join the workers
+ */
+ThreadPool::~ThreadPool( )
+{
+    {
+        lock_guard<mutex> lock( _mutex );
+        _stop = true;
+    }
+    _taskReady.notify_all( );
+    for( size_t i = 0; i < _workers.size( ); ++i )
+        _workers[i].join( );
+}
+
+/**
+ * The loop of each worker: it runs the tasks of the queue until the pool is destroyed
+ *
+ * @param[in] index the index of the worker
+ * @param[in] init the function to call before the first task, may be empty
+ */
+void ThreadPool::workerLoop( int index, WorkerInit init )
+{
+    if( init )
+        init( index );
+
+    while( true )
+    {
+        function<void( )> task;
+        {
+            unique_lock<mutex> lock( _mutex );
+            _taskReady.wait( lock, [this] { return _stop || !_tasks.empty( ); } );
+            if( _tasks.empty( ) )
+                return;
+            task = move( _tasks.front( ) );
+            _tasks.pop_front( );
+        }
+        task( );
+    }
+}
@@ -0,0 +1,178 @@
+#include "tracker/TiledChessboardSearch.hpp"
+#include "tracker/CornerRefiner.hpp"
+#include "tracker/SaddleChessboardDetector.hpp"
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+
+// the maximum side of a tile once downscaled for the coarse search
+const int COARSE_TILE_SIDE = 640;
+
+// the minimum side in pixels of a square of the board in the downscaled tiles
+const double MIN_COARSE_SQUARE = 8.0;
+
+/**
+ * Split the frame in tiles of a given side, overlapping so that consecutive
+ * tiles are at most step pixels apart
+ *
+ * @param[in] frameSize the size of the frame
+ * @param[in] tileSide the side of the tiles
+ * @param[in] step the maximum distance between two consecutive tiles
+ * @param[out] tiles the tiles, row major
+ */
+void splitInTiles( const Size &frameSize, int tileSide, int step, vector<Rect> &tiles )
+{
+    const int tileWidth = min( tileSide, frameSize.width );
+    const int tileHeight = min( tileSide, frameSize.height );
+
+    // the tiles are spread evenly, the last one ends on the border of the frame
+    const int numX = 1 + ( frameSize.width - tileWidth + step - 1 ) / step;
+    const int numY = 1 + ( frameSize.height - tileHeight + step - 1 ) / step;
+
+    tiles.clear( );
+    for( int j = 0; j < numY; ++j )
+    {
+        const int y = ( numY > 1 ) ? cvRound( j * ( frameSize.height - tileHeight ) / ( double ) ( numY - 1 ) ) : 0;
+        for( int i = 0; i < numX; ++i )
+        {
+            const int x = ( numX > 1 ) ? cvRound( i * ( frameSize.width - tileWidth ) / ( double ) ( numX - 1 ) ) : 0;
+            tiles.push_back( Rect( x, y, tileWidth, tileHeight ) );
+        }
+    }
+}
+
+/**
+ * Search the board in a range of tiles. A tile is skipped once the board has
+ * been found in a tile before it, so the result is the first tile with the
+ * board whatever the scheduling of the tiles
+ */
+class TileSearchBody : public ParallelLoopBody
+{
+public:
+
+    TileSearchBody( const Mat &grey, const vector<Rect> &tiles, double scale, const Size &boardSize, ChessboardDetector detector,
+                    vector<vector<Point2f> > &tileCorners, atomic<int> &firstFound )
+    : _grey( grey ), _tiles( tiles ), _scale( scale ), _boardSize( boardSize ), _detector( detector ),
+      _tileCorners( tileCorners ), _firstFound( firstFound ) { }
+
+    void operator()( const Range &range ) const override
+    {
+        for( int t = range.start; t < range.end; ++t )
+        {
+            if( t > _firstFound.load( ) )
+                continue;
+
+            Mat coarse;
+            resize( _grey( _tiles[t] ), coarse, Size( ), _scale, _scale, INTER_AREA );
+
+            // the tiles are already searched in parallel, the saddle detector works on a single band
+            vector<Point2f> &corners = _tileCorners[t];
+            bool found;
+            if( _detector == DETECTOR_FAST )
+                found = findChessboardSaddles( coarse, _boardSize, corners, 1 );
+            else
+                found = findChessboardCorners( coarse, _boardSize, corners,
+                                               CALIB_CB_ADAPTIVE_THRESH | CALIB_CB_NORMALIZE_IMAGE | CALIB_CB_FAST_CHECK );
+            if( !found )
+            {
+                corners.clear( );
+                continue;
+            }
+
+            int first = _firstFound.load( );
+            while( t < first && !_firstFound.compare_exchange_weak( first, t ) )
+            {
+            }
+        }
+    }
+
+private:
+    const Mat &_grey;
+    const vector<Rect> &_tiles;
+    const double _scale;
+    const Size _boardSize;
+    const ChessboardDetector _detector;
+    vector<vector<Point2f> > &_tileCorners;
+    atomic<int> &_firstFound;
+};
+
+}
+
+/**
+ * Search a chessboard in a high resolution frame by tiles
+ *
+ * @param[in] image the image to process, grey level or BGR
+ * @param[in] boardSize the number of inner corners per row and column
+ * @param[out] corners the corners of the chessboard, in the frame
+ * @param[in] expectedBoardSide the expected side in pixels of the bounding box of the board
+ * @param[in] detector the detector used on the tiles
+ * @return true if the chessboard has been found
+ */
+bool findChessboardTiled( const Mat &image, const Size &boardSize, vector<Point2f> &corners, int expectedBoardSide, ChessboardDetector detector )
+{
+    CV_Assert( expectedBoardSide > 0 );
+    corners.clear( );
+
+    Mat grey;
+    if( image.channels( ) == 1 )
+        grey = image;
+    else
+        cvtColor( image, grey, CV_BGR2GRAY );
+
+    // a board not larger than the footprint lies entirely in one of the tiles
+    vector<Rect> tiles;
+    splitInTiles( grey.size( ), 2 * expectedBoardSide, expectedBoardSide, tiles );
+
+    // downscale the tiles as much as possible while keeping the squares detectable
+    const int tileSide = max( tiles[0].width, tiles[0].height );
+    const double minScale = MIN_COARSE_SQUARE * ( max( boardSize.width, boardSize.height ) + 1 ) / expectedBoardSide;
+    const double scale = min( max( ( double ) COARSE_TILE_SIDE / tileSide, minScale ), 1.0 );
+
+    vector<vector<Point2f> > tileCorners( tiles.size( ) );
+    atomic<int> firstFound( INT_MAX );
+    parallel_for_( Range( 0, ( int ) tiles.size( ) ),
+                   TileSearchBody( grey, tiles, scale, boardSize, detector, tileCorners, firstFound ) );
+
+    if( firstFound.load( ) == INT_MAX )
+        return false;
+
+    // back to the frame, the centres of the pixels are at integer coordinates at both scales
+    const Rect &tile = tiles[firstFound.load( )];
+    corners = tileCorners[firstFound.load( )];
+    const Point2f offset( ( float ) tile.x, ( float ) tile.y );
+    for( size_t i = 0; i < corners.size( ); ++i )
+        corners[i] = Point2f( ( float ) ( ( corners[i].x + 0.5 ) / scale - 0.5 ), ( float ) ( ( corners[i].y + 0.5 ) / scale - 0.5 ) ) + offset;
+
+    // the coarse corners are about 1 / scale pixels off, the window must cover
+    // that error without reaching the neighbour corners
+    if( scale < 1.0 )
+    {
+        float minSpacing2 = FLT_MAX;
+        for( int r = 0; r < boardSize.height; ++r )
+        {
+            for( int c = 0; c + 1 < boardSize.width; ++c )
+            {
+                const Point2f d = corners[r * boardSize.width + c + 1] - corners[r * boardSize.width + c];
+                minSpacing2 = min( minSpacing2, d.dot( d ) );
+            }
+        }
+        const float spacing = ( minSpacing2 < FLT_MAX ) ? sqrt( minSpacing2 ) : ( float ) expectedBoardSide;
+        const int maxHalfWindow = max( ( int ) ( 0.5f * spacing ) - 1, 2 );
+        const int halfWindow = min( max( cvRound( 2.0 / scale ), 5 ), maxHalfWindow );
+        refineCornersSubPix( grey, corners, Size( halfWindow, halfWindow ), TermCriteria( CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 20, 0.01 ) );
+    }
+
+    return true;
+}
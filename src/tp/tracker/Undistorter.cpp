@@ -0,0 +1,389 @@
+#include "tracker/Undistorter.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define UNDISTORT_USE_SSE2 1
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define UNDISTORT_USE_NEON 1
+#endif
+
+#if defined( __AVX2__ )
+#define UNDISTORT_USE_SSE2 1
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+
+// precision of the fractional part of the source coordinates
+const int WEIGHT_BITS = 7;
+const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+// the four bilinear weights sum up to 1 << SUM_SHIFT
+const int SUM_SHIFT = 2 * WEIGHT_BITS;
+const int SUM_ROUND = 1 << ( SUM_SHIFT - 1 );
+
+// fixed point coefficients of the BGR to grey conversion, the same used by cvtColor
+const int GREY_SHIFT = 14;
+const int GREY_B = 1868;
+const int GREY_G = 9617;
+const int GREY_R = 4899;
+
+inline uchar bgrToGrey( const uchar *bgr )
+{
+    return ( uchar ) ( ( bgr[0] * GREY_B + bgr[1] * GREY_G + bgr[2] * GREY_R + ( 1 << ( GREY_SHIFT - 1 ) ) ) >> GREY_SHIFT );
+}
+
+/**
+ * Bilinear interpolation of a BGR pixel
+ *
+ * @param[in] top pointer to the top-left pixel of the 2x2 neighbourhood
+ * @param[in] bottom pointer to the bottom-left pixel of the 2x2 neighbourhood
+ * @param[in] wx horizontal fraction in 1/WEIGHT_ONE of pixel
+ * @param[in] wy vertical fraction in 1/WEIGHT_ONE of pixel
+ * @param[out] bgr the interpolated pixel
+ */
+inline void interpolateScalar( const uchar *top, const uchar *bottom, int wx, int wy, uchar *bgr )
+{
+    const int w00 = ( WEIGHT_ONE - wx ) * ( WEIGHT_ONE - wy );
+    const int w01 = wx * ( WEIGHT_ONE - wy );
+    const int w10 = ( WEIGHT_ONE - wx ) * wy;
+    const int w11 = wx * wy;
+
+    for( int c = 0; c < 3; ++c )
+    {
+        bgr[c] = ( uchar ) ( ( top[c] * w00 + top[c + 3] * w01 + bottom[c] * w10 + bottom[c + 3] * w11 + SUM_ROUND ) >> SUM_SHIFT );
+    }
+}
+
+#if defined( UNDISTORT_USE_SSE2 )
+
+/**
+ * SSE2 accumulation of the interpolation. The two rows are loaded with 8 bytes
+ * loads (the 2 BGR pixels plus 2 bytes that are ignored), then the top and
+ * bottom values of each channel are interleaved so that a single madd computes
+ * top * wTop + bottom * wBottom for the three channels of a column.
+ *
+ * @return the 32 bit lanes B, G, R, (garbage) of the interpolated pixel
+ */
+inline __m128i accumulateSSE2( const __m128i &top, const __m128i &bottom, int wx, int wy )
+{
+    const int w00 = ( WEIGHT_ONE - wx ) * ( WEIGHT_ONE - wy );
+    const int w01 = wx * ( WEIGHT_ONE - wy );
+    const int w10 = ( WEIGHT_ONE - wx ) * wy;
+    const int w11 = wx * wy;
+
+    // (t, b) pairs of the left pixel and of the right pixel
+    const __m128i left = _mm_unpacklo_epi16( top, bottom );
+    const __m128i right = _mm_unpacklo_epi16( _mm_srli_si128( top, 6 ), _mm_srli_si128( bottom, 6 ) );
+
+    __m128i sum = _mm_add_epi32( _mm_madd_epi16( left, _mm_set1_epi32( ( w10 << 16 ) | w00 ) ),
+                                 _mm_madd_epi16( right, _mm_set1_epi32( ( w11 << 16 ) | w01 ) ) );
+    return _mm_srli_epi32( _mm_add_epi32( sum, _mm_set1_epi32( SUM_ROUND ) ), SUM_SHIFT );
+}
+
+inline void storeBGR( const __m128i &sum, uchar *bgr )
+{
+    const int packed = _mm_cvtsi128_si32( _mm_packus_epi16( _mm_packs_epi32( sum, sum ), sum ) );
+    bgr[0] = ( uchar ) packed;
+    bgr[1] = ( uchar ) ( packed >> 8 );
+    bgr[2] = ( uchar ) ( packed >> 16 );
+}
+
+inline void interpolate( const uchar *top, const uchar *bottom, int wx, int wy, uchar *bgr )
+{
+    const __m128i zero = _mm_setzero_si128( );
+    const __m128i t = _mm_unpacklo_epi8( _mm_loadl_epi64( ( const __m128i* ) top ), zero );
+    const __m128i b = _mm_unpacklo_epi8( _mm_loadl_epi64( ( const __m128i* ) bottom ), zero );
+    storeBGR( accumulateSSE2( t, b, wx, wy ), bgr );
+}
+
+#elif defined( UNDISTORT_USE_NEON )
+
+inline void interpolate( const uchar *top, const uchar *bottom, int wx, int wy, uchar *bgr )
+{
+    const uint16_t w00 = ( uint16_t ) ( ( WEIGHT_ONE - wx ) * ( WEIGHT_ONE - wy ) );
+    const uint16_t w01 = ( uint16_t ) ( wx * ( WEIGHT_ONE - wy ) );
+    const uint16_t w10 = ( uint16_t ) ( ( WEIGHT_ONE - wx ) * wy );
+    const uint16_t w11 = ( uint16_t ) ( wx * wy );
+
+    // b0 g0 r0 b1 g1 r1 x x
+    const uint16x8_t t = vmovl_u8( vld1_u8( top ) );
+    const uint16x8_t b = vmovl_u8( vld1_u8( bottom ) );
+
+    uint32x4_t acc = vmull_n_u16( vget_low_u16( t ), w00 );
+    acc = vmlal_n_u16( acc, vget_low_u16( vextq_u16( t, t, 3 ) ), w01 );
+    acc = vmlal_n_u16( acc, vget_low_u16( b ), w10 );
+    acc = vmlal_n_u16( acc, vget_low_u16( vextq_u16( b, b, 3 ) ), w11 );
+
+    const uint16x4_t res = vrshrn_n_u32( acc, SUM_SHIFT );
+    bgr[0] = ( uchar ) vget_lane_u16( res, 0 );
+    bgr[1] = ( uchar ) vget_lane_u16( res, 1 );
+    bgr[2] = ( uchar ) vget_lane_u16( res, 2 );
+}
+
+#else
+
+inline void interpolate( const uchar *top, const uchar *bottom, int wx, int wy, uchar *bgr )
+{
+    interpolateScalar( top, bottom, wx, wy, bgr );
+}
+
+#endif
+
+#if defined( __AVX2__ )
+
+/**
+ * AVX2 version working on two destination pixels at once, one per 128 bit lane
+ */
+inline void interpolatePair( const uchar *top0, const uchar *bottom0, int wx0, int wy0,
+                             const uchar *top1, const uchar *bottom1, int wx1, int wy1,
+                             uchar *bgr0, uchar *bgr1 )
+{
+    const __m256i zero = _mm256_setzero_si256( );
+    const __m256i t = _mm256_unpacklo_epi8( _mm256_inserti128_si256( _mm256_castsi128_si256( _mm_loadl_epi64( ( const __m128i* ) top0 ) ),
+                                                                     _mm_loadl_epi64( ( const __m128i* ) top1 ), 1 ), zero );
+    const __m256i b = _mm256_unpacklo_epi8( _mm256_inserti128_si256( _mm256_castsi128_si256( _mm_loadl_epi64( ( const __m128i* ) bottom0 ) ),
+                                                                     _mm_loadl_epi64( ( const __m128i* ) bottom1 ), 1 ), zero );
+
+    const int w00a = ( WEIGHT_ONE - wx0 ) * ( WEIGHT_ONE - wy0 ), w01a = wx0 * ( WEIGHT_ONE - wy0 );
+    const int w10a = ( WEIGHT_ONE - wx0 ) * wy0, w11a = wx0 * wy0;
+    const int w00b = ( WEIGHT_ONE - wx1 ) * ( WEIGHT_ONE - wy1 ), w01b = wx1 * ( WEIGHT_ONE - wy1 );
+    const int w10b = ( WEIGHT_ONE - wx1 ) * wy1, w11b = wx1 * wy1;
+
+    const __m256i wLeft = _mm256_setr_epi32( ( w10a << 16 ) | w00a, ( w10a << 16 ) | w00a, ( w10a << 16 ) | w00a, ( w10a << 16 ) | w00a,
+                                             ( w10b << 16 ) | w00b, ( w10b << 16 ) | w00b, ( w10b << 16 ) | w00b, ( w10b << 16 ) | w00b );
+    const __m256i wRight = _mm256_setr_epi32( ( w11a << 16 ) | w01a, ( w11a << 16 ) | w01a, ( w11a << 16 ) | w01a, ( w11a << 16 ) | w01a,
+                                              ( w11b << 16 ) | w01b, ( w11b << 16 ) | w01b, ( w11b << 16 ) | w01b, ( w11b << 16 ) | w01b );
+
+    const __m256i left = _mm256_unpacklo_epi16( t, b );
+    const __m256i right = _mm256_unpacklo_epi16( _mm256_srli_si256( t, 6 ), _mm256_srli_si256( b, 6 ) );
+
+    __m256i sum = _mm256_add_epi32( _mm256_madd_epi16( left, wLeft ), _mm256_madd_epi16( right, wRight ) );
+    sum = _mm256_srli_epi32( _mm256_add_epi32( sum, _mm256_set1_epi32( SUM_ROUND ) ), SUM_SHIFT );
+
+    storeBGR( _mm256_castsi256_si128( sum ), bgr0 );
+    storeBGR( _mm256_extracti128_si256( sum, 1 ), bgr1 );
+}
+
+#endif
+
+/**
+ * Parallel body remapping a stripe of rows
+ */
+class RemapBody : public ParallelLoopBody
+{
+public:
+
+    RemapBody( const Mat &src, const Mat &mapXY, const Mat &mapW, Mat *colour, Mat &grey )
+    : _src( src ), _mapXY( mapXY ), _mapW( mapW ), _colour( colour ), _grey( grey ) { }
+
+    void operator()( const Range &rows ) const override
+    {
+        const size_t step = _src.step[0];
+
+        // an 8 bytes load starting after this address would read past the
+        // end of the image (it can only happen on the last row)
+        const uchar *lastLoad = _src.dataend - 8;
+
+        // destination pixels used when colour is not needed
+        uchar pixel[3];
+#if defined( __AVX2__ )
+        uchar pixel1[3];
+#endif
+
+        for( int y = rows.start; y < rows.end; ++y )
+        {
+            const short *xy = _mapXY.ptr<short>( y );
+            const uchar *w = _mapW.ptr<uchar>( y );
+            uchar *bgr = _colour ? _colour->ptr<uchar>( y ) : nullptr;
+            uchar *grey = _grey.ptr<uchar>( y );
+
+            int x = 0;
+
+#if defined( __AVX2__ )
+            for( ; x + 1 < _grey.cols; x += 2 )
+            {
+                const int x0 = xy[2 * x], y0 = xy[2 * x + 1];
+                const int x1 = xy[2 * x + 2], y1 = xy[2 * x + 3];
+
+                // both pixels inside and far enough from the end of the image
+                if( x0 < 0 || x1 < 0 )
+                    break;
+
+                const uchar *top0 = _src.ptr<uchar>( y0 ) + 3 * x0;
+                const uchar *top1 = _src.ptr<uchar>( y1 ) + 3 * x1;
+                if( top0 + step > lastLoad || top1 + step > lastLoad )
+                    break;
+                uchar *out0 = bgr ? bgr + 3 * x : pixel;
+                uchar *out1 = bgr ? bgr + 3 * x + 3 : pixel1;
+
+                interpolatePair( top0, top0 + step, w[2 * x], w[2 * x + 1],
+                                 top1, top1 + step, w[2 * x + 2], w[2 * x + 3],
+                                 out0, out1 );
+
+                grey[x] = bgrToGrey( out0 );
+                grey[x + 1] = bgrToGrey( out1 );
+            }
+#endif
+
+            for( ; x < _grey.cols; ++x )
+            {
+                uchar *out = bgr ? bgr + 3 * x : pixel;
+                const int x0 = xy[2 * x];
+                const int y0 = xy[2 * x + 1];
+
+                if( x0 < 0 )
+                {
+                    // outside the source image, constant black border as cv::undistort
+                    out[0] = out[1] = out[2] = 0;
+                    grey[x] = 0;
+                    continue;
+                }
+
+                const uchar *top = _src.ptr<uchar>( y0 ) + 3 * x0;
+
+                if( top + step <= lastLoad )
+                    interpolate( top, top + step, w[2 * x], w[2 * x + 1], out );
+                else
+                    interpolateScalar( top, top + step, w[2 * x], w[2 * x + 1], out );
+
+                grey[x] = bgrToGrey( out );
+            }
+        }
+    }
+
+private:
+
+    const Mat &_src;
+    const Mat &_mapXY;
+    const Mat &_mapW;
+    Mat *_colour;
+    Mat &_grey;
+};
+
+}
+
+/**
+ * Build the undistortion map for the given camera parameters
+ *
+ * @param[in] matK the 3x3 calibration matrix
+ * @param[in] distCoeff the distortion coefficients
+ * @param[in] imageSize the size of the frames to undistort
+ */
+void Undistorter::init( const cv::Mat &matK, const cv::Mat &distCoeff, const cv::Size &imageSize )
+{
+    CV_Assert( imageSize.width >= 2 && imageSize.height >= 2 );
+
+    // the same map computed by cv::undistort, with the new camera matrix equal to K
+    Mat mapX, mapY;
+    initUndistortRectifyMap( matK, distCoeff, Mat( ), matK, imageSize, CV_32FC1, mapX, mapY );
+
+    _mapXY.create( imageSize, CV_16SC2 );
+    _mapW.create( imageSize, CV_8UC2 );
+
+    const float maxX = ( float ) ( imageSize.width - 1 );
+    const float maxY = ( float ) ( imageSize.height - 1 );
+
+    for( int y = 0; y < imageSize.height; ++y )
+    {
+        const float *mx = mapX.ptr<float>( y );
+        const float *my = mapY.ptr<float>( y );
+        short *xy = _mapXY.ptr<short>( y );
+        uchar *w = _mapW.ptr<uchar>( y );
+
+        for( int x = 0; x < imageSize.width; ++x )
+        {
+            const float sx = mx[x];
+            const float sy = my[x];
+
+            if( !( sx >= 0 && sy >= 0 && sx <= maxX && sy <= maxY ) )
+            {
+                xy[2 * x] = xy[2 * x + 1] = -1;
+                w[2 * x] = w[2 * x + 1] = 0;
+                continue;
+            }
+
+            // keep x0 + 1 and y0 + 1 inside the image, the last row/column are
+            // reached with a full weight on the second pixel
+            const int x0 = std::min( ( int ) sx, imageSize.width - 2 );
+            const int y0 = std::min( ( int ) sy, imageSize.height - 2 );
+
+            xy[2 * x] = ( short ) x0;
+            xy[2 * x + 1] = ( short ) y0;
+            w[2 * x] = ( uchar ) std::min( cvRound( ( sx - x0 ) * WEIGHT_ONE ), WEIGHT_ONE );
+            w[2 * x + 1] = ( uchar ) std::min( cvRound( ( sy - y0 ) * WEIGHT_ONE ), WEIGHT_ONE );
+        }
+    }
+
+    _imageSize = imageSize;
+}
+
+/**
+ * Use an existing undistortion map (e.g. loaded from a cache). The map is
+ * not copied, so the data must stay valid as long as the Undistorter is used
+ *
+ * @param[in] mapXY the integer source coordinates (CV_16SC2)
+ * @param[in] mapW the fractional part of the source coordinates (CV_8UC2)
+ */
+void Undistorter::setMaps( const cv::Mat &mapXY, const cv::Mat &mapW )
+{
+    CV_Assert( mapXY.type( ) == CV_16SC2 && mapW.type( ) == CV_8UC2 && mapXY.size( ) == mapW.size( ) );
+
+    _mapXY = mapXY;
+    _mapW = mapW;
+    _imageSize = mapXY.size( );
+}
+
+/**
+ * Undistort a BGR frame and compute the grey level version of the result
+ *
+ * @param[in] src the BGR frame to undistort (CV_8UC3)
+ * @param[out] colour the undistorted BGR frame, it can be the same Mat as src
+ * @param[out] grey the grey level version of the undistorted frame
+ */
+void Undistorter::process( const cv::Mat &src, cv::Mat &colour, cv::Mat &grey ) const
+{
+    // the remap cannot be done in place: if colour shares its data with src
+    // write in a new buffer and swap it at the end
+    Mat dst;
+    if( colour.data != src.data )
+        dst = colour;
+    dst.create( _imageSize, CV_8UC3 );
+
+    remapAndConvert( src, &dst, grey );
+
+    colour = dst;
+}
+
+/**
+ * Undistort a BGR frame producing only its grey level version
+ *
+ * @param[in] src the BGR frame to undistort (CV_8UC3)
+ * @param[out] grey the grey level version of the undistorted frame
+ */
+void Undistorter::process( const cv::Mat &src, cv::Mat &grey ) const
+{
+    remapAndConvert( src, nullptr, grey );
+}
+
+void Undistorter::remapAndConvert( const cv::Mat &src, cv::Mat *colour, cv::Mat &grey ) const
+{
+    CV_Assert( !_mapXY.empty( ) );
+    CV_Assert( src.type( ) == CV_8UC3 && src.size( ) == _imageSize );
+    CV_Assert( grey.data != src.data );
+
+    grey.create( _imageSize, CV_8UC1 );
+
+    parallel_for_( Range( 0, _imageSize.height ), RemapBody( src, _mapXY, _mapW, colour, grey ) );
+}
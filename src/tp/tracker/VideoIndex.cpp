@@ -0,0 +1,176 @@
+#include "tracker/VideoIndex.hpp"
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Load the index of the video from its cache, or build it (and save the
+ * cache) if the cache is missing or stale
+ *
+ * @param[in] videoFilename the video file
+ * @param[in] seekPointSpacing the number of frames between two seek points
+ * @param[in] useCache true to load/save the cache
+ * @return true if success
+ */
+bool VideoIndex::init( const std::string &videoFilename, int seekPointSpacing, bool useCache )
+{
+    _videoFilename = videoFilename;
+    seekPointSpacing = max( seekPointSpacing, 1 );
+
+    // the size and the modification time of the video identify the version the cache comes from
+    struct stat videoStat;
+    if( stat( videoFilename.c_str( ), &videoStat ) != 0 )
+    {
+        cerr << "Could not find the video file " << videoFilename << endl;
+        return false;
+    }
+
+    const string indexFilename = videoFilename + ".index.yml";
+    if( useCache && load( indexFilename, videoStat.st_size, videoStat.st_mtime, seekPointSpacing ) )
+        return true;
+
+    if( !build( seekPointSpacing ) )
+        return false;
+
+    if( useCache && !save( indexFilename, videoStat.st_size, videoStat.st_mtime, seekPointSpacing ) )
+        cerr << "Could not write the video index " << indexFilename << endl;
+
+    return true;
+}
+
+/**
+ * Return the last seek point at or before the given frame
+ * @param[in] frame the index of the frame
+ * @return the index of the seek point
+ */
+int VideoIndex::getSeekPointBefore( int frame ) const
+{
+    vector<int>::const_iterator it = upper_bound( _seekPoints.begin( ), _seekPoints.end( ), frame );
+    return it == _seekPoints.begin( ) ? 0 : *( it - 1 );
+}
+
+/**
+ * Open the video positioned at the given frame: it seeks to the frame and
+ * checks the timestamp, if the backend seeks imprecisely the frames are
+ * grabbed from the beginning
+ *
+ * @param[in] capture the capture to open
+ * @param[in] frame the index of the first frame to read
+ * @return true if success
+ */
+bool VideoIndex::openAt( cv::VideoCapture &capture, int frame ) const
+{
+    if( !capture.open( _videoFilename ) )
+        return false;
+    if( frame <= 0 )
+        return true;
+
+    // seek to the frame before the requested one and check its timestamp: the
+    // position is the one after grabbing it
+    if( capture.set( CV_CAP_PROP_POS_FRAMES, frame - 1 ) && capture.grab( ) )
+    {
+        // half the duration of a frame
+        const double tolerance = frame < getFrameCount( ) ? 0.5 * ( _timestamps[frame] - _timestamps[frame - 1] ) : 0.;
+        if( fabs( capture.get( CV_CAP_PROP_POS_MSEC ) - _timestamps[frame - 1] ) <= tolerance )
+            return true;
+    }
+
+    // imprecise seek, walk from the beginning
+    if( !capture.open( _videoFilename ) )
+        return false;
+    for( int i = 0; i < frame; ++i )
+    {
+        if( !capture.grab( ) )
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Grab all the frames of the video to fill the index
+ *
+ * @param[in] seekPointSpacing the number of frames between two seek points
+ * @return true if success
+ */
+bool VideoIndex::build( int seekPointSpacing )
+{
+    VideoCapture capture( _videoFilename );
+    if( !capture.isOpened( ) )
+    {
+        cerr << "Could not open video file " << _videoFilename << endl;
+        return false;
+    }
+
+    _timestamps.clear( );
+    _seekPoints.clear( );
+
+    // grab only, the frames are not decoded
+    while( capture.grab( ) )
+    {
+        if( _timestamps.size( ) % seekPointSpacing == 0 )
+            _seekPoints.push_back( ( int ) _timestamps.size( ) );
+        _timestamps.push_back( capture.get( CV_CAP_PROP_POS_MSEC ) );
+    }
+
+    return !_timestamps.empty( );
+}
+
+/**
+ * Load the index from the cache
+ *
+ * @param[in] indexFilename the cache file
+ * @param[in] videoSize the size of the video file
+ * @param[in] videoTime the modification time of the video file
+ * @param[in] seekPointSpacing the number of frames between two seek points
+ * @return true if the cache exists and has been generated from the current video
+ */
+bool VideoIndex::load( const std::string &indexFilename, int64_t videoSize, int64_t videoTime, int seekPointSpacing )
+{
+    FileStorage fs;
+    if( !fs.open( indexFilename, FileStorage::READ ) )
+        return false;
+
+    // the 64 bits values are stored as doubles
+    double size = 0, time = 0;
+    int spacing = 0;
+    fs["video_size"] >> size;
+    fs["video_time"] >> time;
+    fs["seek_point_spacing"] >> spacing;
+    if( ( int64_t ) size != videoSize || ( int64_t ) time != videoTime || spacing != seekPointSpacing )
+        return false;
+
+    fs["timestamps"] >> _timestamps;
+    fs["seek_points"] >> _seekPoints;
+    return !_timestamps.empty( );
+}
+
+/**
+ * Save the index to the cache
+ *
+ * @param[in] indexFilename the cache file
+ * @param[in] videoSize the size of the video file
+ * @param[in] videoTime the modification time of the video file
+ * @param[in] seekPointSpacing the number of frames between two seek points
+ * @return true if success
+ */
+bool VideoIndex::save( const std::string &indexFilename, int64_t videoSize, int64_t videoTime, int seekPointSpacing ) const
+{
+    FileStorage fs;
+    if( !fs.open( indexFilename, FileStorage::WRITE ) )
+        return false;
+
+    fs << "video_size" << ( double ) videoSize;
+    fs << "video_time" << ( double ) videoTime;
+    fs << "seek_point_spacing" << seekPointSpacing;
+    fs << "frame_count" << getFrameCount( );
+    fs << "timestamps" << _timestamps;
+    fs << "seek_points" << _seekPoints;
+    return true;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "utility.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <array>
+#include <vector>
+
+// the size of the squares of the boards, it is the unit of the poses
+const float DEFAULT_SQUARE_SIZE = 25.0f;
+
+/**
+ * The position of a point of a board in units of squares (a literal type,
+ * unlike cv::Point2f, so that the models can be built at compile time)
+ */
+struct BoardCoordinates
+{
+    float x;
+    float y;
+};
+
+namespace board_detail
+{
+
+// the list of indices 0 ... N - 1 (std::index_sequence is C++14)
+template<int... I>
+struct IndexList
+{
+};
+
+template<int N, int... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...>
+{
+};
+
+template<int... I>
+struct MakeIndexList<0, I...>
+{
+    typedef IndexList<I...> type;
+};
+
+/**
+ * Return the position of a point of a board, in units of squares
+ *
+ * @tparam W the number of points per row
+ * @tparam P the type of pattern
+ * @param[in] i the index of the point, row major
+ * @return the position of the point
+ */
+template<int W, Pattern P>
+constexpr BoardCoordinates coordinates( int i )
+{
+    return BoardCoordinates{ ( float ) ( P == ASYMMETRIC_CIRCLES_GRID ? 2 * ( i % W ) + ( i / W ) % 2 : i % W ), ( float ) ( i / W ) };
+}
+
+/**
+ * Return the positions of the points of a board, in units of squares
+ *
+ * @tparam W the number of points per row
+ * @tparam P the type of pattern
+ * @return the positions of the points, row major
+ */
+template<int W, Pattern P, int... I>
+constexpr std::array<BoardCoordinates, sizeof...( I )> makeCoordinates( IndexList<I...> )
+{
+    return std::array<BoardCoordinates, sizeof...( I )>{ { coordinates<W, P>( I )... } };
+}
+
+}
+
+/**
+ * The geometry of a board known at compile time: the points of the model,
+ * in the same order as calcChessboardCorners, are a constexpr array.
+ *
+ * @tparam W the number of points per row
+ * @tparam H the number of rows
+ * @tparam P the type of pattern
+ */
+template<int W, int H, Pattern P>
+class Board
+{
+public:
+
+    static_assert( W > 0 && H > 0, "the board must have at least one point" );
+
+    static const int WIDTH = W;
+    static const int HEIGHT = H;
+    static const int NUM_POINTS = W * H;
+    static const Pattern PATTERN = P;
+
+    // the buffer of the model
+    typedef std::array<BoardCoordinates, W * H> Coordinates;
+
+    // the model of the board, in units of squares
+    static constexpr Coordinates COORDINATES = board_detail::makeCoordinates<W, P>( typename board_detail::MakeIndexList<W * H>::type( ) );
+
+    /**
+     * Return the size of the board as used by the runtime functions
+     * @return the number of points per row and column
+     */
+    static cv::Size size( )
+    {
+        return cv::Size( W, H );
+    }
+
+    /**
+     * Generate the points of the board on its plane
+     *
+     * @param[in] squareSize the size of the squares
+     * @param[out] points the points of the board
+     */
+    static void objectPoints( float squareSize, std::vector<cv::Point2f> &points )
+    {
+        points.resize( NUM_POINTS );
+        for( int i = 0; i < NUM_POINTS; ++i )
+            points[i] = cv::Point2f( COORDINATES[i].x * squareSize, COORDINATES[i].y * squareSize );
+    }
+
+    /**
+     * Generate the 3D points of the board, on the z = 0 plane
+     *
+     * @param[in] squareSize the size of the squares
+     * @param[out] points the points of the board
+     */
+    static void objectPoints3D( float squareSize, std::vector<cv::Point3f> &points )
+    {
+        points.resize( NUM_POINTS );
+        for( int i = 0; i < NUM_POINTS; ++i )
+            points[i] = cv::Point3f( COORDINATES[i].x * squareSize, COORDINATES[i].y * squareSize, 0.f );
+    }
+
+};
+
+template<int W, int H, Pattern P>
+constexpr typename Board<W, H, P>::Coordinates Board<W, H, P>::COORDINATES;
+
+// the boards of the project: the 9x6 chessboard and the 4x11 asymmetric circles' grid of opencv
+typedef Board<9, 6, CHESSBOARD> Chessboard9x6;
+typedef Board<4, 11, ASYMMETRIC_CIRCLES_GRID> AsymmetricCircles4x11;
+
+/**
+ * The model of a board whose size and pattern are known at runtime. The
+ * points are generated once and kept by the trackers until the board
+ * changes, from the constexpr model of the Board specialisations of the
+ * project when the size and the pattern match one of them (the points are
+ * the same), with calcChessboardCorners otherwise.
+ */
+class BoardModel
+{
+public:
+
+    BoardModel( ) = default;
+
+    /**
+     * Generate the model of a board
+     *
+     * @param[in] boardSize the number of points per row and column
+     * @param[in] pattern the type of pattern
+     * @param[in] squareSize the size of the squares
+     */
+    BoardModel( const cv::Size &boardSize, Pattern pattern, float squareSize = DEFAULT_SQUARE_SIZE );
+
+    /**
+     * Return true if the model is the one of the given board
+     *
+     * @param[in] boardSize the number of points per row and column
+     * @param[in] pattern the type of pattern
+     * @return true if the size and the pattern are the ones of the model
+     */
+    inline bool matches( const cv::Size &boardSize, Pattern pattern ) const
+    {
+        return !_points3D.empty( ) && _size == boardSize && _pattern == pattern;
+    }
+
+    /**
+     * Return the points of the board on its plane
+     * @return the points, row major
+     */
+    inline const std::vector<cv::Point2f> & getPoints( ) const
+    {
+        return _points;
+    }
+
+    /**
+     * Return the 3D points of the board, on the z = 0 plane
+     * @return the points, row major
+     */
+    inline const std::vector<cv::Point3f> & getPoints3D( ) const
+    {
+        return _points3D;
+    }
+
+    virtual ~BoardModel( ) = default;
+
+private:
+
+    /**
+     * Generate the points from the model of a compile time board
+     *
+     * @param[in] squareSize the size of the squares
+     */
+    template<class BoardT>
+    void generate( float squareSize )
+    {
+        BoardT::objectPoints( squareSize, _points );
+        BoardT::objectPoints3D( squareSize, _points3D );
+    }
+
+    // the size and the pattern of the board
+    cv::Size _size;
+    Pattern _pattern{CHESSBOARD};
+
+    // the points of the board on its plane and in 3D
+    std::vector<cv::Point2f> _points;
+    std::vector<cv::Point3f> _points3D;
+
+};
@@ -1,7 +1,13 @@
 #pragma once
 
+#include "Undistorter.hpp"
+
 #include <opencv2/core/core.hpp>
 
+#include <cstdint>
+#include <memory>
+#include <string>
+
 class Camera
 {
 public:
@@ -9,12 +15,37 @@ public:
     Camera( ) = default;
 
     /**
-     * Initialize the camera loading the internal parameters from the given file
+     * Initialize the camera loading the internal parameters from the given file.
+     * If useCache is true the parameters and the undistortion map are loaded
+     * (memory mapped) from the binary cache calibFilename + ".bin", which is
+     * (re)generated whenever it is missing or the calibration file has changed
      *
      * @param[in] calibFilename the calibration file
+     * @param[in] useCache true to use the binary cache
      * @return true if success
      */
-    bool init( std::string calibFilename );
+    bool init( const std::string &calibFilename, bool useCache = true );
+
+    /**
+     * Return an undistorter for frames of the given size. The one built at
+     * init is returned if the size matches the calibration, otherwise
+     * fallback is (re)initialized if needed and returned
+     *
+     * @param[in] frameSize the size of the frames to undistort
+     * @param[in,out] fallback the undistorter to use if the size does not match the calibration
+     * @return the undistorter to use
+     */
+    const Undistorter & getUndistorter( const cv::Size &frameSize, Undistorter &fallback ) const;
+
+    /**
+     * Return the camera with the intrinsics scaled for frames of a different
+     * resolution (e.g. downscaled frames to process faster). The distortion
+     * coefficients do not depend on the resolution
+     *
+     * @param[in] targetSize the size of the frames of the new camera
+     * @return the scaled camera, its undistortion map is not built
+     */
+    Camera scaled( const cv::Size &targetSize ) const;
 
     virtual ~Camera( ) = default;
 
@@ -36,4 +67,19 @@ public:
 
     cv::Size imageSize;
 
+    // the undistortion map for frames of size imageSize
+    Undistorter undistorter;
+
+private:
+
+    // it loads the parameters and the map from the binary cache, false if the
+    // cache is missing or stale
+    bool loadCache( const std::string &cacheFilename, int64_t calibSize, int64_t calibTime );
+
+    // it writes the parameters and the map to the binary cache
+    bool saveCache( const std::string &cacheFilename, int64_t calibSize, int64_t calibTime ) const;
+
+    // keeps the memory mapped cache alive while the undistorter uses it
+    std::shared_ptr<const void> _cacheData;
+
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ICameraTracker.hpp"
+#include "Undistorter.hpp"
 
 class ChessboardCameraTracker : public ICameraTracker
 {
@@ -23,4 +24,13 @@ public:
 
     virtual ~ChessboardCameraTracker( ) = default;
 
+private:
+
+    // the undistortion map used when the frames do not match the calibration size
+    Undistorter _undistorter;
+
+    // the points detected in the last processed frame, only a hint to order
+    // the circles' grids (the frames may be processed out of order)
+    std::vector<cv::Point2f> _prevCorners;
+
 };
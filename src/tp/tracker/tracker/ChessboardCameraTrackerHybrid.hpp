@@ -0,0 +1,122 @@
+#pragma once
+
+#include "ChessboardCameraTrackerKLT.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * KLT tracker whose drift is corrected by a full detection of the chessboard
+ * running in a background thread.
+ *
+ * Every redetection period frames the current frame is handed to the worker
+ * (if it is idle) and the KLT goes on tracking. When the detection is ready,
+ * the detected corners are brought from the frame they were detected in to
+ * the last processed frame with the optical flow, and they replace the
+ * tracked set at the next frame, so no frame waits for findChessboardCorners
+ * (except the ones where the tracking is completely lost). The worker is
+ * started by the first background detection, so no thread is created while
+ * the redetection period is 0.
+ */
+class ChessboardCameraTrackerHybrid : public ChessboardCameraTrackerKLT
+{
+public:
+
+    /**
+     * Set up the tracker, the background detection worker is started when the first frame is handed to it
+     *
+     * @param[in] redetectionPeriod the number of frames between two background detections, 0 to disable them
+     */
+    explicit ChessboardCameraTrackerHybrid( int redetectionPeriod = 30 );
+
+    ChessboardCameraTrackerHybrid( const ChessboardCameraTrackerHybrid & ) = delete;
+    ChessboardCameraTrackerHybrid & operator=( const ChessboardCameraTrackerHybrid & ) = delete;
+
+    /**
+     * It tracks the chessboard with the KLT, merging the background detections
+     *
+     * @param[in,out] input the original image
+     * @param[out] pose the pose of the camera
+     * @param[in] cam the camera
+     * @param[in] boardSize the size of the chessboard to detect
+     * @param[in] patt the type of pattern to detect
+     * @return true if the chessboard has been found
+     */
+    bool process( cv::Mat &input, cv::Mat &pose, const Camera & cam, const cv::Size &boardSize, const Pattern &patt );
+
+    /**
+     * Set the number of frames between two background detections
+     * @param[in] redetectionPeriod the period in frames, 0 to disable the background detection
+     */
+    inline void setRedetectionPeriod( int redetectionPeriod )
+    {
+        _redetectionPeriod = redetectionPeriod;
+    }
+
+    /**
+     * Return the number of frames between two background detections
+     * @return the period in frames, 0 if the background detection is disabled
+     */
+    inline int getRedetectionPeriod( ) const
+    {
+        return _redetectionPeriod;
+    }
+
+    /**
+     * Return true if a background detection has been merged in the last frame
+     * @return true if the tracked corners come from a fresh detection
+     */
+    inline bool getMergedDetection( ) const
+    {
+        return _mergedDetection;
+    }
+
+    /**
+     * Stop and join the background detection worker
+     */
+    virtual ~ChessboardCameraTrackerHybrid( );
+
+private:
+
+    // the loop of the background worker
+    void detectionLoop( );
+
+    // it replaces the tracked corners with the ones of a finished detection
+    void mergeDetection( );
+
+    // the number of frames between two background detections
+    int _redetectionPeriod;
+    // the number of frames processed since the last submission
+    int _framesSinceSubmission{0};
+    // true if a detection has been merged in the last frame
+    bool _mergedDetection{false};
+
+    // protects the state shared with the worker
+    std::mutex _mutex;
+    // signals a new job to the worker
+    std::condition_variable _jobReady;
+    // true if the worker has to exit
+    bool _stop{false};
+    // true while the worker owns a job (from the submission to the merge)
+    bool _busy{false};
+    // true if the worker has a new job to process
+    bool _hasJob{false};
+    // true if the result of the job is ready to be merged
+    bool _hasResult{false};
+
+    // the job: the grey frame, the board to detect, the detector to use and
+    // the tracked corners in the order of the board (empty if some are lost)
+    cv::Mat _jobGrey;
+    cv::Size _jobBoardSize;
+    Pattern _jobPattern{CHESSBOARD};
+    ChessboardDetector _jobDetector{DETECTOR_OPENCV};
+    std::vector<cv::Point2f> _jobLayout;
+    // the result: the corners detected in _jobGrey
+    bool _jobFound{false};
+    std::vector<cv::Point2f> _jobCorners;
+
+    // the background worker, started by the first job
+    std::thread _worker;
+
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "ICameraTracker.hpp"
+#include "PosePredictor.hpp"
+#include "Undistorter.hpp"
 
 class ChessboardCameraTrackerKLT : public ICameraTracker
 {
@@ -21,15 +23,180 @@ public:
      */
     bool process( cv::Mat &input, cv::Mat &pose, const Camera & cam, const cv::Size &boardSize, const Pattern &patt );
 
+    /**
+     * Return the pose predicted for the last processed frame by the constant
+     * velocity model, it is empty if no prediction was available
+     * @return the predicted 3x4 pose matrix [R t]
+     */
+    inline const cv::Mat & getPredictedPose( ) const
+    {
+        return _predictedPose;
+    }
+
+    /**
+     * Extrapolate the pose after the given number of frames from the last
+     * processed one, e.g. to compensate the latency of the rendering
+     *
+     * @param[out] pose the predicted 3x4 pose matrix [R t]
+     * @param[in] framesAhead the number of frames after the last processed one (it can be fractional)
+     * @return true if the pose could be predicted
+     */
+    inline bool predictPose( cv::Mat &pose, float framesAhead ) const
+    {
+        return _predictor.predict( pose, framesAhead );
+    }
+
+    /**
+     * Return how the pose of the last processed frame has been estimated
+     * @return the PnP path taken for the last frame
+     */
+    inline PnPPath getLastPnPPath( ) const
+    {
+        return _lastPnPPath;
+    }
+
+    /**
+     * Return the number of lost corners that have been recovered in the last frame
+     * @return the number of corners re-inserted by reprojection
+     */
+    inline size_t getNumReseeded( ) const
+    {
+        return _numReseeded;
+    }
+
+    /**
+     * Set the motion gate: when all the tracked corners are less than
+     * maxMotion pixels away from where they were when the pose was last
+     * estimated (and, if maxFrameDifference > 0, the thumbnail of the frame
+     * differs from the previous one by less than maxFrameDifference grey
+     * levels everywhere) the frame is marked static and the previous pose is
+     * reused without PnP
+     * @param[in] maxMotion the maximum displacement in pixels of the corners, 0 to disable the gate
+     * @param[in] maxFrameDifference the maximum grey level difference of the thumbnails, 0 to not check it
+     */
+    inline void setStaticGate( float maxMotion, float maxFrameDifference = 0.f )
+    {
+        _staticMaxMotion = maxMotion;
+        _staticMaxFrameDifference = maxFrameDifference;
+    }
+
+    /**
+     * Return true if the frame difference check of the motion gate is
+     * enabled and found the last frame unchanged wrt the previous one, so
+     * that the image itself (not only the pose) can be reused downstream
+     * @return true if the whole last frame is unchanged
+     */
+    inline bool isFrameUnchanged( ) const
+    {
+        return _frameUnchanged;
+    }
+
+    /**
+     * Set how long the last pose before a loss of the tracking is used to
+     * re-acquire the visible part of the board (e.g. when a hand covers it).
+     * Meanwhile the full detections, which fail until the whole board is
+     * visible again, are run less and less often
+     * @param[in] maxAnchorAge the maximum number of frames since the loss, 0 to disable the partial re-acquisition
+     */
+    inline void setPartialReacquisition( int maxAnchorAge )
+    {
+        _maxAnchorAge = maxAnchorAge;
+        if( maxAnchorAge <= 0 )
+            _anchorPose.release( );
+    }
+
+    /**
+     * Return true if the board of the last processed frame has been
+     * re-acquired from its visible part only
+     * @return true if the last frame has been recovered by a partial detection
+     */
+    inline bool isPartial( ) const
+    {
+        return _partial;
+    }
+
     virtual ~ChessboardCameraTrackerKLT( ) = default;
 
-private:
+protected:
+
+    /**
+     * Recover the corners lost by the KLT: the missing corners of the board
+     * model are projected with the current pose, refined with cornerSubPix and
+     * re-inserted in the tracked set if they pass a local check
+     *
+     * @param[in] grey the current grey level frame
+     * @param[in] pose the pose of the current frame
+     * @param[in] cam the camera
+     * @param[in] distCoeff the distortion coefficients to use for the projection
+     */
+    void reseedLostCorners( const cv::Mat &grey, const cv::Mat &pose, const Camera &cam, const cv::Mat &distCoeff );
+
+    /**
+     * Store the position of the tracked corners for the pose just estimated,
+     * the motion gate measures the displacement of the corners from them
+     */
+    void rememberPoseCorners( );
+
+    /**
+     * Re-acquire the visible part of an occluded board: the corners of the model
+     * are searched around their projection with the anchor pose (the last one
+     * before the tracking was lost), and the consistent ones become the tracked
+     * set. The corners hidden so far are recovered later by reseedLostCorners
+     *
+     * @param[in] grey the current grey level frame
+     * @param[out] pose the pose of the camera
+     * @param[in] cam the camera
+     * @param[in] distCoeff the distortion coefficients to use for the pose estimation
+     * @param[in] boardSize the size of the chessboard
+     * @param[in] pattern the type of pattern
+     * @return true if enough corners have been found
+     */
+    bool reacquirePartialBoard( const cv::Mat &grey, cv::Mat &pose, const Camera &cam, const cv::Mat &distCoeff,
+                                const cv::Size &boardSize, Pattern pattern );
 
     // contains the 2D corners detected in the last frame that needs to be tracked
     std::vector<cv::Point2f> _corners;
     // contains the 3D points of the chessboard
     std::vector<cv::Point3f> _objectPoints;
+    // the index in the board model of each tracked corner
+    std::vector<int> _cornerIds;
+    // all the 3D points of the board (the model)
+    std::vector<cv::Point3f> _boardPoints;
+    // the number of corners recovered in the last frame
+    size_t _numReseeded{0};
+    // the motion gate thresholds (pixels and grey levels)
+    float _staticMaxMotion{0.25f};
+    float _staticMaxFrameDifference{0.f};
+    // the thumbnail of the previous frame for the motion gate
+    cv::Mat _prevThumbnail{};
+    // true if the frame difference check found the last frame unchanged
+    bool _frameUnchanged{false};
+    // the position of each corner of the model when the pose was last
+    // estimated, and whether it was tracked then
+    std::vector<cv::Point2f> _poseCorners;
+    std::vector<bool> _poseCornerValid;
     // the previous frame
     cv::Mat _prevGrey{};
+    // the undistortion map used when the frames do not match the calibration size
+    Undistorter _undistorter;
+    // the constant velocity model used to predict the position of the corners
+    PosePredictor _predictor;
+    // the pose predicted for the last frame
+    cv::Mat _predictedPose{};
+    // the pose estimated for the last frame
+    cv::Mat _lastPose{};
+    // how the pose of the last frame has been estimated
+    PnPPath _lastPnPPath{PNP_NONE};
+    // the last pose before the tracking was lost, and the number of frames since then
+    cv::Mat _anchorPose{};
+    int _anchorAge{0};
+    // the maximum age of the anchor pose, 0 to disable the partial re-acquisition
+    int _maxAnchorAge{30};
+    // the current interval between two full detections while the board is occluded,
+    // and the number of frames before the next one
+    int _detectionBackoff{0};
+    int _framesToDetection{0};
+    // true if the last frame has been recovered by a partial detection
+    bool _partial{false};
 
 };
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+#include <vector>
+
+/**
+ * Detect the dark circular blobs of a circles' grid with a single pass:
+ * adaptive threshold, outer contours of the connected components, and the
+ * centre of each blob from its moments. Under perspective the centroid of
+ * the ellipse is not exactly the projection of the centre of the circle, but
+ * the bias is small at the tracking distance. The blobs too small, not
+ * circular or too elongated are discarded.
+ *
+ * @param[in] image the image to process, grey level or BGR
+ * @param[out] blobs the blobs, with their centre and diameter
+ */
+void detectCircleBlobs( const cv::Mat &image, std::vector<cv::KeyPoint> &blobs );
+
+/**
+ * Find a circles' grid with the blobs of detectCircleBlobs instead of the
+ * multi threshold sweep of opencv's SimpleBlobDetector.
+ *
+ * When the centres of the grid in the previous frame are given, the blobs
+ * are first matched to them (after compensating the median motion of the
+ * grid): if every centre gets its own blob the previous order is kept and
+ * the grid is not searched again. Otherwise the blobs are given to
+ * findCirclesGrid to order them.
+ *
+ * @param[in] image the image to process, grey level or BGR
+ * @param[in] patternSize the number of circles per row and column
+ * @param[out] centres the centres of the circles, in the same order as findCirclesGrid
+ * @param[in] asymmetric true for an asymmetric grid
+ * @param[in] previousLayout the centres found in the previous frame, empty if there are none
+ * @return true if the whole grid has been found
+ */
+bool findCirclesGridFast( const cv::Mat &image, const cv::Size &patternSize, std::vector<cv::Point2f> &centres, bool asymmetric,
+                          const std::vector<cv::Point2f> &previousLayout = std::vector<cv::Point2f>( ) );
+
+/**
+ * Adapter giving a fixed set of blobs to findCirclesGrid in place of its
+ * blob detector, so that the blobs are detected only once
+ */
+class PrecomputedBlobDetector : public cv::FeatureDetector
+{
+public:
+
+    /**
+     * @param[in] blobs the blobs returned by the detection
+     */
+    explicit PrecomputedBlobDetector( const std::vector<cv::KeyPoint> &blobs ) : _blobs( blobs ) { }
+
+#if CV_MAJOR_VERSION < 3
+protected:
+
+    void detectImpl( const cv::Mat &image, std::vector<cv::KeyPoint> &keypoints, const cv::Mat &mask = cv::Mat( ) ) const
+    {
+        keypoints = _blobs;
+    }
+#else
+    void detect( cv::InputArray image, std::vector<cv::KeyPoint> &keypoints, cv::InputArray mask = cv::noArray( ) ) override
+    {
+        keypoints = _blobs;
+    }
+#endif
+
+private:
+
+    const std::vector<cv::KeyPoint> _blobs;
+};
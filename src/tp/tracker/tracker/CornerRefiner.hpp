@@ -0,0 +1,25 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+/**
+ * Refine the position of the corners to subpixel accuracy, a drop-in
+ * replacement of opencv's cornerSubPix (without zero zone) with the same
+ * window and termination semantics.
+ *
+ * The corners are refined in batches of 4, one per SIMD lane: the patches
+ * around the corners are sampled in structure of arrays layout, so that the
+ * gradients and the normal equations of the 4 corners are computed together
+ * with SSE2 or NEON. The batch stops iterating when all its corners have
+ * converged. The kernel is specialised for the windows used in the project
+ * (half sizes 2, 3, 5 and 11), the other windows and the non 8 bit images
+ * fall back to cornerSubPix.
+ *
+ * @param[in] grey the grey level image
+ * @param[in,out] corners the initial corners, refined on output
+ * @param[in] winSize half of the side length of the search window, as in cornerSubPix
+ * @param[in] criteria the termination criteria (number of iterations and/or minimum displacement)
+ */
+void refineCornersSubPix( const cv::Mat &grey, std::vector<cv::Point2f> &corners, const cv::Size &winSize, const cv::TermCriteria &criteria );
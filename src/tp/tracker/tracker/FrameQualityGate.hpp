@@ -0,0 +1,142 @@
+#pragma once
+
+#include "utility.hpp"
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Cheap check of a frame before the full detection of the pattern.
+ *
+ * The frame is reduced to a small thumbnail on which the sharpness (variance
+ * of the laplacian) and the contrast (standard deviation of the grey levels)
+ * are measured, and a quick presence check of the pattern is run (the check
+ * of opencv's CALIB_CB_FAST_CHECK for the chessboards, the count of the
+ * circular blobs for the circles' grids).
+ *
+ * The blurred and the flat frames are skipped, the detection would fail on
+ * them anyway. The frames failing the presence check are only deferred: at
+ * most a given number of consecutive frames is rejected for this reason, so
+ * that a board too small to be seen on the thumbnail is still detected,
+ * just less often.
+ */
+class FrameQualityGate
+{
+public:
+
+    // the outcome of the evaluation of a frame
+    enum Verdict { GATE_PASSED = 0, GATE_BLURRED, GATE_LOW_CONTRAST, GATE_NO_BOARD, GATE_NUM_VERDICTS };
+
+    FrameQualityGate( ) = default;
+
+    /**
+     * Evaluate a frame before the detection of the pattern
+     *
+     * @param[in] grey the grey level frame
+     * @param[in] boardSize the size of the pattern to detect
+     * @param[in] pattern the type of pattern to detect
+     * @return GATE_PASSED if the detection should run on the frame, the reason of the rejection otherwise
+     */
+    Verdict evaluate( const cv::Mat &grey, const cv::Size &boardSize, Pattern pattern );
+
+    /**
+     * Set the minimum variance of the laplacian of the thumbnail, 0 to disable the sharpness check
+     * @param[in] minSharpness the minimum sharpness
+     */
+    inline void setMinSharpness( double minSharpness )
+    {
+        _minSharpness = minSharpness;
+    }
+
+    /**
+     * Set the minimum standard deviation of the grey levels of the thumbnail, 0 to disable the contrast check
+     * @param[in] minContrast the minimum contrast
+     */
+    inline void setMinContrast( double minContrast )
+    {
+        _minContrast = minContrast;
+    }
+
+    /**
+     * Set the maximum number of consecutive frames deferred by the presence
+     * check, 0 to disable the presence check
+     * @param[in] maxDeferred the maximum number of consecutive deferred frames
+     */
+    inline void setMaxDeferred( int maxDeferred )
+    {
+        _maxDeferred = maxDeferred;
+    }
+
+    /**
+     * Return the sharpness of the last evaluated frame
+     * @return the variance of the laplacian of the thumbnail
+     */
+    inline double getLastSharpness( ) const
+    {
+        return _lastSharpness;
+    }
+
+    /**
+     * Return the contrast of the last evaluated frame
+     * @return the standard deviation of the grey levels of the thumbnail
+     */
+    inline double getLastContrast( ) const
+    {
+        return _lastContrast;
+    }
+
+    /**
+     * Return the number of frames evaluated since the last reset of the counters
+     * @return the number of evaluated frames
+     */
+    inline int getNumEvaluated( ) const
+    {
+        return _numEvaluated;
+    }
+
+    /**
+     * Return the number of frames rejected since the last reset of the counters
+     * @return the number of rejected frames, whatever the reason
+     */
+    inline int getNumRejected( ) const
+    {
+        return _numEvaluated - _numVerdicts[GATE_PASSED];
+    }
+
+    /**
+     * Return the number of frames with a given verdict since the last reset of the counters
+     * @param[in] verdict the verdict
+     * @return the number of frames
+     */
+    inline int getNumRejected( Verdict verdict ) const
+    {
+        return _numVerdicts[verdict];
+    }
+
+    /**
+     * Reset the counters of the evaluated and rejected frames
+     */
+    void resetCounters( );
+
+    virtual ~FrameQualityGate( ) = default;
+
+private:
+
+    // the minimum variance of the laplacian of the thumbnail
+    double _minSharpness{10.0};
+    // the minimum standard deviation of the grey levels of the thumbnail
+    double _minContrast{8.0};
+    // the maximum number of consecutive frames deferred by the presence check
+    int _maxDeferred{4};
+
+    // the number of consecutive frames deferred so far
+    int _numDeferred{0};
+
+    // the measures of the last evaluated frame
+    double _lastSharpness{0};
+    double _lastContrast{0};
+
+    // the counters of the evaluated frames and of each verdict
+    int _numEvaluated{0};
+    int _numVerdicts[GATE_NUM_VERDICTS]{};
+
+};
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "BoardModel.hpp"
 #include "Camera.hpp"
+#include "FrameQualityGate.hpp"
 #include "utility.hpp"
 
 class ICameraTracker
@@ -38,14 +40,269 @@ public:
         return _currPose;
     }
 
+    /**
+     * Choose whether the tracker works on the undistorted frames (the default)
+     * or directly on the distorted ones. In the latter case the input image is
+     * left untouched, only the detected corners are undistorted, and the
+     * reference system must be drawn taking the distortion into account.
+     * @param[in] undistortFrame true to undistort the whole frame
+     */
+    inline void setUndistortFrame( bool undistortFrame )
+    {
+        _undistortFrame = undistortFrame;
+    }
+
+    /**
+     * Return true if the tracker undistorts the whole frame
+     * @return true if the input image is undistorted by process
+     */
+    inline bool getUndistortFrame( ) const
+    {
+        return _undistortFrame;
+    }
+
+    /**
+     * Set the scale of the frames the detection and the tracking work on, e.g.
+     * 0.5 to process frames with half the width and height. The input image
+     * keeps its resolution and the poses are the same as at full resolution,
+     * since only the intrinsics depend on the resolution
+     * @param[in] scale the processing scale in (0, 1], 1 to process the frames at full resolution
+     */
+    inline void setProcessingScale( double scale )
+    {
+        _processingScale = scale;
+    }
+
+    /**
+     * Return the scale of the frames the detection and the tracking work on
+     * @return the processing scale
+     */
+    inline double getProcessingScale( ) const
+    {
+        return _processingScale;
+    }
+
+    /**
+     * Choose the detector of the CHESSBOARD pattern used for the full
+     * detections, see detectChessboard
+     * @param[in] detector the detector
+     */
+    inline void setChessboardDetector( ChessboardDetector detector )
+    {
+        _detector = detector;
+    }
+
+    /**
+     * Return the detector of the CHESSBOARD pattern used for the full detections
+     * @return the detector
+     */
+    inline ChessboardDetector getChessboardDetector( ) const
+    {
+        return _detector;
+    }
+
+    /**
+     * Search the CHESSBOARD by tiles in the full detections, for high
+     * resolution frames where the board is small, see findChessboardTiled
+     * @param[in] expectedBoardSide the expected side in pixels of the board in the input frames, 0 to search the whole frame at once
+     */
+    inline void setTiledSearch( int expectedBoardSide )
+    {
+        _tiledBoardSide = expectedBoardSide;
+    }
+
+    /**
+     * Return the expected side of the board used by the tiled search
+     * @return the expected side in pixels, 0 if the whole frame is searched at once
+     */
+    inline int getTiledSearch( ) const
+    {
+        return _tiledBoardSide;
+    }
+
+    /**
+     * Return true if the last processed frame has been found static (no
+     * motion wrt the previous one), in that case the pose is the previous
+     * one and the downstream stages (texture upload, rendering, logging) can
+     * skip their work too
+     * @return true if the last frame is static
+     */
+    inline bool isStatic( ) const
+    {
+        return _static;
+    }
+
+    /**
+     * Enable the quality gate run before the full detections: the frames it
+     * rejects are not searched for the pattern, see FrameQualityGate
+     * @param[in] enable true to enable the gate
+     */
+    inline void setQualityGateEnabled( bool enable )
+    {
+        _gateEnabled = enable;
+    }
+
+    /**
+     * Return true if the quality gate runs before the full detections
+     * @return true if the gate is enabled
+     */
+    inline bool isQualityGateEnabled( ) const
+    {
+        return _gateEnabled;
+    }
+
+    /**
+     * Return the quality gate, to tune its thresholds or read its counters
+     * @return the quality gate
+     */
+    inline FrameQualityGate & getQualityGate( )
+    {
+        return _gate;
+    }
+
+    /**
+     * Return the quality gate, to read its counters
+     * @return the quality gate
+     */
+    inline const FrameQualityGate & getQualityGate( ) const
+    {
+        return _gate;
+    }
+
+    /**
+     * Return true if the full detection has been skipped on the last
+     * processed frame because the quality gate rejected it
+     * @return true if the last frame has been rejected by the gate
+     */
+    inline bool isGateRejected( ) const
+    {
+        return _gateRejected;
+    }
+
+    /**
+     * Choose whether the tracker prints its progress on the standard output
+     * (the default). The trackers running on the workers of a thread pool
+     * should not: their messages would interleave and each frame would wait
+     * for the others on the stream
+     * @param[in] verbose true to print the progress
+     */
+    inline void setVerbose( bool verbose )
+    {
+        _verbose = verbose;
+    }
+
+    /**
+     * Return true if the tracker prints its progress on the standard output
+     * @return true if the tracker is verbose
+     */
+    inline bool isVerbose( ) const
+    {
+        return _verbose;
+    }
+
+    virtual ~ICameraTracker( ) = default;
+
 
 protected:
 
+    /**
+     * Downscale the grey frame to the processing scale, returning the camera
+     * to use with the downscaled frame (cam itself at full resolution)
+     *
+     * @param[in] cam the camera of the full resolution frames
+     * @param[in,out] grey the grey level frame, downscaled on output
+     * @return the camera matching the resolution of grey
+     */
+    const Camera & prepareProcessingFrame( const Camera &cam, cv::Mat &grey );
+
+    /**
+     * Run the quality gate, if enabled, before a full detection
+     *
+     * @param[in] grey the grey level frame the detection would run on
+     * @param[in] boardSize the size of the pattern to detect
+     * @param[in] pattern the type of pattern to detect
+     * @return true if the detection should run on the frame
+     */
+    bool passQualityGate( const cv::Mat &grey, const cv::Size &boardSize, Pattern pattern );
+
+    /**
+     * Return the expected side of the board at the processing scale, for the tiled search
+     * @return the expected side in pixels, 0 if the tiled search is disabled
+     */
+    inline int getProcessingTiledBoardSide( ) const
+    {
+        if( _processingScale >= 1.0 || _processingScale <= 0.0 )
+            return _tiledBoardSide;
+        return cvRound( _tiledBoardSide * _processingScale );
+    }
+
+    /**
+     * Return the model of the board, generated only when the size or the
+     * pattern change
+     *
+     * @param[in] boardSize the size of the board
+     * @param[in] pattern the type of pattern
+     * @return the model of the board
+     */
+    const BoardModel & getBoardModel( const cv::Size &boardSize, Pattern pattern );
 
     /**
      4x4 rototranslation matrix for the camera position
      */
     cv::Mat _currPose;
 
+    /**
+     true if the whole frame is undistorted before processing it
+     */
+    bool _undistortFrame{true};
+
+    /**
+     the scale of the frames the detection and the tracking work on
+     */
+    double _processingScale{1.0};
+
+    /**
+     the detector of the CHESSBOARD pattern
+     */
+    ChessboardDetector _detector{DETECTOR_OPENCV};
+
+    /**
+     the expected side of the board in the input frames for the tiled search, 0 to disable it
+     */
+    int _tiledBoardSide{0};
+
+    /**
+     true if the last processed frame is static
+     */
+    bool _static{false};
+
+    /**
+     the quality gate of the full detections, and whether it is enabled
+     */
+    FrameQualityGate _gate;
+    bool _gateEnabled{false};
+
+    /**
+     true if the gate rejected the last processed frame
+     */
+    bool _gateRejected{false};
+
+    /**
+     true if the progress is printed on the standard output
+     */
+    bool _verbose{true};
+
+    /**
+     the model of the last board processed
+     */
+    BoardModel _board;
+
+    /**
+     the camera scaled to the processing resolution, and the camera and size it comes from
+     */
+    Camera _scaledCam;
+    const Camera *_scaledCamSource{nullptr};
+    cv::Size _scaledCamFrameSize;
+
 
 };
\ No newline at end of file
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "BoardModel.hpp"
+#include "ICameraTracker.hpp"
+#include "Undistorter.hpp"
+
+#include <vector>
+
+/**
+ * The description of one of the boards tracked by a MultiBoardTracker
+ */
+struct BoardDescriptor
+{
+    BoardDescriptor( ) = default;
+
+    /**
+     * @param[in] size the number of points per row and column
+     * @param[in] pattern the type of pattern
+     */
+    BoardDescriptor( const cv::Size &size, Pattern pattern ) : boardSize( size ), pattern( pattern ) { }
+
+    // the number of points per row and column
+    cv::Size boardSize;
+    // the type of pattern
+    Pattern pattern{CHESSBOARD};
+};
+
+/**
+ * The result of the tracking of one board in a frame
+ */
+struct BoardPose
+{
+    // true if the board has been found
+    bool found{false};
+    // the 3x4 pose matrix [R t] of the camera wrt the board
+    cv::Mat pose;
+    // the number of corners the pose has been estimated from
+    size_t numCorners{0};
+};
+
+/**
+ * Track several boards in the same frames with the KLT.
+ *
+ * The work that only depends on the frame is done once for all the boards:
+ * the undistortion and the grey level conversion, and the image pyramid of
+ * the optical flow, which is kept as the previous pyramid of the next frame.
+ * The corners of all the tracked boards are tracked by a single
+ * calcOpticalFlowPyrLK call, then the pose of each board is estimated from
+ * its own corners, and its lost corners are recovered by reprojection.
+ *
+ * The boards that are not tracked are detected with detectChessboard, on
+ * the frame where the boards already tracked are masked, so that several
+ * boards of the same size are detected one after the other (their order is
+ * then the order of the detection).
+ */
+class MultiBoardTracker : public ICameraTracker
+{
+public:
+
+    MultiBoardTracker( ) = default;
+
+    /**
+     * Set the boards to track, the tracking starts again from scratch
+     *
+     * @param[in] boards the descriptors of the boards
+     */
+    void setBoards( const std::vector<BoardDescriptor> &boards );
+
+    /**
+     * Return the boards tracked
+     * @return the descriptors of the boards
+     */
+    inline const std::vector<BoardDescriptor> & getBoards( ) const
+    {
+        return _boards;
+    }
+
+    /**
+     * Detect and track all the boards in a frame
+     *
+     * @param[in,out] view the original image, undistorted on output unless the tracker works on the distorted frames
+     * @param[in] cam the camera
+     * @param[out] poses the result for each board, in the order of setBoards
+     * @return true if at least one board has been found
+     */
+    bool processBoards( cv::Mat &view, const Camera &cam, std::vector<BoardPose> &poses );
+
+    /**
+     * Track a single board: the tracked boards are replaced by this one if
+     * they are different
+     *
+     * @param[in,out] view the original image
+     * @param[out] pose the pose of the camera
+     * @param[in] cam the camera
+     * @param[in] boardSize the size of the chessboard to detect
+     * @param[in] pattern the type of pattern to detect
+     * @return true if the chessboard has been found
+     */
+    bool process( cv::Mat &view, cv::Mat &pose, const Camera &cam, const cv::Size &boardSize, const Pattern &pattern );
+
+    virtual ~MultiBoardTracker( ) = default;
+
+private:
+
+    // the state of the tracking of a board
+    struct BoardTrack
+    {
+        // the model of the board
+        BoardModel model;
+        // the tracked corners, their 3D points and their index in the model
+        std::vector<cv::Point2f> corners;
+        std::vector<cv::Point3f> objectPoints;
+        std::vector<int> cornerIds;
+        // the pose of the last frame, empty if the board is not tracked
+        cv::Mat lastPose;
+    };
+
+    /**
+     * Detect the boards that are not tracked
+     *
+     * @param[in] grey the grey level frame
+     * @param[in] cam the camera
+     * @param[in] distCoeff the distortion coefficients to use for the pose estimation
+     * @param[in,out] poses the result for each board
+     */
+    void detectLostBoards( const cv::Mat &grey, const Camera &cam, const cv::Mat &distCoeff, std::vector<BoardPose> &poses );
+
+    // the boards to track and their tracking state
+    std::vector<BoardDescriptor> _boards;
+    std::vector<BoardTrack> _tracks;
+
+    // the pyramid of the previous frame
+    std::vector<cv::Mat> _prevPyramid;
+    cv::Size _prevSize;
+
+    // the undistortion map used when the frames do not match the calibration size
+    Undistorter _undistorter;
+
+};
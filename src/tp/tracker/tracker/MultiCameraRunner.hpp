@@ -0,0 +1,222 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "ICameraTracker.hpp"
+#include "ThreadPool.hpp"
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * The pose estimated for a frame of one of the cameras of a MultiCameraRunner
+ */
+struct CameraPose
+{
+    // the index of the camera, in the order of addCamera
+    int camera{0};
+    // the index of the frame in the stream of its camera
+    int64_t frame{0};
+    // the timestamp of the frame in milliseconds
+    double timestamp{0};
+    // true if the chessboard has been found
+    bool found{false};
+    // true if the quality gate of the tracker rejected the frame before the detection
+    bool gateRejected{false};
+    // the 3x4 pose matrix [R t], empty if not found
+    cv::Mat pose;
+};
+
+/**
+ * The counters of a camera of a MultiCameraRunner
+ */
+struct CameraStats
+{
+    // the frames read from the source
+    int64_t captured{0};
+    // the frames processed by the tracker
+    int64_t processed{0};
+    // the frames dropped because the frame pool of the camera was full
+    int64_t dropped{0};
+    // the frames where the chessboard has been found
+    int64_t found{0};
+};
+
+/**
+ * Track a chessboard in several video sources at the same time (e.g. the
+ * cameras of a rig), each with its own calibration and its own tracker,
+ * merging the poses in a single stream ordered by timestamp.
+ *
+ * Each camera has a capture thread copying its frames in its own pool of
+ * buffers: the frames of a camera in flight (read, being tracked or waiting
+ * to be merged) are bounded by the size of its pool. When the pool is full,
+ * the capture of a video file waits, while a live source (a device index or
+ * a stream url) drops its oldest frame not yet tracked, so that a slow
+ * camera only loses its own frames.
+ *
+ * The trackers run on a thread pool shared by all the cameras. A camera has
+ * at most one task in the pool, since its tracker works on consecutive
+ * frames: a task tracks one frame and submits itself again at the back of
+ * the queue if other frames are waiting, so the workers serve the cameras in
+ * turn and a slow camera never holds more than one worker.
+ *
+ * The frames of a video file are stamped with their position in the video,
+ * those of a live source with the time they are read on a clock common to
+ * all the cameras, so the two kinds of sources should not be mixed. A pose
+ * is returned by next once no camera can produce an earlier one.
+ */
+class MultiCameraRunner
+{
+public:
+
+    // it creates the tracker of a camera
+    typedef std::function<std::unique_ptr<ICameraTracker>( )> TrackerFactory;
+
+    /**
+     * Set up the runner, the cameras are added with addCamera
+     *
+     * @param[in] factory the function creating a tracker for each camera
+     * @param[in] boardSize the size of the chessboard to detect
+     * @param[in] pattern the type of pattern to detect
+     * @param[in] numWorkers the number of tracking threads shared by all the cameras
+     * @param[in] framesPerCamera the size of the frame pool of each camera
+     * @param[in] workerInit the function each tracking thread calls when it starts (see ThreadBudget::workerInit), may be empty
+     */
+    MultiCameraRunner( const TrackerFactory &factory, const cv::Size &boardSize, Pattern pattern,
+                       int numWorkers, size_t framesPerCamera = 4, const ThreadPool::WorkerInit &workerInit = ThreadPool::WorkerInit( ) );
+
+    MultiCameraRunner( const MultiCameraRunner & ) = delete;
+    MultiCameraRunner & operator=( const MultiCameraRunner & ) = delete;
+
+    /**
+     * Open a source and load its calibration, before start
+     *
+     * @param[in] source the video file, the stream url or the index of the device to read
+     * @param[in] calibFilename the calibration file of the camera
+     * @return the index of the camera, -1 if the source or the calibration could not be opened
+     */
+    int addCamera( const std::string &source, const std::string &calibFilename );
+
+    /**
+     * Return the number of cameras
+     * @return the number of cameras
+     */
+    inline int getNumCameras( ) const
+    {
+        return ( int ) _cameras.size( );
+    }
+
+    /**
+     * Start the capture of all the cameras
+     */
+    void start( );
+
+    /**
+     * Wait for the next pose of the merged stream
+     *
+     * @param[out] result the pose with the smallest timestamp not yet returned
+     * @return false when all the sources are over (or the runner is stopped) and all their poses returned
+     */
+    bool next( CameraPose &result );
+
+    /**
+     * Stop the capture, the frames not yet tracked are discarded
+     */
+    void stop( );
+
+    /**
+     * Return the counters of a camera
+     *
+     * @param[in] camera the index of the camera
+     * @return a copy of its counters
+     */
+    CameraStats getStats( int camera ) const;
+
+    /**
+     * Stop the capture and wait for the trackers
+     */
+    virtual ~MultiCameraRunner( );
+
+private:
+
+    // a frame of a camera from its capture to its merge
+    struct FrameEntry
+    {
+        int64_t frame{0};
+        double timestamp{0};
+        // the buffer of the pool holding the frame, -1 once tracked
+        int slot{-1};
+        bool processing{false};
+        bool done{false};
+        CameraPose result;
+    };
+
+    // a source with its pipeline
+    struct CameraPipeline
+    {
+        int index{0};
+        cv::VideoCapture capture;
+        bool live{false};
+        Camera cam;
+        std::unique_ptr<ICameraTracker> tracker;
+        std::thread captureThread;
+
+        // the frame pool: the buffers and the indices of those not in use
+        std::vector<cv::Mat> slots;
+        std::vector<int> freeSlots;
+        // the frames in flight, in capture order
+        std::deque<FrameEntry> frames;
+        // true while a task of the camera is in the thread pool
+        bool scheduled{false};
+        // true when the source is over
+        bool finished{false};
+        // the timestamp of the last frame read
+        double lastTimestamp{0};
+        CameraStats stats;
+    };
+
+    // it reads the frames of a camera until its source is over
+    void captureLoop( CameraPipeline &pipe );
+
+    // it tracks the oldest frame of a camera not yet tracked
+    void trackNext( CameraPipeline &pipe );
+
+    // it returns the smallest timestamp the camera can still produce
+    double watermark( const CameraPipeline &pipe ) const;
+
+    // the milliseconds elapsed since the construction, the clock of the live sources
+    double now( ) const;
+
+    TrackerFactory _factory;
+    ThreadPool::WorkerInit _workerInit;
+    const cv::Size _boardSize;
+    const Pattern _pattern;
+    const int _numWorkers;
+    const size_t _framesPerCamera;
+
+    std::vector<std::unique_ptr<CameraPipeline> > _cameras;
+    std::chrono::steady_clock::time_point _startTime;
+
+    // true once stop has been called
+    bool _stopping{false};
+
+    // protects the frame pools, the frames in flight and the counters of all the cameras
+    mutable std::mutex _mutex;
+    // signals a frame tracked or read, or the end of a source
+    std::condition_variable _resultReady;
+    // signals a buffer returned to a frame pool
+    std::condition_variable _slotFree;
+
+    // the tracking threads, created by start
+    std::unique_ptr<ThreadPool> _pool;
+
+};
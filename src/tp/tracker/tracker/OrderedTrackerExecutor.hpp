@@ -0,0 +1,134 @@
+#pragma once
+
+#include "ICameraTracker.hpp"
+#include "ThreadPool.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/**
+ * The result of the processing of a frame
+ */
+struct TrackedFrame
+{
+    // the index of the frame in the submission order
+    int64_t index{0};
+    // the frame as modified by the tracker (e.g. undistorted)
+    cv::Mat view;
+    // the 3x4 pose matrix [R t]
+    cv::Mat pose;
+    // true if the chessboard has been found
+    bool found{false};
+    // true if the quality gate of the tracker rejected the frame before the detection
+    bool gateRejected{false};
+};
+
+/**
+ * Process independent frames in parallel with a set of stateless trackers
+ * (e.g. ChessboardCameraTracker), returning the results in the order the
+ * frames have been submitted.
+ *
+ * Each worker thread owns a tracker. The results that are ready before the
+ * ones of the previous frames wait in a reorder buffer, whose size is bounded
+ * by the maximum number of frames in flight: submit blocks when the bound is
+ * reached until next is called. With several workers the trackers do not
+ * print their progress (see ICameraTracker::setVerbose).
+ */
+class OrderedTrackerExecutor
+{
+public:
+
+    // it creates a tracker for a worker
+    typedef std::function<std::unique_ptr<ICameraTracker>( )> TrackerFactory;
+
+    /**
+     * Create the trackers and start the workers
+     *
+     * @param[in] factory the function creating a tracker for each worker
+     * @param[in] cam the camera, it must outlive the executor
+     * @param[in] boardSize the size of the chessboard to detect
+     * @param[in] pattern the type of pattern to detect
+     * @param[in] numWorkers the number of worker threads, with 1 the frames are processed in submit
+     * @param[in] maxInFlight the maximum number of frames submitted and not yet returned by next (0 for 2 * numWorkers)
+     * @param[in] workerInit the function each worker calls when it starts (see ThreadBudget::workerInit), may be empty
+     */
+    OrderedTrackerExecutor( const TrackerFactory &factory, const Camera &cam, const cv::Size &boardSize, Pattern pattern,
+                            int numWorkers, size_t maxInFlight = 0, const ThreadPool::WorkerInit &workerInit = ThreadPool::WorkerInit( ) );
+
+    OrderedTrackerExecutor( const OrderedTrackerExecutor & ) = delete;
+    OrderedTrackerExecutor & operator=( const OrderedTrackerExecutor & ) = delete;
+
+    /**
+     * Return true if a frame can be submitted without blocking
+     * @return true if the number of frames in flight is below the bound
+     */
+    bool canSubmit( ) const;
+
+    /**
+     * Submit a frame, blocking while the number of frames in flight is at the bound
+     *
+     * @param[in] view the frame to process, it is copied (the frames read by a VideoCapture share its buffer)
+     * @return the index of the frame
+     */
+    int64_t submit( const cv::Mat &view );
+
+    /**
+     * Wait for the result of the oldest frame not yet returned
+     *
+     * @param[out] result the result of the frame
+     * @return false if there is no frame in flight
+     */
+    bool next( TrackedFrame &result );
+
+    /**
+     * Return the number of worker threads
+     * @return the number of worker threads
+     */
+    inline int getNumWorkers( ) const
+    {
+        return ( int ) _trackers.size( );
+    }
+
+    /**
+     * Wait for the frames in flight and stop the workers
+     */
+    virtual ~OrderedTrackerExecutor( );
+
+private:
+
+    // it processes a frame with a free tracker and stores the result
+    void process( TrackedFrame frame );
+
+    // one tracker for each worker
+    std::vector<std::unique_ptr<ICameraTracker> > _trackers;
+    // the indices of the trackers not in use
+    std::vector<size_t> _freeTrackers;
+
+    // the parameters of the tracking
+    const Camera &_cam;
+    const cv::Size _boardSize;
+    const Pattern _pattern;
+
+    // the maximum number of frames in flight
+    const size_t _maxInFlight;
+    // the index of the next frame to submit and of the next frame to return
+    int64_t _nextSubmit{0};
+    int64_t _nextOutput{0};
+    // the reorder buffer, the results ready and not yet returned
+    std::map<int64_t, TrackedFrame> _done;
+
+    // protects all the state above
+    mutable std::mutex _mutex;
+    // signals a new result
+    std::condition_variable _resultReady;
+    // signals that a frame has been returned
+    std::condition_variable _slotFree;
+
+    // the workers, null when the frames are processed in submit
+    std::unique_ptr<ThreadPool> _pool;
+
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+/**
+ * Find the corners of a board around their projection with a known pose:
+ * the points are projected, the projections whose window is inside the image
+ * and contrasted enough are refined with refineCornersSubPix, and a corner
+ * is kept if it stays close to its projection. Each corner keeps the id of
+ * its point, so the labelling comes from the pose and not from the grid.
+ *
+ * @param[in] grey the grey level frame
+ * @param[in] boardPoints the 3D points of the board model
+ * @param[in] ids the indices in boardPoints of the points to search
+ * @param[in] pose the 3x4 pose matrix [R t] used to project the points
+ * @param[in] cameraMatrix the camera matrix
+ * @param[in] distCoeffs the distortion coefficients to use for the projection
+ * @param[in] halfWin half of the side of the refinement window
+ * @param[in] maxShift the maximum distance in pixels between a projection and its refined corner
+ * @param[out] corners the corners found
+ * @param[out] cornerIds the index in boardPoints of each corner found
+ */
+void findCornersNearProjection( const cv::Mat &grey, const std::vector<cv::Point3f> &boardPoints, const std::vector<int> &ids,
+                                const cv::Mat &pose, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, int halfWin, float maxShift,
+                                std::vector<cv::Point2f> &corners, std::vector<int> &cornerIds );
+
+/**
+ * Detect the visible part of a chessboard near the pose it had in a previous
+ * frame (e.g. the last pose before an occlusion): all the corners of the
+ * model are searched around their projection with the anchor pose, then the
+ * pose is estimated with RANSAC on the corners found and only its inliers
+ * are kept. Unlike detectChessboard, it succeeds with a partial grid.
+ *
+ * @param[in] grey the grey level frame
+ * @param[in] boardPoints the 3D points of the board model
+ * @param[in] anchorPose the 3x4 pose matrix [R t] of the board in a previous frame
+ * @param[in] cameraMatrix the camera matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[out] corners the corners found
+ * @param[out] cornerIds the index in boardPoints of each corner found
+ * @param[out] pose the pose estimated from the corners found
+ * @param[in] minCorners the minimum number of consistent corners
+ * @return true if at least minCorners consistent corners have been found
+ */
+bool detectPartialChessboard( const cv::Mat &grey, const std::vector<cv::Point3f> &boardPoints, const cv::Mat &anchorPose,
+                              const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs,
+                              std::vector<cv::Point2f> &corners, std::vector<int> &cornerIds, cv::Mat &pose, size_t minCorners = 10 );
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+/**
+ * RANSAC pose estimation dedicated to planar targets (all the 3D points on
+ * the z = 0 plane, as the ones generated by calcChessboardCorners3D).
+ *
+ * Each hypothesis is the homography between the board plane and the
+ * normalized image plane computed from 4 points, so no PnP is solved inside
+ * the loop. All the points are scored against each hypothesis with a
+ * division-free test vectorised with SSE2 or NEON, and the number of
+ * iterations is updated from the best inlier ratio found so far. The pose of
+ * the best hypothesis is finally refined with the iterative PnP on its inliers.
+ *
+ * @param[in] objectPoints the 3D points, all with z = 0
+ * @param[in] imagePoints the image points
+ * @param[in] cameraMatrix the calibration matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[out] rvec the rotation vector of the pose
+ * @param[out] tvec the translation vector of the pose
+ * @param[out] inliers the list of indices of the inliers points
+ * @param[in] maxIterations the maximum number of hypotheses
+ * @param[in] reprojectionError the maximum reprojection error in pixels of an inlier
+ * @param[in] confidence the probability of having drawn at least one sample without outliers
+ * @param[in] parallel true to evaluate the hypotheses in parallel
+ * @return false if the points are not planar or no pose could be found
+ */
+bool planarSolvePnPRansac( const std::vector<cv::Point3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints,
+                           const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, cv::Mat &rvec, cv::Mat &tvec,
+                           std::vector<int> &inliers, int maxIterations = 100, float reprojectionError = 2.f,
+                           double confidence = 0.99, bool parallel = false );
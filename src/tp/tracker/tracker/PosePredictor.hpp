@@ -0,0 +1,62 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Constant velocity model of the camera pose.
+ *
+ * The velocity is the motion between the last two poses, expressed as a
+ * rotation vector and a translation per frame, and it is used to
+ * extrapolate the pose of the next frames (or of a fraction of frame, e.g.
+ * to compensate the latency of the rendering).
+ */
+class PosePredictor
+{
+public:
+
+    PosePredictor( ) = default;
+
+    /**
+     * Forget the previous poses, e.g. when the tracking is lost
+     */
+    void reset( );
+
+    /**
+     * Add the pose estimated for the current frame
+     *
+     * @param[in] pose the 3x4 pose matrix [R t] of the current frame
+     */
+    void update( const cv::Mat &pose );
+
+    /**
+     * Return true if the model has seen enough poses to predict the next one
+     * @return true if a velocity is available
+     */
+    inline bool isValid( ) const
+    {
+        return _numPoses >= 2;
+    }
+
+    /**
+     * Extrapolate the pose after the given number of frames from the last update
+     *
+     * @param[out] pose the predicted 3x4 pose matrix [R t] (CV_32F)
+     * @param[in] framesAhead the number of frames after the last update (it can be fractional)
+     * @return true if the pose could be predicted
+     */
+    bool predict( cv::Mat &pose, float framesAhead = 1.f ) const;
+
+    virtual ~PosePredictor( ) = default;
+
+private:
+
+    // the last pose
+    cv::Matx33d _rotation;
+    cv::Vec3d _translation;
+    // the rotation (as a rotation vector) and the translation between the last two poses
+    cv::Vec3d _angularVelocity;
+    cv::Vec3d _linearVelocity;
+    // the number of poses seen since the last reset, saturated at 2
+    int _numPoses{0};
+
+};
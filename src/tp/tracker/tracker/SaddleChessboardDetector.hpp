@@ -0,0 +1,27 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+/**
+ * Detect the inner corners of a chessboard as saddle points of the image
+ * intensity, an alternative to opencv's findChessboardCorners whose cost
+ * does not depend on the number of dilations needed to split the quads.
+ *
+ * The response -det(Hessian) of the smoothed image, computed with separable
+ * filters, is positive and peaks at the X-junctions of the board. The image
+ * is split into bands of rows processed in parallel: each band computes the
+ * response and keeps its local maxima, with a parabolic fit for their
+ * subpixel position. The grid is then grown from a seed candidate by
+ * extrapolating the positions of the neighbouring corners, and the window
+ * of boardSize corners with the strongest response is returned in the same
+ * row-major order as findChessboardCorners (the first row along the width).
+ *
+ * @param[in] image the image to process, grey level or BGR
+ * @param[in] boardSize the size of the board in terms of corners (width X height)
+ * @param[out] corners the detected corners
+ * @param[in] numBands the number of bands processed in parallel, 0 to choose it from the number of threads
+ * @return true if the whole board has been found
+ */
+bool findChessboardSaddles( const cv::Mat &image, const cv::Size &boardSize, std::vector<cv::Point2f> &corners, int numBands = 0 );
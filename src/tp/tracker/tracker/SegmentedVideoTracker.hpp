@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ICameraTracker.hpp"
+#include "ThreadPool.hpp"
+#include "VideoIndex.hpp"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * The pose estimated for a frame of a video
+ */
+struct FramePose
+{
+    // the index of the frame
+    int frame{0};
+    // the timestamp of the frame in milliseconds
+    double timestamp{0};
+    // true if the chessboard has been found
+    bool found{false};
+    // the 3x4 pose matrix [R t], empty if not found
+    cv::Mat pose;
+};
+
+/**
+ * Track a long video splitting it in segments processed in parallel, each by
+ * its own tracker.
+ *
+ * The segments start at the seek points of the video index. Each worker
+ * seeks to the start of its segment minus an overlap, so that the tracker is
+ * warmed up (a full detection followed by some tracked frames) when the
+ * segment begins; the poses of the overlap frames are discarded and the
+ * segments are stitched in a single pose stream in frame order.
+ */
+class SegmentedVideoTracker
+{
+public:
+
+    // it creates a tracker for a segment
+    typedef std::function<std::unique_ptr<ICameraTracker>( )> TrackerFactory;
+
+    /**
+     * Set up the tracking of a video
+     *
+     * @param[in] index the index of the video
+     * @param[in] factory the function creating a tracker for each segment
+     * @param[in] cam the camera
+     * @param[in] boardSize the size of the chessboard to detect
+     * @param[in] pattern the type of pattern to detect
+     */
+    SegmentedVideoTracker( const VideoIndex &index, const TrackerFactory &factory, const Camera &cam, const cv::Size &boardSize, Pattern pattern );
+
+    /**
+     * Track the whole video
+     *
+     * @param[out] poses the pose of each frame of the video, in frame order
+     * @param[in] numWorkers the number of segments processed in parallel
+     * @param[in] minSegmentLength the minimum number of frames of a segment (it is rounded to the next seek point)
+     * @param[in] overlap the number of frames processed before the segment start to warm the tracker up
+     * @param[in] workerInit the function each worker calls when it starts (see ThreadBudget::workerInit), may be empty
+     * @return false if a segment could not be read
+     */
+    bool run( std::vector<FramePose> &poses, int numWorkers, int minSegmentLength, int overlap,
+              const ThreadPool::WorkerInit &workerInit = ThreadPool::WorkerInit( ) ) const;
+
+    virtual ~SegmentedVideoTracker( ) = default;
+
+private:
+
+    // it tracks the frames [warmupStart, end) storing the poses of [start, end)
+    bool processSegment( int warmupStart, int start, int end, std::vector<FramePose> &poses ) const;
+
+    const VideoIndex &_index;
+    TrackerFactory _factory;
+    const Camera &_cam;
+    const cv::Size _boardSize;
+    const Pattern _pattern;
+
+};
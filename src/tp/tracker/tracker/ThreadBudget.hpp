@@ -0,0 +1,162 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * The stages of the pipelines, each with its own sharing of the cores
+ */
+enum PipelineStage
+{
+    // a single tracker: all the cores go to OpenCV
+    STAGE_SEQUENTIAL = 0,
+    // independent frames tracked in parallel (OrderedTrackerExecutor)
+    STAGE_FRAME_PARALLEL,
+    // segments of a video tracked in parallel (SegmentedVideoTracker)
+    STAGE_SEGMENTS,
+    // several cameras with their capture threads (MultiCameraRunner)
+    STAGE_MULTI_CAMERA,
+    STAGE_NUM_STAGES
+};
+
+/**
+ * The sharing of the cores decided for a stage
+ */
+struct ThreadAllocation
+{
+    // the stage
+    PipelineStage stage{STAGE_SEQUENTIAL};
+    // the cores available to the process
+    int numCores{1};
+    // the cores left to the auxiliary threads of the stage (e.g. the capture)
+    int reservedCores{0};
+    // the worker threads asked for, 0 if left to the budget
+    int requestedWorkers{0};
+    // the worker threads of the pipeline
+    int workers{1};
+    // the threads of the OpenCV parallel backend (cv::setNumThreads)
+    int opencvThreads{1};
+    // true if each worker is pinned to its share of the cores
+    bool pinned{false};
+    // the cores of each worker when pinned
+    std::vector<std::vector<int> > workerCores;
+};
+
+/**
+ * Share the cores between the worker threads of a pipeline and the parallel
+ * backend of OpenCV (used inside the workers by undistort, findChessboardCorners,
+ * calcOpticalFlowPyrLK...), so that their product does not exceed the cores.
+ *
+ * The cores left once the auxiliary threads are served are split among the
+ * workers, and each worker share is the number of OpenCV threads. Since
+ * cv::setNumThreads is global to the process, apply must be called when a
+ * stage starts; the allocations of all the stages are kept for the telemetry.
+ * On Linux the workers can be pinned to their share of the cores.
+ */
+class ThreadBudget
+{
+public:
+
+    /**
+     * Set up the budget
+     *
+     * @param[in] numCores the cores to share, 0 for all the cores available to the process
+     * @param[in] pinWorkers true to pin each worker to its share of the cores
+     */
+    explicit ThreadBudget( int numCores = 0, bool pinWorkers = false );
+
+    /**
+     * Decide the number of workers and of OpenCV threads of a stage
+     *
+     * @param[in] stage the stage
+     * @param[in] requestedWorkers the workers asked for, 0 to use all the cores left
+     * @param[in] maxUsefulWorkers the workers the stage can keep busy (e.g. one per camera), 0 if not bounded
+     * @param[in] auxiliaryThreads the threads of the stage that are not workers (at most half of the cores are reserved for them)
+     * @return the allocation, also recorded for the telemetry
+     */
+    ThreadAllocation allocate( PipelineStage stage, int requestedWorkers, int maxUsefulWorkers = 0, int auxiliaryThreads = 0 );
+
+    /**
+     * Set the number of threads of OpenCV for a stage about to start
+     *
+     * @param[in] allocation the allocation of the stage
+     */
+    static void apply( const ThreadAllocation &allocation );
+
+    /**
+     * Return the function pinning the workers of a stage, to give to its thread pool
+     *
+     * @param[in] allocation the allocation of the stage
+     * @return the function called by each worker when it starts, empty if the workers are not pinned
+     */
+    static ThreadPool::WorkerInit workerInit( const ThreadAllocation &allocation );
+
+    /**
+     * Pin the calling thread to a set of cores (only on Linux)
+     *
+     * @param[in] cores the indices of the cores
+     * @return false if the thread could not be pinned
+     */
+    static bool pinCurrentThread( const std::vector<int> &cores );
+
+    /**
+     * Return the cores shared by the budget
+     * @return the number of cores
+     */
+    inline int getNumCores( ) const
+    {
+        return ( int ) _cores.size( );
+    }
+
+    /**
+     * Return the allocations decided so far, in order
+     * @return the allocations
+     */
+    inline const std::vector<ThreadAllocation> & getAllocations( ) const
+    {
+        return _allocations;
+    }
+
+    virtual ~ThreadBudget( ) = default;
+
+private:
+
+    // the identifiers of the cores to share
+    std::vector<int> _cores;
+    // true to pin the workers
+    bool _pinWorkers;
+    // the allocations decided so far
+    std::vector<ThreadAllocation> _allocations;
+
+};
+
+/**
+ * Return the name of a stage
+ *
+ * @param[in] stage the stage
+ * @return its name
+ */
+std::string getStageName( PipelineStage stage );
+
+/**
+ * Print an allocation on a single line
+ *
+ * @param[in,out] os the output stream
+ * @param[in] allocation the allocation to print
+ * @return the output stream
+ */
+std::ostream & operator<<( std::ostream &os, const ThreadAllocation &allocation );
+
+/**
+ * Write an allocation in a file storage, as a map (fs << "threads" << allocation)
+ *
+ * @param[in,out] fs the file storage
+ * @param[in] name unused, the key is written by the caller
+ * @param[in] allocation the allocation to write
+ */
+void write( cv::FileStorage &fs, const std::string &name, const ThreadAllocation &allocation );
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads consuming a FIFO queue of tasks.
+ */
+class ThreadPool
+{
+public:
+
+    // it is called by each worker when it starts, with the index of the worker
+    typedef std::function<void( int )> WorkerInit;
+
+    /**
+     * Start the workers
+     *
+     * @param[in] numThreads the number of worker threads (at least 1)
+     * @param[in] init the function each worker calls before its first task (e.g. to pin it to some cores), may be empty
+     */
+    explicit ThreadPool( int numThreads, const WorkerInit &init = WorkerInit( ) );
+
+    ThreadPool( const ThreadPool & ) = delete;
+    ThreadPool & operator=( const ThreadPool & ) = delete;
+
+    /**
+     * Add a task to the queue, it will be run by the first idle worker
+     *
+     * @param[in] task the task to run
+     */
+    void submit( std::function<void( )> task );
+
+    /**
+     * Return the number of worker threads
+     * @return the number of worker threads
+     */
+    inline int size( ) const
+    {
+        return ( int ) _workers.size( );
+    }
+
+    /**
+     * Run the tasks still in the queue and join the workers
+     */
+    virtual ~ThreadPool( );
+
+private:
+
+    // the loop of each worker
+    void workerLoop( int index, WorkerInit init );
+
+    // the worker threads
+    std::vector<std::thread> _workers;
+    // the tasks waiting for a worker
+    std::deque<std::function<void( )> > _tasks;
+    // protects the queue
+    std::mutex _mutex;
+    // signals a new task (or the stop) to the workers
+    std::condition_variable _taskReady;
+    // true when the workers have to exit once the queue is empty
+    bool _stop{false};
+
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "utility.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+/**
+ * Search a chessboard in a high resolution frame by tiles.
+ *
+ * The frame is split in overlapping tiles twice as large as the expected
+ * footprint of the board, one footprint apart, so that a board not larger
+ * than the footprint lies entirely in at least one tile. The tiles are
+ * downscaled and searched concurrently (parallel_for_), with the fast check
+ * of findChessboardCorners discarding the empty ones quickly. The corners of
+ * the first tile (in row major order) where the board is found are brought
+ * back to the frame and refined at full resolution.
+ *
+ * @param[in] image the image to process, grey level or BGR
+ * @param[in] boardSize the number of inner corners per row and column
+ * @param[out] corners the corners of the chessboard, in the frame
+ * @param[in] expectedBoardSide the expected side in pixels of the bounding box of the board
+ * @param[in] detector the detector used on the tiles
+ * @return true if the chessboard has been found
+ */
+bool findChessboardTiled( const cv::Mat &image, const cv::Size &boardSize, std::vector<cv::Point2f> &corners,
+                          int expectedBoardSide, ChessboardDetector detector = DETECTOR_OPENCV );
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Remove the optical distortion from the frames using a precomputed map.
+ *
+ * The map is the same used by cv::undistort (the new camera matrix is the
+ * calibration matrix itself), but it is stored in fixed point so that the
+ * bilinear interpolation can be done with integer SIMD instructions (SSE2,
+ * AVX2 or NEON, with a scalar fallback). The grey level version of the
+ * undistorted frame is computed in the same pass, saving the cvtColor pass
+ * (and the memory round trip) that usually follows the undistortion.
+ */
+class Undistorter
+{
+public:
+
+    Undistorter( ) = default;
+
+    /**
+     * Build the undistortion map for the given camera parameters
+     *
+     * @param[in] matK the 3x3 calibration matrix
+     * @param[in] distCoeff the distortion coefficients
+     * @param[in] imageSize the size of the frames to undistort
+     */
+    void init( const cv::Mat &matK, const cv::Mat &distCoeff, const cv::Size &imageSize );
+
+    /**
+     * Use an existing undistortion map (e.g. loaded from a cache). The map is
+     * not copied, so the data must stay valid as long as the Undistorter is used
+     *
+     * @param[in] mapXY the integer source coordinates (CV_16SC2)
+     * @param[in] mapW the fractional part of the source coordinates (CV_8UC2)
+     */
+    void setMaps( const cv::Mat &mapXY, const cv::Mat &mapW );
+
+    /**
+     * Return the integer source coordinates of the map
+     * @return the integer source coordinates (CV_16SC2)
+     */
+    inline const cv::Mat & getMapXY( ) const
+    {
+        return _mapXY;
+    }
+
+    /**
+     * Return the fractional part of the source coordinates of the map
+     * @return the fractional part of the source coordinates (CV_8UC2)
+     */
+    inline const cv::Mat & getMapW( ) const
+    {
+        return _mapW;
+    }
+
+    /**
+     * Return the size of the frames the map has been built for
+     * @return the size of the frames, empty if the map has not been built yet
+     */
+    inline const cv::Size & getImageSize( ) const
+    {
+        return _imageSize;
+    }
+
+    /**
+     * Undistort a BGR frame and compute the grey level version of the result
+     *
+     * @param[in] src the BGR frame to undistort (CV_8UC3)
+     * @param[out] colour the undistorted BGR frame, it can be the same Mat as src
+     * @param[out] grey the grey level version of the undistorted frame
+     */
+    void process( const cv::Mat &src, cv::Mat &colour, cv::Mat &grey ) const;
+
+    /**
+     * Undistort a BGR frame producing only its grey level version
+     *
+     * @param[in] src the BGR frame to undistort (CV_8UC3)
+     * @param[out] grey the grey level version of the undistorted frame
+     */
+    void process( const cv::Mat &src, cv::Mat &grey ) const;
+
+    virtual ~Undistorter( ) = default;
+
+private:
+
+    // it remaps src into colour (if not null) and grey
+    void remapAndConvert( const cv::Mat &src, cv::Mat *colour, cv::Mat &grey ) const;
+
+    // integer coordinates (x0, y0) of the top-left source pixel, x0 is -1 if
+    // the pixel falls outside the source image (CV_16SC2)
+    cv::Mat _mapXY;
+    // fractional part (fx, fy) of the source coordinates in 1/128 of pixel (CV_8UC2)
+    cv::Mat _mapW;
+    // the size of the frames
+    cv::Size _imageSize;
+
+};
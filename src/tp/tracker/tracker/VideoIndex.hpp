@@ -0,0 +1,104 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Index of a video file: number of frames, timestamp of each frame and the
+ * frames where a reader can seek to.
+ *
+ * The index is built by grabbing (not decoding) all the frames once, and it is
+ * cached in a YAML file next to the video (videoFilename + ".index.yml"),
+ * rebuilt whenever the video changes. OpenCV does not tell which frames are
+ * keyframes, so the seek points are evenly spaced frames: seeking to them is
+ * done by the backend (which decodes from the previous keyframe) and checked
+ * against the timestamps of the index.
+ */
+class VideoIndex
+{
+public:
+
+    VideoIndex( ) = default;
+
+    /**
+     * Load the index of the video from its cache, or build it (and save the
+     * cache) if the cache is missing or stale
+     *
+     * @param[in] videoFilename the video file
+     * @param[in] seekPointSpacing the number of frames between two seek points
+     * @param[in] useCache true to load/save the cache
+     * @return true if success
+     */
+    bool init( const std::string &videoFilename, int seekPointSpacing = 250, bool useCache = true );
+
+    /**
+     * Return the number of frames of the video
+     * @return the number of frames
+     */
+    inline int getFrameCount( ) const
+    {
+        return ( int ) _timestamps.size( );
+    }
+
+    /**
+     * Return the timestamp of a frame
+     * @param[in] frame the index of the frame
+     * @return the timestamp in milliseconds
+     */
+    inline double getTimestamp( int frame ) const
+    {
+        return _timestamps[frame];
+    }
+
+    /**
+     * Return the frames where a reader can seek to, in increasing order
+     * @return the indices of the seek points
+     */
+    inline const std::vector<int> & getSeekPoints( ) const
+    {
+        return _seekPoints;
+    }
+
+    /**
+     * Return the last seek point at or before the given frame
+     * @param[in] frame the index of the frame
+     * @return the index of the seek point
+     */
+    int getSeekPointBefore( int frame ) const;
+
+    /**
+     * Open the video positioned at the given frame: it seeks to the frame and
+     * checks the timestamp, if the backend seeks imprecisely the frames are
+     * grabbed from the beginning
+     *
+     * @param[in] capture the capture to open
+     * @param[in] frame the index of the first frame to read
+     * @return true if success
+     */
+    bool openAt( cv::VideoCapture &capture, int frame ) const;
+
+    virtual ~VideoIndex( ) = default;
+
+private:
+
+    // it grabs all the frames of the video to fill the index
+    bool build( int seekPointSpacing );
+
+    // it loads the index from the cache, false if missing or stale
+    bool load( const std::string &indexFilename, int64_t videoSize, int64_t videoTime, int seekPointSpacing );
+
+    // it saves the index to the cache
+    bool save( const std::string &indexFilename, int64_t videoSize, int64_t videoTime, int seekPointSpacing ) const;
+
+    // the video file
+    std::string _videoFilename;
+    // the timestamp in milliseconds of each frame
+    std::vector<double> _timestamps;
+    // the frames a reader can seek to
+    std::vector<int> _seekPoints;
+
+};
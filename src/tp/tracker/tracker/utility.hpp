@@ -22,16 +22,50 @@ enum Pattern
     CHESSBOARD, CIRCLES_GRID, ASYMMETRIC_CIRCLES_GRID
 };
 
+// Enumerative type containing the ways the pose has been estimated (by
+// mySolvePnP or, for the full detections, by solvePlanarPose), PNP_STATIC
+// if the previous pose has been reused on a static frame
+
+enum PnPPath
+{
+    PNP_NONE, PNP_ITERATIVE, PNP_RANSAC, PNP_PLANAR, PNP_STATIC
+};
+
+// Enumerative type containing the detectors of the patterns: opencv's
+// findChessboardCorners and findCirclesGrid (with its multi threshold blob
+// detector), or the faster ones of the project, findChessboardSaddles for
+// the CHESSBOARD and findCirclesGridFast for the circles' grids
+
+enum ChessboardDetector
+{
+    DETECTOR_OPENCV, DETECTOR_FAST
+};
+
 /**
  * Detect a chessboard in a given image
  *
- * @param[in] rgbimage The rgb image to process
+ * @param[in] rgbimage The rgb image to process (a grey level image is also accepted)
  * @param[out] pointbuf the set of 2D image corner detected on the chessboard 
  * @param[in] boardSize the size of the board in terms of corners (width X height)
  * @param[in] patternType The type of chessboard pattern to look for
+ * @param[in] detector The detector to use
+ * @param[in] previousLayout The points detected in the previous frame, if any: the fast circles' grid detector keeps their order if they match the new ones
+ * @param[in] tiledBoardSide The expected side in pixels of the chessboard: if > 0 the CHESSBOARD is searched by tiles --> see findChessboardTiled
  * @return true if the chessboard is detected inside the image, false otherwise 
  */
-bool detectChessboard( const cv::Mat &rgbimage, std::vector<cv::Point2f> &pointbuf, const cv::Size &boardSize, Pattern patternType );
+bool detectChessboard( const cv::Mat &rgbimage, std::vector<cv::Point2f> &pointbuf, const cv::Size &boardSize, Pattern patternType,
+                       ChessboardDetector detector = DETECTOR_OPENCV, const std::vector<cv::Point2f> &previousLayout = std::vector<cv::Point2f>( ),
+                       int tiledBoardSide = 0 );
+
+/**
+ * Estimate the homography dst = H * src with the normalized DLT (no RANSAC,
+ * all the correspondences must be correct, e.g. from a full detection)
+ *
+ * @param[in] src the source points
+ * @param[in] dst the destination points
+ * @return the 3x3 homography (CV_64F), empty if it cannot be estimated
+ */
+cv::Mat normalizedDLTHomography( const std::vector<cv::Point2f> &src, const std::vector<cv::Point2f> &dst );
 
 /**
  * Decompose the homography into its components R and t
@@ -42,6 +76,35 @@ bool detectChessboard( const cv::Mat &rgbimage, std::vector<cv::Point2f> &pointb
  */
 void decomposeHomography( const cv::Mat &H, const cv::Mat& matK, cv::Mat& poseMat );
 
+/**
+ * Refine a pose with a few Levenberg-Marquardt iterations minimizing the
+ * reprojection error
+ *
+ * @param[in] objectPoints the 3D points
+ * @param[in] imagePoints the image points
+ * @param[in] cameraMatrix the calibration matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[in,out] poseMat the 3x4 pose matrix [R t]
+ * @param[in] iterations the maximum number of iterations
+ */
+void refinePoseLM( const std::vector<cv::Point3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, cv::Mat &poseMat, int iterations = 5 );
+
+/**
+ * Closed form pose of a planar target (all the points with z = 0) when all
+ * the correspondences are correct, e.g. from a full detection of the board:
+ * normalized DLT homography, its decomposition and an optional short
+ * Levenberg-Marquardt refinement
+ *
+ * @param[in] objectPoints the 3D points, all with z = 0
+ * @param[in] imagePoints the image points
+ * @param[in] cameraMatrix the calibration matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[out] poseMat the 3x4 pose matrix [R t]
+ * @param[in] lmIterations the number of refinement iterations, 0 to disable it
+ * @return true if the pose has been estimated
+ */
+bool solvePlanarPose( const std::vector<cv::Point3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, cv::Mat &poseMat, int lmIterations = 5 );
+
 /**
  * 
  * @param[in,out] rgbimage The image on which to draw the reference system
@@ -65,7 +128,8 @@ void drawReferenceSystem( cv::Mat &rgbimage, const Camera& cam, const cv::Mat &p
 void myProjectPoints( cv::InputArray objectPoints, const cv::Mat &poseMat, cv::InputArray cameraMatrix, cv::InputArray distCoeffs, cv::OutputArray imagePoints );
 
 /**
- * Wrapper around the original opencv's solvePnPRansac
+ * RANSAC pose estimation: planar targets (as the chessboard) use the
+ * dedicated engine of planarSolvePnPRansac, the other cases opencv's solvePnPRansac
  * 
  * @param[in] objectPoints the 3D points
  * @param[in] imagePoints the image points
@@ -76,6 +140,25 @@ void myProjectPoints( cv::InputArray objectPoints, const cv::Mat &poseMat, cv::I
  */
 void mySolvePnPRansac( cv::InputArray objectPoints, cv::InputArray imagePoints, cv::InputArray cameraMatrix, cv::InputArray distCoeffs, cv::Mat &poseMat, cv::OutputArray inliers = cv::noArray( ) );
 
+/**
+ * Estimate the pose refining a prior pose (e.g. the one of the previous
+ * frame) with the iterative PnP. If there is no prior, or if too many points
+ * have a reprojection error above maxError after the refinement, the pose is
+ * estimated from scratch with mySolvePnPRansac; otherwise the refined pose is
+ * refined again on the inliers only
+ *
+ * @param[in] objectPoints the 3D points
+ * @param[in] imagePoints the image points
+ * @param[in] cameraMatrix the calibration matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[in] priorPose the 3x4 prior pose matrix, it can be empty
+ * @param[out] poseMat the pose matrix
+ * @param[out] inliers the list of indices of the inliers points
+ * @param[in] maxError the maximum reprojection error in pixels of an inlier
+ * @return the method that has been used to estimate the pose
+ */
+PnPPath mySolvePnP( const std::vector<cv::Point3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, const cv::Mat &priorPose, cv::Mat &poseMat, std::vector<int> &inliers, float maxError = 2.f );
+
 /**
  * Generate the set of 3D points of a chessboard
  *
@@ -1,8 +1,15 @@
 #include "tracker/utility.hpp"
+#include "tracker/CircleGridDetector.hpp"
+#include "tracker/CornerRefiner.hpp"
+#include "tracker/PlanarPnPRansac.hpp"
+#include "tracker/SaddleChessboardDetector.hpp"
+#include "tracker/TiledChessboardSearch.hpp"
 
 #include <opencv2/calib3d/calib3d.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <cfloat>
+#include <cmath>
 #include <iostream>
 
 using namespace cv;
@@ -17,13 +24,17 @@ using namespace std;
 /**
  * Detect a chessboard in a given image
  *
- * @param[in] rgbimage The rgb image to process
+ * @param[in] rgbimage The rgb image to process (a grey level image is also accepted)
  * @param[out] pointbuf the set of 2D image corner detected on the chessboard 
  * @param[in] boardSize the size of the board in terms of corners (width X height)
  * @param[in] patternType The type of chessboard pattern to look for
+ * @param[in] detector The detector to use
+ * @param[in] previousLayout The points detected in the previous frame, if any: the fast circles' grid detector keeps their order if they match the new ones
+ * @param[in] tiledBoardSide The expected side in pixels of the chessboard: if > 0 the CHESSBOARD is searched by tiles --> see findChessboardTiled
  * @return true if the chessboard is detected inside the image, false otherwise 
  */
-bool detectChessboard( const Mat &rgbimage, vector<Point2f> &pointbuf, const Size &boardSize, Pattern patternType )
+bool detectChessboard( const Mat &rgbimage, vector<Point2f> &pointbuf, const Size &boardSize, Pattern patternType,
+                       ChessboardDetector detector, const vector<Point2f> &previousLayout, int tiledBoardSide )
 {
     // it contains the value to return
     bool found = false;
@@ -33,8 +44,15 @@ bool detectChessboard( const Mat &rgbimage, vector<Point2f> &pointbuf, const Siz
         // detect a classic chessboard
         case CHESSBOARD:
 
-            // detect the chessboard --> see findChessboardCorners
-            found = findChessboardCorners(rgbimage, boardSize, pointbuf);
+            // detect the chessboard --> see findChessboardCorners, or the
+            // saddle points of the intensity --> see findChessboardSaddles,
+            // on the whole frame or on its tiles --> see findChessboardTiled
+            if( tiledBoardSide > 0 )
+                found = findChessboardTiled(rgbimage, boardSize, pointbuf, tiledBoardSide, detector);
+            else if( detector == DETECTOR_FAST )
+                found = findChessboardSaddles(rgbimage, boardSize, pointbuf);
+            else
+                found = findChessboardCorners(rgbimage, boardSize, pointbuf);
 
             // if a chessboard is found refine the position of the points in a window 11x11 pixel
             // use the default value for the termination criteria --> TermCriteria( CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 30, 0.1 )
@@ -43,28 +61,37 @@ bool detectChessboard( const Mat &rgbimage, vector<Point2f> &pointbuf, const Siz
                 Mat viewGrey; // it will contain the graylevel version of the image
 
                 // convert the image in "rgbimage" to gray level and save it in "viewGrey"
-                // --> cvtColor with CV_BGR2GRAY option
-                cvtColor(rgbimage, viewGrey, CV_BGR2GRAY);
+                // --> cvtColor with CV_BGR2GRAY option (unless it is already a grey image)
+                if( rgbimage.channels( ) == 1 )
+                    viewGrey = rgbimage;
+                else
+                    cvtColor(rgbimage, viewGrey, CV_BGR2GRAY);
 
                 // refine the corner location in "pointbuf" using "viewGrey"
-                // --> see cornerSubPix
+                // --> see refineCornersSubPix, the batched version of cornerSubPix
                 Size winSize = Size( 5, 5 );
-                Size zeroZone = Size( -1, -1 );
                 TermCriteria criteria = TermCriteria( CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 40, 0.001 );
-                cornerSubPix(viewGrey, pointbuf, winSize, zeroZone, criteria);
+                refineCornersSubPix(viewGrey, pointbuf, winSize, criteria);
             }
             break;
 
         // detect a regular grid made of circles
         case CIRCLES_GRID:
-            // detect the circles --> see findCirclesGrid
-            found = findCirclesGrid(rgbimage, boardSize, pointbuf);
+            // detect the circles --> see findCirclesGrid, or the single
+            // threshold blobs --> see findCirclesGridFast
+            if( detector == DETECTOR_FAST )
+                found = findCirclesGridFast(rgbimage, boardSize, pointbuf, false, previousLayout);
+            else
+                found = findCirclesGrid(rgbimage, boardSize, pointbuf);
             break;
 
         // detect an asymmetric grid made of circles
         case ASYMMETRIC_CIRCLES_GRID:
             // detect the circles --> see findCirclesGrid using the options CALIB_CB_ASYMMETRIC_GRID | CALIB_CB_CLUSTERING
-            found = findCirclesGrid(rgbimage, boardSize, pointbuf, CALIB_CB_ASYMMETRIC_GRID);
+            if( detector == DETECTOR_FAST )
+                found = findCirclesGridFast(rgbimage, boardSize, pointbuf, true, previousLayout);
+            else
+                found = findCirclesGrid(rgbimage, boardSize, pointbuf, CALIB_CB_ASYMMETRIC_GRID);
             break;
 
         default:
@@ -200,6 +227,72 @@ void calcChessboardCorners( const Size &boardSize, const float &squareSize, vect
     }
 }
 
+// it computes the similarity that brings the centroid of the points to the
+// origin and their mean distance from it to sqrt(2)
+static Matx33d normalizingTransform( const vector<Point2f> &points )
+{
+    Point2d centroid( 0, 0 );
+    for( size_t i = 0; i < points.size( ); ++i )
+        centroid += Point2d( points[i].x, points[i].y );
+    centroid *= 1. / points.size( );
+
+    double meanDist = 0;
+    for( size_t i = 0; i < points.size( ); ++i )
+        meanDist += norm( Point2d( points[i].x, points[i].y ) - centroid );
+    meanDist /= points.size( );
+
+    const double s = meanDist > DBL_EPSILON ? sqrt( 2. ) / meanDist : 1.;
+    return Matx33d( s, 0, -s * centroid.x,
+                    0, s, -s * centroid.y,
+                    0, 0, 1 );
+}
+
+/**
+ * Estimate the homography dst = H * src with the normalized DLT (no RANSAC,
+ * all the correspondences must be correct, e.g. from a full detection)
+ *
+ * @param[in] src the source points
+ * @param[in] dst the destination points
+ * @return the 3x3 homography (CV_64F), empty if it cannot be estimated
+ */
+Mat normalizedDLTHomography( const vector<Point2f> &src, const vector<Point2f> &dst )
+{
+    const int count = ( int ) src.size( );
+    if( count < 4 || dst.size( ) != src.size( ) )
+        return Mat( );
+
+    // condition the problem (Hartley normalization)
+    const Matx33d Ts = normalizingTransform( src );
+    const Matx33d Td = normalizingTransform( dst );
+
+    // two equations for each correspondence
+    Mat A( 2 * count, 9, CV_64F );
+    for( int i = 0; i < count; ++i )
+    {
+        const double x = Ts( 0, 0 ) * src[i].x + Ts( 0, 2 ), y = Ts( 1, 1 ) * src[i].y + Ts( 1, 2 );
+        const double u = Td( 0, 0 ) * dst[i].x + Td( 0, 2 ), v = Td( 1, 1 ) * dst[i].y + Td( 1, 2 );
+
+        double *r0 = A.ptr<double>( 2 * i );
+        double *r1 = A.ptr<double>( 2 * i + 1 );
+        r0[0] = x; r0[1] = y; r0[2] = 1; r0[3] = 0; r0[4] = 0; r0[5] = 0; r0[6] = -u * x; r0[7] = -u * y; r0[8] = -u;
+        r1[0] = 0; r1[1] = 0; r1[2] = 0; r1[3] = x; r1[4] = y; r1[5] = 1; r1[6] = -v * x; r1[7] = -v * y; r1[8] = -v;
+    }
+
+    // the solution is the right singular vector of the smallest singular value,
+    // i.e. the eigenvector of A'A with the smallest eigenvalue
+    Mat eigenValues, eigenVectors;
+    eigen( A.t( ) * A, eigenValues, eigenVectors );
+    const Mat h = eigenVectors.row( 8 ).reshape( 1, 3 );
+
+    // denormalize
+    Mat H = Mat( Td.inv( ) ) * h * Mat( Ts );
+    const double h22 = H.at<double>( 2, 2 );
+    if( fabs( h22 ) < DBL_EPSILON )
+        return Mat( );
+    H /= h22;
+    return H;
+}
+
 /**
  * Decompose the homography into its components R and t
  *
@@ -209,38 +302,174 @@ void calcChessboardCorners( const Size &boardSize, const float &squareSize, vect
  */
 void decomposeHomography( const Mat &H, const Mat& matK, Mat& poseMat )
 {
-    Mat temp;
+    Mat H64, K64;
+    H.convertTo( H64, CV_64F );
+    matK.convertTo( K64, CV_64F );
 
     //temp contains inv(K)*H
-    temp = matK.inv()*H;
+    Mat temp = K64.inv( ) * H64;
+
+    // compute lambda from both columns, the sign keeps the board in front of the camera
+    double lambda = 2 / ( norm( temp.col( 0 ) ) + norm( temp.col( 1 ) ) );
+    if( temp.at<double>( 2, 2 ) < 0 )
+        lambda = -lambda;
+    temp *= lambda;
+
+    // compute r1, r2 and r3 = r1 x r2
+    Mat R( 3, 3, CV_64F );
+    temp.col( 0 ).copyTo( R.col( 0 ) );
+    temp.col( 1 ).copyTo( R.col( 1 ) );
+    Mat r3 = temp.col( 0 ).cross( temp.col( 1 ) );
+    r3.copyTo( R.col( 2 ) );
+
+    // the noise makes [r1 r2 r3] not orthonormal, replace it with the
+    // closest rotation matrix R = U * V'
+    SVD svd( R );
+    R = svd.u * svd.vt;
+    if( determinant( R ) < 0 )
+        R = -R;
+
+    // create a 3x4 matrix (float) for poseMat and fill the columns with R and t
+    Mat pose64( 3, 4, CV_64F );
+    R.copyTo( pose64.colRange( 0, 3 ) );
+    temp.col( 2 ).copyTo( pose64.col( 3 ) );
+    pose64.convertTo( poseMat, CV_32F );
+}
+
+/**
+ * Refine a pose with a few Levenberg-Marquardt iterations minimizing the
+ * reprojection error
+ *
+ * @param[in] objectPoints the 3D points
+ * @param[in] imagePoints the image points
+ * @param[in] cameraMatrix the calibration matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[in,out] poseMat the 3x4 pose matrix [R t]
+ * @param[in] iterations the maximum number of iterations
+ */
+void refinePoseLM( const vector<Point3f> &objectPoints, const vector<Point2f> &imagePoints, const Mat &cameraMatrix, const Mat &distCoeffs, Mat &poseMat, int iterations )
+{
+    const int count = ( int ) objectPoints.size( );
+    if( count < 4 || iterations <= 0 )
+        return;
+
+    Mat pose64;
+    poseMat.convertTo( pose64, CV_64F );
+    Mat rvec, tvec = pose64.col( 3 ).clone( );
+    Rodrigues( pose64.colRange( 0, 3 ), rvec );
+
+    // the observations as a 2N x 1 vector
+    const Mat observed = Mat( imagePoints ).reshape( 1, 2 * count );
+    Mat observed64;
+    observed.convertTo( observed64, CV_64F );
+
+    // the residuals and the jacobian wrt rvec and tvec (first 6 columns of the projectPoints one)
+    vector<Point2f> projected;
+    Mat jacobian;
+    projectPoints( objectPoints, rvec, tvec, cameraMatrix, distCoeffs, projected, jacobian );
+    Mat residual;
+    Mat( projected ).reshape( 1, 2 * count ).convertTo( residual, CV_64F );
+    residual = observed64 - residual;
+    double error = residual.dot( residual );
+
+    double damping = 1e-3;
+    for( int it = 0; it < iterations; ++it )
+    {
+        const Mat J = jacobian.colRange( 0, 6 );
+        const Mat JtJ = J.t( ) * J;
+        const Mat Jtr = J.t( ) * residual;
+
+        // damped normal equations, retry with a larger damping if the error does not decrease
+        bool improved = false;
+        while( !improved && damping < 1e6 )
+        {
+            Mat A = JtJ.clone( );
+            for( int k = 0; k < 6; ++k )
+                A.at<double>( k, k ) *= 1 + damping;
+            Mat delta;
+            if( !solve( A, Jtr, delta, DECOMP_CHOLESKY ) )
+            {
+                damping *= 10;
+                continue;
+            }
 
-    Mat r1, r2, r3, t;
+            const Mat newR = rvec + delta.rowRange( 0, 3 );
+            const Mat newT = tvec + delta.rowRange( 3, 6 );
+            Mat newJacobian;
+            projectPoints( objectPoints, newR, newT, cameraMatrix, distCoeffs, projected, newJacobian );
+            Mat newResidual;
+            Mat( projected ).reshape( 1, 2 * count ).convertTo( newResidual, CV_64F );
+            newResidual = observed64 - newResidual;
+            const double newError = newResidual.dot( newResidual );
 
-    // compute r1 and r2 from temp
-    r1 = temp.col(0);
-    r2 = temp.col(1);
+            if( newError < error )
+            {
+                improved = true;
+                rvec = newR;
+                tvec = newT;
+                jacobian = newJacobian;
+                residual = newResidual;
+                // stop when the error does not change anymore
+                const bool converged = error - newError < 1e-10 * error;
+                error = newError;
+                damping = max( damping * 0.1, 1e-7 );
+                if( converged )
+                    it = iterations;
+            }
+            else
+            {
+                damping *= 10;
+            }
+        }
+        if( !improved )
+            break;
+    }
+
+    Mat R;
+    Rodrigues( rvec, R );
+    R.copyTo( pose64.colRange( 0, 3 ) );
+    tvec.copyTo( pose64.col( 3 ) );
+    pose64.convertTo( poseMat, CV_32F );
+}
 
-    // compute lambda
-    float lambda = 1 / norm(r1);
-    
-    // normalize r1 and r2
-    r1 = r1 * lambda;
-    r2 = r2 * lambda;
+/**
+ * Closed form pose of a planar target (all the points with z = 0) when all
+ * the correspondences are correct, e.g. from a full detection of the board:
+ * normalized DLT homography, its decomposition and an optional short
+ * Levenberg-Marquardt refinement
+ *
+ * @param[in] objectPoints the 3D points, all with z = 0
+ * @param[in] imagePoints the image points
+ * @param[in] cameraMatrix the calibration matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[out] poseMat the 3x4 pose matrix [R t]
+ * @param[in] lmIterations the number of refinement iterations, 0 to disable it
+ * @return true if the pose has been estimated
+ */
+bool solvePlanarPose( const vector<Point3f> &objectPoints, const vector<Point2f> &imagePoints, const Mat &cameraMatrix, const Mat &distCoeffs, Mat &poseMat, int lmIterations )
+{
+    if( objectPoints.size( ) < 4 || imagePoints.size( ) != objectPoints.size( ) )
+        return false;
 
-    // compute r3
-    r3 = r1.cross(r2);
+    // the homography between the board plane and the normalized image plane
+    vector<Point2f> boardPoints( objectPoints.size( ) );
+    for( size_t i = 0; i < objectPoints.size( ); ++i )
+    {
+        if( objectPoints[i].z != 0.f )
+            return false;
+        boardPoints[i] = Point2f( objectPoints[i].x, objectPoints[i].y );
+    }
+    vector<Point2f> normalized;
+    undistortPoints( imagePoints, normalized, cameraMatrix, distCoeffs );
 
-    // compute t
-    t = temp.col(2) * lambda;
+    const Mat H = normalizedDLTHomography( boardPoints, normalized );
+    if( H.empty( ) )
+        return false;
 
-    // create a 3x4 matrix (float) for poseMat
-    poseMat = (Mat_<float>(3,4) << 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    decomposeHomography( H, Mat::eye( 3, 3, CV_64F ), poseMat );
 
-    // fill the columns of poseMat with r1 r2 r3 and t
-    r1.copyTo(poseMat.col(0));
-    r2.copyTo(poseMat.col(1));
-    r3.copyTo(poseMat.col(2));
-    t.copyTo(poseMat.col(3));
+    refinePoseLM( objectPoints, imagePoints, cameraMatrix, distCoeffs, poseMat, lmIterations );
+    return true;
 }
 
 /******************************************************************************/
@@ -289,8 +518,31 @@ void calcChessboardCorners3D( const Size &boardSize, const float &squareSize, ve
     }
 }
 
+// it builds the 3x4 pose matrix (CV_32F) from the rotation and translation vectors
+static void rtToPose( const Mat &rvec, const Mat &tvec, Mat &poseMat )
+{
+    poseMat = Mat( 3, 4, CV_32F );
+
+    Mat Rot;
+    Rodrigues( rvec, Rot );
+#if CV_MINOR_VERSION < 4
+    // apparently older versions does not support direct copy
+    Mat temp;
+    Rot.convertTo( temp, CV_32F );
+    Mat a1 = poseMat.colRange( 0, 3 );
+    temp.copyTo( a1 );
+    a1 = poseMat.col( 3 );
+    tvec.convertTo( temp, CV_32F );
+    temp.copyTo( a1 );
+#else
+    Rot.copyTo( poseMat.colRange( 0, 3 ) );
+    tvec.copyTo( poseMat.col( 3 ) );
+#endif
+}
+
 /**
- * Wrapper around the original opencv's solvePnPRansac
+ * RANSAC pose estimation: planar targets (as the chessboard) use the
+ * dedicated engine of planarSolvePnPRansac, the other cases opencv's solvePnPRansac
  * 
  * @param[in] objectPoints the 3D points
  * @param[in] imagePoints the image points
@@ -301,27 +553,108 @@ void calcChessboardCorners3D( const Size &boardSize, const float &squareSize, ve
  */
 void mySolvePnPRansac( cv::InputArray objectPoints, cv::InputArray imagePoints, cv::InputArray cameraMatrix, cv::InputArray distCoeffs, cv::Mat &poseMat, OutputArray inliers )
 {
+    // above this number of points the hypotheses are scored in parallel
+    const int minParallelPoints = 256;
+
     Mat currR, currT;
+
+    const Mat objMat = objectPoints.getMat( );
+    const Mat imgMat = imagePoints.getMat( );
+    const int count = objMat.checkVector( 3, CV_32F );
+    if( count >= 4 && imgMat.checkVector( 2, CV_32F ) == count )
+    {
+        vector<Point3f> obj;
+        vector<Point2f> img;
+        objMat.reshape( 3, count ).copyTo( obj );
+        imgMat.reshape( 2, count ).copyTo( img );
+
+        vector<int> inl;
+        if( planarSolvePnPRansac( obj, img, cameraMatrix.getMat( ), distCoeffs.getMat( ), currR, currT, inl, 100, 2, 0.99, count >= minParallelPoints ) )
+        {
+            if( inliers.needed( ) )
+                Mat( inl ).copyTo( inliers );
+            rtToPose( currR, currT, poseMat );
+            return;
+        }
+    }
+
     // http://www.programmersought.com/article/93011113144/ for the confidence (0.99 instead of 100)
     solvePnPRansac( objectPoints, imagePoints, cameraMatrix, distCoeffs, currR, currT, false, 100, 2, 0.99, inliers );
 
-    poseMat = Mat( 3, 4, CV_32F );
+    rtToPose( currR, currT, poseMat );
+}
 
-    Mat Rot;
-    Rodrigues( currR, Rot );
-#if CV_MINOR_VERSION < 4
-    // apparently older versions does not support direct copy
-    Mat temp;
-    Rot.convertTo( temp, CV_32F );
-    Mat a1 = poseMat.colRange( 0, 3 );
-    temp.copyTo( a1 );
-    a1 = poseMat.col( 3 );
-    currT.convertTo( temp, CV_32F );
-    temp.copyTo( a1 );
-#else
-    Rot.copyTo( poseMat.colRange( 0, 3 ) );
-    currT.copyTo( poseMat.col( 3 ) );
-#endif
+/**
+ * Estimate the pose refining a prior pose (e.g. the one of the previous
+ * frame) with the iterative PnP. If there is no prior, or if too many points
+ * have a reprojection error above maxError after the refinement, the pose is
+ * estimated from scratch with mySolvePnPRansac; otherwise the refined pose is
+ * refined again on the inliers only
+ *
+ * @param[in] objectPoints the 3D points
+ * @param[in] imagePoints the image points
+ * @param[in] cameraMatrix the calibration matrix
+ * @param[in] distCoeffs the distortion coefficients
+ * @param[in] priorPose the 3x4 prior pose matrix, it can be empty
+ * @param[out] poseMat the pose matrix
+ * @param[out] inliers the list of indices of the inliers points
+ * @param[in] maxError the maximum reprojection error in pixels of an inlier
+ * @return the method that has been used to estimate the pose
+ */
+PnPPath mySolvePnP( const std::vector<cv::Point3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints, const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, const cv::Mat &priorPose, cv::Mat &poseMat, std::vector<int> &inliers, float maxError )
+{
+    // the minimum fraction of inliers to accept the refined pose
+    const float minInlierRatio = 0.9f;
+
+    inliers.clear( );
+    if( objectPoints.size( ) < 4 )
+        return PNP_NONE;
+
+    if( !priorPose.empty( ) )
+    {
+        // refine the prior with the iterative (Levenberg-Marquardt) PnP
+        Mat prior64;
+        priorPose.convertTo( prior64, CV_64F );
+        Mat rvec, tvec = prior64.col( 3 ).clone( );
+        Rodrigues( prior64.colRange( 0, 3 ), rvec );
+        solvePnP( objectPoints, imagePoints, cameraMatrix, distCoeffs, rvec, tvec, true );
+
+        // check the residuals of the refined pose
+        vector<Point2f> projected;
+        projectPoints( objectPoints, rvec, tvec, cameraMatrix, distCoeffs, projected );
+        const float maxError2 = maxError * maxError;
+        inliers.reserve( projected.size( ) );
+        for( size_t i = 0; i < projected.size( ); ++i )
+        {
+            const Point2f d = projected[ i ] - imagePoints[ i ];
+            if( d.dot( d ) <= maxError2 )
+                inliers.push_back( ( int ) i );
+        }
+
+        if( inliers.size( ) >= minInlierRatio * objectPoints.size( ) )
+        {
+            // the refinement above is biased by the outliers, refine again on
+            // the inliers only starting from its result
+            if( inliers.size( ) < objectPoints.size( ) )
+            {
+                vector<Point3f> inlierObjectPoints( inliers.size( ) );
+                vector<Point2f> inlierImagePoints( inliers.size( ) );
+                for( size_t i = 0; i < inliers.size( ); ++i )
+                {
+                    inlierObjectPoints[ i ] = objectPoints[ inliers[ i ] ];
+                    inlierImagePoints[ i ] = imagePoints[ inliers[ i ] ];
+                }
+                solvePnP( inlierObjectPoints, inlierImagePoints, cameraMatrix, distCoeffs, rvec, tvec, true );
+            }
+            rtToPose( rvec, tvec, poseMat );
+            return PNP_ITERATIVE;
+        }
+        inliers.clear( );
+    }
+
+    // no prior or the prior was too far, start from scratch
+    mySolvePnPRansac( objectPoints, imagePoints, cameraMatrix, distCoeffs, poseMat, inliers );
+    return PNP_RANSAC;
 }
 
 
@@ -1,6 +1,9 @@
 #include "tracker/Camera.hpp"
 #include "tracker/ChessboardCameraTracker.hpp"
+#include "tracker/OrderedTrackerExecutor.hpp"
+#include "tracker/ThreadBudget.hpp"
 #include "tracker/utility.hpp"
+#include "tracker/Undistorter.hpp"
 
 #include <opencv2/highgui/highgui.hpp>
 
@@ -17,7 +20,7 @@ using namespace std;
 void help( const char* programName );
 
 // parse the input command line arguments
-bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile );
+bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile, bool &undistortFrame, int &numJobs, double &processingScale, ChessboardDetector &detector, bool &qualityGate, int &tiledBoardSide, bool &pinWorkers );
 
 int main( int argc, char** argv )
 {
@@ -50,17 +53,39 @@ int main( int argc, char** argv )
     // Camera object containing the calibration parameters
     Camera cam;
 
-    // Camera Tracker object
-    ChessboardCameraTracker tracker;
+    // the number of frames processed in parallel, each by its own tracker
+    int numJobs = 1;
 
-    // 3x4 camera pose matrix [R t]
-    Mat cameraPose;
+    // if false the tracker works on the distorted frames
+    bool undistortFrame = true;
+
+    // when tracking on the distorted frames, it is used to undistort the
+    // frame only if it has to be displayed undistorted
+    Undistorter displayUndistorter;
+
+    // true if the displayed frame must be undistorted
+    bool showUndistorted = false;
+
+    // the scale of the frames the detection and the tracking work on
+    double processingScale = 1.0;
+
+    // the detector of the chessboard
+    ChessboardDetector detector = DETECTOR_OPENCV;
+
+    // true to run the quality gate before the full detections
+    bool qualityGate = false;
+
+    // the expected side of the board for the tiled search, 0 to search the whole frame
+    int tiledBoardSide = 0;
+
+    // true to pin each worker to its share of the cores
+    bool pinWorkers = false;
 
     /******************************************************************/
     /* READ THE INPUT PARAMETERS - DO NOT MODIFY                      */
     /******************************************************************/
 
-    if( !parseArgs( argc, argv, boardSize, inputFilename, calibFilename ) )
+    if( !parseArgs( argc, argv, boardSize, inputFilename, calibFilename, undistortFrame, numJobs, processingScale, detector, qualityGate, tiledBoardSide, pinWorkers ) )
     {
         cerr << "Aborting..." << endl;
         return EXIT_FAILURE;
@@ -84,41 +109,108 @@ int main( int argc, char** argv )
     }
 
     // init the Camera loading the calibration parameters
-    cam.init(calibFilename);
+    if( !cam.init( calibFilename ) )
+    {
+        cerr << "Could not load the calibration file " << calibFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    // the trackers keep no state between frames, so the frames can be processed
+    // in parallel; the executor returns them in order
+    const OrderedTrackerExecutor::TrackerFactory factory = [undistortFrame, processingScale, detector, qualityGate, tiledBoardSide]( )
+    {
+        unique_ptr<ICameraTracker> tracker( new ChessboardCameraTracker( ) );
+        // set whether the tracker works on the undistorted or on the distorted frames
+        tracker->setUndistortFrame( undistortFrame );
+        // set the resolution of the detection
+        tracker->setProcessingScale( processingScale );
+        // set the detector of the chessboard
+        tracker->setChessboardDetector( detector );
+        // skip the detection on the frames where it would fail anyway
+        tracker->setQualityGateEnabled( qualityGate );
+        // search the chessboard by tiles on the high resolution frames
+        tracker->setTiledSearch( tiledBoardSide );
+        return tracker;
+    };
+
+    // share the cores between the workers and the parallel functions of OpenCV they call
+    ThreadBudget budget( 0, pinWorkers );
+    const ThreadAllocation threads = budget.allocate( numJobs > 1 ? STAGE_FRAME_PARALLEL : STAGE_SEQUENTIAL, numJobs );
+    ThreadBudget::apply( threads );
+    cout << "Threads: " << threads << endl;
+
+    OrderedTrackerExecutor executor( factory, cam, boardSize, pattern, threads.workers, 0, ThreadBudget::workerInit( threads ) );
+
+    // true when all the frames of the video have been submitted
+    bool endOfVideo = false;
+
+    // the number of frames rejected by the quality gates of the trackers
+    int numGateRejected = 0;
 
     // processing loop
     while(true)
     {
-        Mat view;
+        // keep the workers busy reading the next frames
+        while( !endOfVideo && executor.canSubmit( ) )
+        {
+            Mat frame;
+
+            // get the new frame from capture, frame shares the buffer of
+            // capture until submit copies it
+            capture >> frame;
 
-        // get the new frame from capture and copy it to view
-        capture >> view;
+            // if no more images to process stop reading
+            if( frame.empty( ) )
+                endOfVideo = true;
+            else
+                executor.submit( frame );
+        }
 
-        // if no more images to process exit the loop
-        if( view.empty( ) )
+        // get the oldest processed frame, exit the loop when all the frames have been shown
+        TrackedFrame result;
+        if( !executor.next( result ) )
             break;
 
+        Mat &view = result.view;
+        Mat &cameraPose = result.pose;
+
         // true if the chessboard is found
-        bool found = false;
+        const bool found = result.found;
+
+        if( result.gateRejected )
+            ++numGateRejected;
+
+        // the frame is already undistorted unless the tracker works in the
+        // distorted space, in that case undistort it only if it has to be shown so
+        bool viewUndistorted = undistortFrame;
+        if( !undistortFrame && showUndistorted )
+        {
+            Mat viewGrey;
+            cam.getUndistorter( view.size( ), displayUndistorter ).process( view, view, viewGrey );
+            viewUndistorted = true;
+        }
 
-        // process the image with the process method
-        found = tracker.process(view, cameraPose, cam, boardSize, pattern );
-        
         if (found)
         {
             // draw the reference on top of the image
-            drawReferenceSystem(view, cam, cameraPose, 4, 125, true);
+            drawReferenceSystem(view, cam, cameraPose, 4, 125, viewUndistorted);
         }
 
         // show the image inside the window
         imshow(WINDOW_NAME, view);
 
-        // wait 20ms for user input before processing the next frame
-        // Any user input will stop the execution
-        if( waitKey(20) == 'q' )
+        // wait for user input before processing the next frame
+        // 'q' will stop the execution, 'u' toggles the undistorted view
+        const int key = waitKey(20);
+        if( key == 'q' )
             break;
+        if( key == 'u' )
+            showUndistorted = !showUndistorted;
     }
 
+    if( qualityGate )
+        cout << "Quality gate: " << numGateRejected << " frames rejected" << endl;
+
     // release the video resource
     capture.release( );
 
@@ -135,13 +227,21 @@ void help( const char* programName )
             << "     -w <board_width>                                  # the number of inner corners per one of board dimension" << endl
             << "     -h <board_height>                                 # the number of inner corners per another board dimension" << endl
             << "     -c <calib file>                                   # the name of the calibration file" << endl
+            << "     [-nu]                                             # track on the distorted frames, only the corners are undistorted" << endl
+            << "                                                       # (press 'u' to display the undistorted frames)" << endl
+            << "     [-j <jobs>]                                       # the number of frames processed in parallel (default 1, at most the cores)" << endl
+            << "     [-pin]                                            # pin each job to its share of the cores (Linux only)" << endl
+            << "     [-sc <scale>]                                     # detect and track on frames downscaled by <scale> in (0, 1] (default 1)" << endl
+            << "     [-fd]                                             # detect the pattern with the fast detectors (saddle points, single threshold blobs)" << endl
+            << "     [-qg]                                             # skip the detection on the blurred, flat or board-less frames" << endl
+            << "     [-ts <pixels>]                                    # search the chessboard by tiles, <pixels> is the expected side of the board" << endl
             << "     <video file>                                      # the name of the video file" << endl
             << endl;
 }
 
 // parse the input command line arguments
 
-bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile )
+bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile, bool &undistortFrame, int &numJobs, double &processingScale, ChessboardDetector &detector, bool &qualityGate, int &tiledBoardSide, bool &pinWorkers )
 {
     // check the minimum number of arguments
     if( argc < 3 )
@@ -171,6 +271,46 @@ bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, st
                 return false;
             }
         }
+        else if( strcmp( s, "-nu" ) == 0 )
+        {
+            undistortFrame = false;
+        }
+        else if( strcmp( s, "-j" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &numJobs ) != 1 || numJobs <= 0 )
+            {
+                cerr << "Invalid number of jobs" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-pin" ) == 0 )
+        {
+            pinWorkers = true;
+        }
+        else if( strcmp( s, "-sc" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%lf", &processingScale ) != 1 || processingScale <= 0 || processingScale > 1 )
+            {
+                cerr << "Invalid processing scale" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-fd" ) == 0 )
+        {
+            detector = DETECTOR_FAST;
+        }
+        else if( strcmp( s, "-qg" ) == 0 )
+        {
+            qualityGate = true;
+        }
+        else if( strcmp( s, "-ts" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &tiledBoardSide ) != 1 || tiledBoardSide <= 0 )
+            {
+                cerr << "Invalid expected board side" << endl;
+                return false;
+            }
+        }
         else if( s[0] != '-' )
         {
             inputFilename.assign( s );
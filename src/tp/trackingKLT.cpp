@@ -1,6 +1,7 @@
 #include "tracker/Camera.hpp"
-#include "tracker/ChessboardCameraTrackerKLT.hpp"
+#include "tracker/ChessboardCameraTrackerHybrid.hpp"
 #include "tracker/utility.hpp"
+#include "tracker/Undistorter.hpp"
 
 #include <opencv2/highgui/highgui.hpp>
 
@@ -16,7 +17,7 @@ using namespace std;
 void help( const char* programName );
 
 // parse the input command line arguments
-bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile );
+bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile, bool &undistortFrame, int &redetectionPeriod, double &processingScale, ChessboardDetector &detector, bool &qualityGate, int &tiledBoardSide );
 
 int main( int argc, char** argv )
 {
@@ -49,16 +50,41 @@ int main( int argc, char** argv )
     // Camera object containing the calibration parameters
     Camera cam;
 
-    // Camera Tracker object
-    ChessboardCameraTrackerKLT tracker;
+    // Camera Tracker object, the KLT tracker with the optional background detection
+    ChessboardCameraTrackerHybrid tracker;
+
+    // the number of frames between two background detections (0 to disable them)
+    int redetectionPeriod = 0;
 
     // 3x4 camera pose matrix [R t]
     Mat cameraPose;
 
+    // if false the tracker works on the distorted frames
+    bool undistortFrame = true;
+
+    // when tracking on the distorted frames, it is used to undistort the
+    // frame only if it has to be displayed undistorted
+    Undistorter displayUndistorter;
+
+    // true if the displayed frame must be undistorted
+    bool showUndistorted = false;
+
+    // the scale of the frames the detection and the tracking work on
+    double processingScale = 1.0;
+
+    // the detector of the chessboard
+    ChessboardDetector detector = DETECTOR_OPENCV;
+
+    // true to run the quality gate before the full detections
+    bool qualityGate = false;
+
+    // the expected side of the board for the tiled search, 0 to search the whole frame
+    int tiledBoardSide = 0;
+
     /******************************************************************/
     /* READ THE INPUT PARAMETERS - DO NOT MODIFY                      */
     /******************************************************************/
-    if( !parseArgs( argc, argv, boardSize, inputFilename, calibFilename ) )
+    if( !parseArgs( argc, argv, boardSize, inputFilename, calibFilename, undistortFrame, redetectionPeriod, processingScale, detector, qualityGate, tiledBoardSide ) )
     {
         cerr << "Aborting..." << endl;
         return EXIT_FAILURE;
@@ -82,7 +108,29 @@ int main( int argc, char** argv )
     }
 
     // init the Camera loading the calibration parameters
-    cam.init(calibFilename);
+    if( !cam.init( calibFilename ) )
+    {
+        cerr << "Could not load the calibration file " << calibFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    // set whether the tracker works on the undistorted or on the distorted frames
+    tracker.setUndistortFrame( undistortFrame );
+
+    // set how often the chessboard is detected in the background to correct the drift
+    tracker.setRedetectionPeriod( redetectionPeriod );
+
+    // set the resolution of the detection and of the tracking
+    tracker.setProcessingScale( processingScale );
+
+    // set the detector of the chessboard
+    tracker.setChessboardDetector( detector );
+
+    // skip the detection on the frames where it would fail anyway
+    tracker.setQualityGateEnabled( qualityGate );
+
+    // search the chessboard by tiles on the high resolution frames
+    tracker.setTiledSearch( tiledBoardSide );
 
     // processing loop
     while( true )
@@ -102,19 +150,47 @@ int main( int argc, char** argv )
         // process the image with the process method
         found = tracker.process(view, cameraPose, cam, boardSize, pattern);
 
+        // report how the pose has been estimated
+        static const char *pnpPathNames[] = { "none", "iterative", "ransac", "planar", "static" };
+        cout << "PnP: " << pnpPathNames[ tracker.getLastPnPPath( ) ] << ", recovered corners: " << tracker.getNumReseeded( )
+             << ( tracker.isPartial( ) ? ", partial board" : "" ) << endl;
+
+        // the frame is already undistorted unless the tracker works in the
+        // distorted space, in that case undistort it only if it has to be shown so
+        bool viewUndistorted = undistortFrame;
+        if( !undistortFrame && showUndistorted )
+        {
+            Mat viewGrey;
+            cam.getUndistorter( view.size( ), displayUndistorter ).process( view, view, viewGrey );
+            viewUndistorted = true;
+        }
+
         if (found)
         {
             // draw the reference on top of the image
-            drawReferenceSystem(view, cam, cameraPose, 4, 125, true);
+            drawReferenceSystem(view, cam, cameraPose, 4, 125, viewUndistorted);
         }
 
         // show the image inside the window
         imshow(WINDOW_NAME, view);
 
-        // wait 20ms for user input before processing the next frame
-        // Any user input will stop the execution
-        if( waitKey(-1) == 'q' )
+        // wait for user input before processing the next frame
+        // 'q' will stop the execution, 'u' toggles the undistorted view
+        const int key = waitKey(-1);
+        if( key == 'q' )
             break;
+        if( key == 'u' )
+            showUndistorted = !showUndistorted;
+    }
+
+    // report how many detections the quality gate saved
+    if( qualityGate )
+    {
+        const FrameQualityGate &gate = tracker.getQualityGate( );
+        cout << "Quality gate: " << gate.getNumRejected( ) << " of " << gate.getNumEvaluated( ) << " frames rejected ("
+             << gate.getNumRejected( FrameQualityGate::GATE_BLURRED ) << " blurred, "
+             << gate.getNumRejected( FrameQualityGate::GATE_LOW_CONTRAST ) << " low contrast, "
+             << gate.getNumRejected( FrameQualityGate::GATE_NO_BOARD ) << " without board)" << endl;
     }
 
     // release the video resource
@@ -132,13 +208,21 @@ void help( const char* programName )
             << "     -w <board_width>                                  # the number of inner corners per one of board dimension" << endl
             << "     -h <board_height>                                 # the number of inner corners per another board dimension" << endl
             << "     -c <calib file>                                   # the name of the calibration file" << endl
+            << "     [-nu]                                             # track on the distorted frames, only the corners are undistorted" << endl
+            << "                                                       # (press 'u' to display the undistorted frames)" << endl
+            << "     [-rd <frames>]                                    # detect the chessboard in the background every <frames> frames" << endl
+            << "                                                       # to correct the drift of the KLT (default 0, disabled)" << endl
+            << "     [-sc <scale>]                                     # detect and track on frames downscaled by <scale> in (0, 1] (default 1)" << endl
+            << "     [-fd]                                             # detect the pattern with the fast detectors (saddle points, single threshold blobs)" << endl
+            << "     [-qg]                                             # skip the detection on the blurred, flat or board-less frames" << endl
+            << "     [-ts <pixels>]                                    # search the chessboard by tiles, <pixels> is the expected side of the board" << endl
             << "     <video file>                                      # the name of the video file" << endl
             << endl;
 }
 
 // parse the input command line arguments
 
-bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile )
+bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile, bool &undistortFrame, int &redetectionPeriod, double &processingScale, ChessboardDetector &detector, bool &qualityGate, int &tiledBoardSide )
 {
     // check the minimum number of arguments
     if( argc < 3 )
@@ -168,6 +252,42 @@ bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, st
                 return false;
             }
         }
+        else if( strcmp( s, "-nu" ) == 0 )
+        {
+            undistortFrame = false;
+        }
+        else if( strcmp( s, "-rd" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &redetectionPeriod ) != 1 || redetectionPeriod < 0 )
+            {
+                cerr << "Invalid redetection period" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-sc" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%lf", &processingScale ) != 1 || processingScale <= 0 || processingScale > 1 )
+            {
+                cerr << "Invalid processing scale" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-fd" ) == 0 )
+        {
+            detector = DETECTOR_FAST;
+        }
+        else if( strcmp( s, "-qg" ) == 0 )
+        {
+            qualityGate = true;
+        }
+        else if( strcmp( s, "-ts" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &tiledBoardSide ) != 1 || tiledBoardSide <= 0 )
+            {
+                cerr << "Invalid expected board side" << endl;
+                return false;
+            }
+        }
         else if( s[0] != '-' )
         {
             inputFilename.assign( s );
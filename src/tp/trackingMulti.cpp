@@ -0,0 +1,248 @@
+#include "tracker/Camera.hpp"
+#include "tracker/MultiBoardTracker.hpp"
+#include "tracker/utility.hpp"
+#include "tracker/Undistorter.hpp"
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+// Display the help for the program
+void help( const char* programName );
+
+// parse the input command line arguments
+bool parseArgs( int argc, char**argv, vector<BoardDescriptor> &boards, string &inputFilename, string &calibFile, bool &undistortFrame, double &processingScale, ChessboardDetector &detector );
+
+int main( int argc, char** argv )
+{
+    /******************************************************************/
+    /* CONSTANTS to use                                               */
+    /******************************************************************/
+
+    // the name of the window
+    const string WINDOW_NAME = "Image View";
+
+    /******************************************************************/
+    /* VARIABLES to use                                               */
+    /******************************************************************/
+
+    // the boards to track
+    vector<BoardDescriptor> boards;
+
+    // it will contains the filename of the image file
+    string inputFilename;
+
+    // it will contains the filename of the image file
+    string calibFilename;
+
+    // Used to load the video and get the frames
+    VideoCapture capture;
+
+    // Camera object containing the calibration parameters
+    Camera cam;
+
+    // the tracker of all the boards
+    MultiBoardTracker tracker;
+
+    // if false the tracker works on the distorted frames
+    bool undistortFrame = true;
+
+    // when tracking on the distorted frames, it is used to undistort the
+    // frame only if it has to be displayed undistorted
+    Undistorter displayUndistorter;
+
+    // true if the displayed frame must be undistorted
+    bool showUndistorted = false;
+
+    // the scale of the frames the detection and the tracking work on
+    double processingScale = 1.0;
+
+    // the detector of the chessboards
+    ChessboardDetector detector = DETECTOR_OPENCV;
+
+    /******************************************************************/
+    /* READ THE INPUT PARAMETERS - DO NOT MODIFY                      */
+    /******************************************************************/
+    if( !parseArgs( argc, argv, boards, inputFilename, calibFilename, undistortFrame, processingScale, detector ) )
+    {
+        cerr << "Aborting..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    /******************************************************************/
+    /* PART TO DEVELOP                                                  */
+    /******************************************************************/
+
+    // create a window using WINDOW_NAME as name to display the image
+    namedWindow( WINDOW_NAME, CV_WINDOW_AUTOSIZE | CV_WINDOW_KEEPRATIO );
+
+    // read the input video with capture
+    capture.open( string( inputFilename ) );
+
+    // check it is really opened
+    if( !capture.isOpened( ) )
+    {
+        cerr << "Could not open video file " << inputFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    // init the Camera loading the calibration parameters
+    if( !cam.init( calibFilename ) )
+    {
+        cerr << "Could not load the calibration file " << calibFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    tracker.setBoards( boards );
+    tracker.setUndistortFrame( undistortFrame );
+    tracker.setProcessingScale( processingScale );
+    tracker.setChessboardDetector( detector );
+
+    // processing loop
+    while( true )
+    {
+        Mat view;
+
+        // get the new frame from capture and copy it to view
+        capture >> view;
+
+        // if no more images to process exit the loop
+        if( view.empty( ) )
+            break;
+
+        // the pose of each board
+        vector<BoardPose> poses;
+        tracker.processBoards( view, cam, poses );
+
+        // the frame is already undistorted unless the tracker works in the
+        // distorted space, in that case undistort it only if it has to be shown so
+        bool viewUndistorted = undistortFrame;
+        if( !undistortFrame && showUndistorted )
+        {
+            Mat viewGrey;
+            cam.getUndistorter( view.size( ), displayUndistorter ).process( view, view, viewGrey );
+            viewUndistorted = true;
+        }
+
+        // draw the reference on top of each board found
+        for( size_t b = 0; b < poses.size( ); ++b )
+        {
+            cout << "Board " << b << ": " << ( poses[b].found ? "found" : "not found" ) << ", corners: " << poses[b].numCorners << endl;
+            if( poses[b].found )
+                drawReferenceSystem( view, cam, poses[b].pose, 4, 125, viewUndistorted );
+        }
+
+        // show the image inside the window
+        imshow( WINDOW_NAME, view );
+
+        // wait for user input before processing the next frame
+        // 'q' will stop the execution, 'u' toggles the undistorted view
+        const int key = waitKey( 20 );
+        if( key == 'q' )
+            break;
+        if( key == 'u' )
+            showUndistorted = !showUndistorted;
+    }
+
+    // release the video resource
+    capture.release( );
+
+    return EXIT_SUCCESS;
+}
+
+// Display the help for the program
+
+void help( const char* programName )
+{
+    cout << "Track several boards in the same video and display an augmented reference system on top of each of them" << endl
+            << "Usage: " << programName << endl
+            << "     -b <board_width> <board_height>                   # a chessboard to track, with its number of inner corners (repeat for each board)" << endl
+            << "     [-bc <board_width> <board_height>]                # a circles' grid to track" << endl
+            << "     [-ba <board_width> <board_height>]                # an asymmetric circles' grid to track" << endl
+            << "     -c <calib file>                                   # the name of the calibration file" << endl
+            << "     [-nu]                                             # track on the distorted frames, only the corners are undistorted" << endl
+            << "                                                       # (press 'u' to display the undistorted frames)" << endl
+            << "     [-sc <scale>]                                     # detect and track on frames downscaled by <scale> in (0, 1] (default 1)" << endl
+            << "     [-fd]                                             # detect the patterns with the fast detectors (saddle points, single threshold blobs)" << endl
+            << "     <video file>                                      # the name of the video file" << endl
+            << endl;
+}
+
+// parse the input command line arguments
+
+bool parseArgs( int argc, char**argv, vector<BoardDescriptor> &boards, string &inputFilename, string &calibFile, bool &undistortFrame, double &processingScale, ChessboardDetector &detector )
+{
+    // check the minimum number of arguments
+    if( argc < 3 )
+    {
+        help( argv[0] );
+        return false;
+    }
+
+
+    // Read the input arguments
+    for( int i = 1; i < argc; i++ )
+    {
+        const char* s = argv[i];
+        if( strcmp( s, "-b" ) == 0 || strcmp( s, "-bc" ) == 0 || strcmp( s, "-ba" ) == 0 )
+        {
+            const Pattern pattern = ( s[2] == 'c' ) ? CIRCLES_GRID : ( s[2] == 'a' ) ? ASYMMETRIC_CIRCLES_GRID : CHESSBOARD;
+            Size boardSize;
+            if( i + 2 >= argc || sscanf( argv[++i], "%d", &boardSize.width ) != 1 || sscanf( argv[++i], "%d", &boardSize.height ) != 1
+                || boardSize.width <= 0 || boardSize.height <= 0 )
+            {
+                cerr << "Invalid board size" << endl;
+                return false;
+            }
+            boards.push_back( BoardDescriptor( boardSize, pattern ) );
+        }
+        else if( strcmp( s, "-nu" ) == 0 )
+        {
+            undistortFrame = false;
+        }
+        else if( strcmp( s, "-sc" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%lf", &processingScale ) != 1 || processingScale <= 0 || processingScale > 1 )
+            {
+                cerr << "Invalid processing scale" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-fd" ) == 0 )
+        {
+            detector = DETECTOR_FAST;
+        }
+        else if( s[0] != '-' )
+        {
+            inputFilename.assign( s );
+        }
+        else if( strcmp( s, "-c" ) == 0 )
+        {
+            if( i + 1 < argc )
+                calibFile.assign( argv[++i] );
+            else
+            {
+                cerr << "Missing argument for option " << s << endl;
+                return false;
+            }
+        }
+        else
+        {
+            cerr << "Unknown option " << s << endl;
+            return false;
+        }
+    }
+
+    if( boards.empty( ) )
+    {
+        cerr << "No board to track" << endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,247 @@
+#include "tracker/ChessboardCameraTrackerKLT.hpp"
+#include "tracker/MultiCameraRunner.hpp"
+#include "tracker/ThreadBudget.hpp"
+#include "tracker/utility.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+// Display the help for the program
+void help( const char* programName );
+
+// parse the input command line arguments
+bool parseArgs( int argc, char**argv, Size &boardSize, vector<string> &sources, vector<string> &calibFiles, string &outputFilename,
+                int &numJobs, int &framesPerCamera, int &maxPoses, bool &pinWorkers );
+
+int main( int argc, char** argv )
+{
+    /******************************************************************/
+    /* VARIABLES to use                                               */
+    /******************************************************************/
+
+    // it will contain the size in terms of corners (width X height) of the chessboard
+    Size boardSize;
+
+    // the video file, the stream or the device of each camera
+    vector<string> sources;
+
+    // the calibration file of each camera
+    vector<string> calibFilenames;
+
+    // it will contains the filename of the file where the poses are saved
+    string outputFilename = "poses.yml";
+
+    // Default pattern is chessboard
+    Pattern pattern = CHESSBOARD;
+
+    // the number of tracking threads shared by the cameras, 0 to let the budget decide
+    int numJobs = 0;
+
+    // true to pin each tracking thread to its share of the cores
+    bool pinWorkers = false;
+
+    // the number of frames of each camera in flight
+    int framesPerCamera = 4;
+
+    // the number of poses after which the tracking stops, 0 to track the sources to the end
+    int maxPoses = 0;
+
+    /******************************************************************/
+    /* READ THE INPUT PARAMETERS                                      */
+    /******************************************************************/
+    if( !parseArgs( argc, argv, boardSize, sources, calibFilenames, outputFilename, numJobs, framesPerCamera, maxPoses, pinWorkers ) )
+    {
+        cerr << "Aborting..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    // each camera is tracked by its own KLT tracker
+    const MultiCameraRunner::TrackerFactory factory = [ ]( )
+    {
+        return unique_ptr<ICameraTracker>( new ChessboardCameraTrackerKLT( ) );
+    };
+
+    // a camera keeps at most one tracking thread busy, and its capture thread
+    // decodes the frames: the cores left go to the parallel functions of OpenCV
+    ThreadBudget budget( 0, pinWorkers );
+    const int numCameras = ( int ) sources.size( );
+    const ThreadAllocation threads = budget.allocate( STAGE_MULTI_CAMERA, numJobs, numCameras, numCameras );
+    ThreadBudget::apply( threads );
+    cout << "Threads: " << threads << endl;
+
+    MultiCameraRunner runner( factory, boardSize, pattern, threads.workers, framesPerCamera, ThreadBudget::workerInit( threads ) );
+
+    for( size_t c = 0; c < sources.size( ); ++c )
+    {
+        if( runner.addCamera( sources[c], calibFilenames[c] ) < 0 )
+        {
+            cerr << "Could not open the source " << sources[c] << " with the calibration file " << calibFilenames[c] << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    FileStorage fs( outputFilename, FileStorage::WRITE );
+    if( !fs.isOpened( ) )
+    {
+        cerr << "Could not write the output file " << outputFilename << endl;
+        return EXIT_FAILURE;
+    }
+    fs << "board_width" << boardSize.width;
+    fs << "board_height" << boardSize.height;
+    fs << "camera_count" << runner.getNumCameras( );
+    fs << "threads" << threads;
+
+    // the merged pose stream is saved as it comes
+    runner.start( );
+    int numPoses = 0;
+    fs << "poses" << "[";
+    CameraPose result;
+    while( runner.next( result ) )
+    {
+        fs << "{" << "camera" << result.camera << "frame" << ( int ) result.frame << "timestamp" << result.timestamp
+                << "found" << ( int ) result.found;
+        if( result.found )
+            fs << "pose" << result.pose;
+        fs << "}";
+
+        if( ++numPoses == maxPoses )
+            runner.stop( );
+    }
+    fs << "]";
+
+    for( int c = 0; c < runner.getNumCameras( ); ++c )
+    {
+        const CameraStats stats = runner.getStats( c );
+        cout << "Camera " << c << " (" << sources[c] << "): " << stats.captured << " frames read, " << stats.dropped << " dropped, "
+                << stats.processed << " tracked, chessboard found in " << stats.found << endl;
+    }
+    cout << numPoses << " poses saved in " << outputFilename << endl;
+
+    return EXIT_SUCCESS;
+}
+
+// Display the help for the program
+
+void help( const char* programName )
+{
+    cout << "Track a chessboard in the videos of several cameras at the same time, and save the poses of all the cameras ordered by timestamp" << endl
+            << "Usage: " << programName << endl
+            << "     -w <board_width>                                  # the number of inner corners per one of board dimension" << endl
+            << "     -h <board_height>                                 # the number of inner corners per another board dimension" << endl
+            << "     -v <source> <calib file>                          # a video file, stream url or device index and its calibration file" << endl
+            << "                                                       # (repeat for each camera)" << endl
+            << "     [-o <output file>]                                # the file where the poses are saved (default poses.yml)" << endl
+            << "     [-j <jobs>]                                       # the number of tracking threads shared by the cameras (default and at most" << endl
+            << "                                                       # one per camera within the cores left to the capture)" << endl
+            << "     [-pin]                                            # pin each tracking thread to its share of the cores (Linux only)" << endl
+            << "     [-f <frames>]                                     # the number of frames of each camera in flight (default 4)" << endl
+            << "     [-n <poses>]                                      # stop after this number of poses (default track the sources to the end)" << endl
+            << endl;
+}
+
+// parse the input command line arguments
+
+bool parseArgs( int argc, char**argv, Size &boardSize, vector<string> &sources, vector<string> &calibFiles, string &outputFilename,
+                int &numJobs, int &framesPerCamera, int &maxPoses, bool &pinWorkers )
+{
+    // check the minimum number of arguments
+    if( argc < 3 )
+    {
+        help( argv[0] );
+        return false;
+    }
+
+
+    // Read the input arguments
+    for( int i = 1; i < argc; i++ )
+    {
+        const char* s = argv[i];
+        if( strcmp( s, "-w" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%u", &boardSize.width ) != 1 || boardSize.width <= 0 )
+            {
+                cerr << "Invalid board width" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-h" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%u", &boardSize.height ) != 1 || boardSize.height <= 0 )
+            {
+                cerr << "Invalid board height" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-v" ) == 0 )
+        {
+            if( i + 2 >= argc )
+            {
+                cerr << "Missing argument for option " << s << endl;
+                return false;
+            }
+            sources.push_back( argv[++i] );
+            calibFiles.push_back( argv[++i] );
+        }
+        else if( strcmp( s, "-j" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &numJobs ) != 1 || numJobs <= 0 )
+            {
+                cerr << "Invalid number of jobs" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-pin" ) == 0 )
+        {
+            pinWorkers = true;
+        }
+        else if( strcmp( s, "-f" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &framesPerCamera ) != 1 || framesPerCamera < 2 )
+            {
+                cerr << "Invalid number of frames per camera (at least 2)" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-n" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &maxPoses ) != 1 || maxPoses < 0 )
+            {
+                cerr << "Invalid number of poses" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-o" ) == 0 )
+        {
+            if( i + 1 < argc )
+                outputFilename.assign( argv[++i] );
+            else
+            {
+                cerr << "Missing argument for option " << s << endl;
+                return false;
+            }
+        }
+        else
+        {
+            cerr << "Unknown option " << s << endl;
+            return false;
+        }
+    }
+
+    if( sources.empty( ) )
+    {
+        cerr << "No camera to track" << endl;
+        return false;
+    }
+
+    if( boardSize.width <= 0 || boardSize.height <= 0 )
+    {
+        cerr << "Missing board size" << endl;
+        return false;
+    }
+
+    return true;
+}
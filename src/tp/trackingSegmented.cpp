@@ -0,0 +1,240 @@
+#include "tracker/Camera.hpp"
+#include "tracker/ChessboardCameraTrackerKLT.hpp"
+#include "tracker/SegmentedVideoTracker.hpp"
+#include "tracker/ThreadBudget.hpp"
+#include "tracker/VideoIndex.hpp"
+#include "tracker/utility.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <ctime>
+
+using namespace cv;
+using namespace std;
+
+// Display the help for the program
+void help( const char* programName );
+
+// parse the input command line arguments
+bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile, string &outputFilename,
+                int &numJobs, int &segmentLength, int &overlap, bool &pinWorkers );
+
+int main( int argc, char** argv )
+{
+    /******************************************************************/
+    /* VARIABLES to use                                               */
+    /******************************************************************/
+
+    // it will contain the size in terms of corners (width X height) of the chessboard
+    Size boardSize;
+
+    // it will contains the filename of the video file
+    string inputFilename;
+
+    // it will contains the filename of the calibration file
+    string calibFilename;
+
+    // it will contains the filename of the file where the poses are saved
+    string outputFilename = "poses.yml";
+
+    // Default pattern is chessboard
+    Pattern pattern = CHESSBOARD;
+
+    // Camera object containing the calibration parameters
+    Camera cam;
+
+    // the index of the video
+    VideoIndex index;
+
+    // the number of segments processed in parallel, 0 to use all the cores
+    int numJobs = 0;
+
+    // true to pin each worker to its share of the cores
+    bool pinWorkers = false;
+
+    // the minimum number of frames of a segment
+    int segmentLength = 1000;
+
+    // the number of frames processed before each segment to warm the tracker up
+    int overlap = 25;
+
+    /******************************************************************/
+    /* READ THE INPUT PARAMETERS                                      */
+    /******************************************************************/
+    if( !parseArgs( argc, argv, boardSize, inputFilename, calibFilename, outputFilename, numJobs, segmentLength, overlap, pinWorkers ) )
+    {
+        cerr << "Aborting..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    // init the Camera loading the calibration parameters
+    if( !cam.init( calibFilename ) )
+    {
+        cerr << "Could not load the calibration file " << calibFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    // build (or load) the index of the video
+    const clock_t indexStart = clock( );
+    if( !index.init( inputFilename ) )
+    {
+        cerr << "Could not index the video file " << inputFilename << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "Video indexed: " << index.getFrameCount( ) << " frames, " << index.getSeekPoints( ).size( ) << " seek points ("
+            << ( double ) ( clock( ) - indexStart ) / CLOCKS_PER_SEC << " s)" << endl;
+
+    // each segment is tracked by its own KLT tracker
+    const SegmentedVideoTracker::TrackerFactory factory = [ ]( )
+    {
+        return unique_ptr<ICameraTracker>( new ChessboardCameraTrackerKLT( ) );
+    };
+    SegmentedVideoTracker segmentedTracker( index, factory, cam, boardSize, pattern );
+
+    // share the cores between the segments and the parallel functions of OpenCV they call
+    ThreadBudget budget( 0, pinWorkers );
+    const ThreadAllocation threads = budget.allocate( STAGE_SEGMENTS, numJobs );
+    ThreadBudget::apply( threads );
+    cout << "Threads: " << threads << endl;
+
+    vector<FramePose> poses;
+    if( !segmentedTracker.run( poses, threads.workers, segmentLength, overlap, ThreadBudget::workerInit( threads ) ) )
+    {
+        cerr << "Could not track the video file " << inputFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    // save the pose stream
+    FileStorage fs( outputFilename, FileStorage::WRITE );
+    if( !fs.isOpened( ) )
+    {
+        cerr << "Could not write the output file " << outputFilename << endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t numFound = 0;
+    fs << "board_width" << boardSize.width;
+    fs << "board_height" << boardSize.height;
+    fs << "frame_count" << ( int ) poses.size( );
+    fs << "threads" << threads;
+    fs << "poses" << "[";
+    for( size_t i = 0; i < poses.size( ); ++i )
+    {
+        fs << "{" << "frame" << poses[i].frame << "timestamp" << poses[i].timestamp << "found" << ( int ) poses[i].found;
+        if( poses[i].found )
+        {
+            fs << "pose" << poses[i].pose;
+            ++numFound;
+        }
+        fs << "}";
+    }
+    fs << "]";
+
+    cout << "Chessboard found in " << numFound << " of " << poses.size( ) << " frames, poses saved in " << outputFilename << endl;
+
+    return EXIT_SUCCESS;
+}
+
+// Display the help for the program
+
+void help( const char* programName )
+{
+    cout << "Track a chessboard in a long video processing segments of the video in parallel, and save the poses" << endl
+            << "Usage: " << programName << endl
+            << "     -w <board_width>                                  # the number of inner corners per one of board dimension" << endl
+            << "     -h <board_height>                                 # the number of inner corners per another board dimension" << endl
+            << "     -c <calib file>                                   # the name of the calibration file" << endl
+            << "     [-o <output file>]                                # the file where the poses are saved (default poses.yml)" << endl
+            << "     [-j <jobs>]                                       # the number of segments processed in parallel (default and at most all the cores)" << endl
+            << "     [-pin]                                            # pin each job to its share of the cores (Linux only)" << endl
+            << "     [-s <frames>]                                     # the minimum length of a segment (default 1000)" << endl
+            << "     [-ov <frames>]                                    # the frames processed before a segment to warm the tracker up (default 25)" << endl
+            << "     <video file>                                      # the name of the video file" << endl
+            << endl;
+}
+
+// parse the input command line arguments
+
+bool parseArgs( int argc, char**argv, Size &boardSize, string &inputFilename, string &calibFile, string &outputFilename,
+                int &numJobs, int &segmentLength, int &overlap, bool &pinWorkers )
+{
+    // check the minimum number of arguments
+    if( argc < 3 )
+    {
+        help( argv[0] );
+        return false;
+    }
+
+
+    // Read the input arguments
+    for( int i = 1; i < argc; i++ )
+    {
+        const char* s = argv[i];
+        if( strcmp( s, "-w" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%u", &boardSize.width ) != 1 || boardSize.width <= 0 )
+            {
+                cerr << "Invalid board width" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-h" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%u", &boardSize.height ) != 1 || boardSize.height <= 0 )
+            {
+                cerr << "Invalid board height" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-j" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &numJobs ) != 1 || numJobs <= 0 )
+            {
+                cerr << "Invalid number of jobs" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-pin" ) == 0 )
+        {
+            pinWorkers = true;
+        }
+        else if( strcmp( s, "-s" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &segmentLength ) != 1 || segmentLength <= 0 )
+            {
+                cerr << "Invalid segment length" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( s, "-ov" ) == 0 )
+        {
+            if( i + 1 >= argc || sscanf( argv[++i], "%d", &overlap ) != 1 || overlap < 0 )
+            {
+                cerr << "Invalid overlap" << endl;
+                return false;
+            }
+        }
+        else if( s[0] != '-' )
+        {
+            inputFilename.assign( s );
+        }
+        else if( strcmp( s, "-c" ) == 0 || strcmp( s, "-o" ) == 0 )
+        {
+            if( i + 1 < argc )
+                ( s[1] == 'c' ? calibFile : outputFilename ).assign( argv[++i] );
+            else
+            {
+                cerr << "Missing argument for option " << s << endl;
+                return false;
+            }
+        }
+        else
+        {
+            cerr << "Unknown option " << s << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
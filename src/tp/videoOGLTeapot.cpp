@@ -291,7 +291,11 @@ int main( int argc, char** argv )
     }
 
     // init the Camera loading the calibration parameters
-    cam.init(calibFilename);
+    if( !cam.init( calibFilename ) )
+    {
+        cerr << "Could not load the calibration file " << calibFilename << endl;
+        return EXIT_FAILURE;
+    }
 
     // get the corresponding projection matrix in OGL format
     cam.getOGLProjectionMatrix(gProjectionMatrix, 10.f, 10000.f);
@@ -362,7 +362,11 @@ int main( int argc, char** argv )
     //******************************************************************
     // init the Camera loading the calibration parameters
     //******************************************************************
-    cam.init( calibFilename );
+    if( !cam.init( calibFilename ) )
+    {
+        cerr << "Could not load the calibration file " << calibFilename << endl;
+        return EXIT_FAILURE;
+    }
 
     //******************************************************************
     // get the corresponding projection matrix in OGL format
@@ -386,6 +390,10 @@ int main( int argc, char** argv )
 
     gResultImage = Mat( singleSize, imgInType );
 
+    // the texture upload is skipped on the frames that did not change at all,
+    // which the tracker only knows if it compares the whole frames too
+    tracker.setStaticGate( 0.25f, 8.f );
+
 
     // Setup GLUT rendering and callbacks
     glutInit( &argc, argv );
@@ -400,6 +408,11 @@ int main( int argc, char** argv )
 
     gFinished = false;
 
+    // true if gResultImage has changed since the last texture upload
+    bool textureDirty = true;
+    // true once the texture has been uploaded at least once
+    bool textureUploaded = false;
+
     while( !gFinished )
     {
 
@@ -436,13 +449,25 @@ int main( int argc, char** argv )
 
             }
 
-            view0.copyTo( gResultImage );
+            // when the whole frame is unchanged the image is the same as before,
+            // no need to upload the texture again (a static pose alone does not
+            // mean that the background did not move)
+            if( !tracker.isFrameUnchanged( ) || !textureUploaded )
+            {
+                view0.copyTo( gResultImage );
+                textureDirty = true;
+            }
 
             ++frameNumber;
         }
 
-        // update the texture to be displayed in OPENGL
-        updateTexture( );
+        // update the texture to be displayed in OPENGL (only if it has changed)
+        if( textureDirty )
+        {
+            updateTexture( );
+            textureDirty = false;
+            textureUploaded = true;
+        }
 
         // force Opengl to call the displayFunc
 #if __APPLE__